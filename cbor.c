@@ -11,6 +11,9 @@
 
 cbor_value_t *cbor_create(cbor_type type) {
     cbor_value_t *val = (cbor_value_t *)malloc(sizeof(cbor_value_t));
+    if (val == NULL) {
+        return NULL;
+    }
     memset(val, 0, sizeof(cbor_value_t));
     val->type = type;
     if (val->type == CBOR_TYPE_ARRAY || val->type == CBOR_TYPE_MAP) {
@@ -22,41 +25,49 @@ cbor_value_t *cbor_create(cbor_type type) {
     return val;
 }
 
+/* depth first without recursion: each child is detached and climbs back
+ * through its `parent` once it has nothing left to free */
 int cbor_destroy(cbor_value_t *val) {
+    cbor_value_t *next;
+
     if (val == NULL) {
         return -1;
     }
 
     assert(val->parent == NULL);
 
-    if (val->type == CBOR_TYPE_ARRAY || val->type == CBOR_TYPE_MAP) {
-        cbor_value_t *var, *tvar;
-        list_foreach_safe(var, &val->container, entry, tvar) {
-            cbor_container_remove(val, var);
-            cbor_destroy(var);
+    while (val) {
+        next = NULL;
+        if (val->type == CBOR_TYPE_ARRAY || val->type == CBOR_TYPE_MAP) {
+            next = cbor_container_remove(val, list_first(&val->container));
+        } else if (val->type == CBOR_TYPE_BYTESTRING || val->type == CBOR_TYPE_STRING) {
+            free(val->blob.ptr);
+            val->blob.ptr = NULL;
+            val->blob.length = 0;
+            val->blob.allocated = 0;
+        } else if (val->type == CBOR__TYPE_PAIR) {
+            if (val->pair.key) {
+                next = val->pair.key;
+                val->pair.key = NULL;
+            } else {
+                next = val->pair.value;
+                val->pair.value = NULL;
+            }
+        } else if (val->type == CBOR_TYPE_TAG) {
+            next = val->tag.content;
+            val->tag.item = 0;
+            val->tag.content = NULL;
         }
-    } else if (val->type == CBOR_TYPE_BYTESTRING || val->type == CBOR_TYPE_STRING) {
-        free(val->blob.ptr);
-        val->blob.ptr = NULL;
-        val->blob.length = 0;
-        val->blob.allocated = 0;
-    } else if (val->type == CBOR__TYPE_PAIR) {
-        cbor_value_t *var = val->pair.key;
-        val->pair.key = NULL;
-        var->parent = NULL;
-        cbor_destroy(var);
 
-        var = val->pair.value;
-        val->pair.value = NULL;
-        var->parent = NULL;
-        cbor_destroy(var);
-    } else if (val->type == CBOR_TYPE_TAG) {
-        val->tag.content->parent = NULL;
-        cbor_destroy(val->tag.content);
-        val->tag.item = 0;
-        val->tag.content = NULL;
+        if (next) {
+            next->parent = val;
+            val = next;
+        } else {
+            next = val->parent;
+            free(val);
+            val = next;
+        }
     }
-    free(val);
     return 0;
 }
 
@@ -150,6 +161,11 @@ static size_t cbor_blob_avalible(cbor_value_t *val, size_t size) {
     return 0;
 }
 
+/* make room for `size` more bytes and the terminator, so appends don't realloc */
+int cbor__blob_reserve(cbor_value_t *val, size_t size) {
+    return cbor_blob_avalible(val, size) > size ? 0 : -1;
+}
+
 int cbor_blob_append(cbor_value_t *val, const char *src, size_t length) {
     if (cbor_blob_avalible(val, length) > length) {
         memcpy(val->blob.ptr + val->blob.length, src, length);
@@ -395,7 +411,280 @@ int cbor_container_concat(cbor_value_t *dst, cbor_value_t *src) {
     return -1;
 }
 
-cbor_value_t *cbor_loads(const char *src, size_t *length) {
+static double cbor__half_to_double(uint16_t u16) {
+    int exp = (u16 >> 10) & 0x1F;
+    int mant = u16 & 0x3FF;
+    double val;
+
+    if (exp == 31) { /* infinity, nan: keep the payload */
+        union {
+            uint64_t u64;
+            double dbl;
+        } f64_val;
+        f64_val.u64 = ((uint64_t)(u16 & 0x8000) << 48) | ((uint64_t)0x7FF << 52) | ((uint64_t)mant << 42);
+        return f64_val.dbl;
+    }
+    if (exp == 0) {
+        val = ldexp(mant, -24);
+    } else {
+        val = ldexp(mant + 1024, exp - 25);
+    }
+    return u16 & 0x8000 ? -val : val;
+}
+
+static double cbor__float_to_double(uint32_t u32) {
+    union {
+        uint32_t u32;
+        float flt;
+    } f32_val;
+    f32_val.u32 = u32;
+    return f32_val.flt;
+}
+
+/* return: offset of the item's payload, 0 on truncated or reserved head */
+size_t cbor__read_head(const char *src, size_t length, size_t offset, cbor_type *type, uint8_t *addition, uint64_t *arg) {
+    if (offset >= length) {
+        return 0;
+    }
+    *type = (unsigned char)src[offset] >> 5;
+    *addition = (unsigned char)src[offset] & 0x1F;
+    offset++;
+    if (*addition < 24) {
+        *arg = *addition;
+    } else if (*addition == 24 && offset + 1 <= length) { /* uint8_t */
+        *arg = (unsigned char)src[offset];
+        offset++;
+    } else if (*addition == 25 && offset + 2 <= length) { /* uint16_t */
+        *arg = be16toh(*(uint16_t *)&src[offset]);
+        offset += 2;
+    } else if (*addition == 26 && offset + 4 <= length) { /* uint32_t */
+        *arg = be32toh(*(uint32_t *)&src[offset]);
+        offset += 4;
+    } else if (*addition == 27 && offset + 8 <= length) { /* uint64_t */
+        *arg = be64toh(*(uint64_t *)&src[offset]);
+        offset += 8;
+    } else if (*addition == 31) { /* indefinite or break */
+        *arg = 0;
+    } else {
+        return 0;
+    }
+    return offset;
+}
+
+/*
+ * Walk the item without building it. Definite containers only add to the
+ * number of pending items, so `stack` is only used when crossing into or out
+ * of an indefinite container.
+ */
+size_t cbor_skip(const char *src, size_t length, size_t offset) {
+    uint64_t stack[CBOR_SKIP_DEPTH];
+    uint64_t remain = 1;
+    int depth = 0;
+
+    if (src == NULL) {
+        return 0;
+    }
+
+    for (;;) {
+        cbor_type type;
+        uint8_t addition;
+        uint64_t arg;
+
+        if (remain == 0) {
+            if (depth == 0) {
+                return offset;
+            }
+            remain = stack[--depth];
+            continue;
+        }
+        if (offset >= length) {
+            return 0;
+        }
+        if (remain == CBOR__INDEFINITE && (unsigned char)src[offset] == 0xFF) {
+            offset++;
+            remain = 0;
+            continue;
+        }
+        if (remain != CBOR__INDEFINITE) {
+            remain--;
+        }
+
+        offset = cbor__read_head(src, length, offset, &type, &addition, &arg);
+        if (offset == 0) {
+            return 0;
+        }
+
+        switch (type) {
+        case CBOR_TYPE_UINT:
+        case CBOR_TYPE_NEGINT: {
+            if (addition == 31) {
+                return 0;
+            }
+            break;
+        }
+        case CBOR_TYPE_BYTESTRING:
+        case CBOR_TYPE_STRING: {
+            if (addition != 31) {
+                if (arg > length - offset) {
+                    return 0;
+                }
+                offset += arg;
+                break;
+            }
+            /* indefinite: definite chunks of the same major type until break */
+            while (offset < length && (unsigned char)src[offset] != 0xFF) {
+                cbor_type chunk;
+                offset = cbor__read_head(src, length, offset, &chunk, &addition, &arg);
+                if (offset == 0 || chunk != type || addition == 31 || arg > length - offset) {
+                    return 0;
+                }
+                offset += arg;
+            }
+            if (offset >= length) {
+                return 0;
+            }
+            offset++;
+            break;
+        }
+        case CBOR_TYPE_ARRAY:
+        case CBOR_TYPE_MAP:
+        case CBOR_TYPE_TAG: {
+            uint64_t items;
+            if (type == CBOR_TYPE_TAG) {
+                if (addition == 31) {
+                    return 0;
+                }
+                items = 1;
+            } else if (addition == 31) {
+                items = CBOR__INDEFINITE;
+            } else {
+                /* every item takes at least one byte */
+                if (arg > length - offset || (type == CBOR_TYPE_MAP && arg > (length - offset) / 2)) {
+                    return 0;
+                }
+                items = type == CBOR_TYPE_MAP ? arg * 2 : arg;
+            }
+            if (items == CBOR__INDEFINITE || remain == CBOR__INDEFINITE) {
+                if (depth == CBOR_SKIP_DEPTH) {
+                    return 0;
+                }
+                stack[depth++] = remain;
+                remain = items;
+            } else {
+                remain += items;
+            }
+            break;
+        }
+        case CBOR_TYPE_SIMPLE: {
+            if (addition == 31) { /* break outside of an indefinite container */
+                return 0;
+            }
+            break;
+        }
+        default:
+            return 0;
+        }
+    }
+}
+
+size_t cbor_item_length(const char *src, size_t length, size_t offset) {
+    size_t next = cbor_skip(src, length, offset);
+    if (next == 0) {
+        return 0;
+    }
+    return next - offset;
+}
+
+static bool cbor__raw_real(cbor_type type, uint8_t addition, uint64_t arg, double *real) {
+    if (type != CBOR_TYPE_SIMPLE) {
+        return false;
+    }
+    if (addition == 25) {
+        *real = cbor__half_to_double(arg);
+    } else if (addition == 26) {
+        *real = cbor__float_to_double(arg);
+    } else if (addition == 27) {
+        union {
+            uint64_t u64;
+            double dbl;
+        } var;
+        var.u64 = arg;
+        *real = var.dbl;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+long long cbor_raw_integer(const char *src, size_t length, size_t offset) {
+    cbor_type type;
+    uint8_t addition;
+    uint64_t arg;
+    double real;
+    if (src == NULL || cbor__read_head(src, length, offset, &type, &addition, &arg) == 0) {
+        return 0;
+    }
+    if (type == CBOR_TYPE_UINT) {
+        return cbor__uint_to_integer(arg);
+    }
+    if (type == CBOR_TYPE_NEGINT) {
+        return cbor__negint_to_integer(arg);
+    }
+    if (cbor__raw_real(type, addition, arg, &real)) {
+        return cbor__real_to_integer(real);
+    }
+    return 0;
+}
+
+double cbor_raw_real(const char *src, size_t length, size_t offset) {
+    cbor_type type;
+    uint8_t addition;
+    uint64_t arg;
+    double real;
+    if (src == NULL || cbor__read_head(src, length, offset, &type, &addition, &arg) == 0) {
+        return .0f;
+    }
+    if (type == CBOR_TYPE_UINT) {
+        return arg;
+    }
+    if (type == CBOR_TYPE_NEGINT) {
+        return -1.0 - (double)arg;
+    }
+    if (cbor__raw_real(type, addition, arg, &real)) {
+        return real;
+    }
+    return .0f;
+}
+
+bool cbor_raw_boolean(const char *src, size_t length, size_t offset) {
+    if (src == NULL || offset >= length) {
+        return false;
+    }
+    return (unsigned char)src[offset] == ((CBOR_TYPE_SIMPLE << 5) | CBOR_SIMPLE_TRUE);
+}
+
+/* return: payload of a definite (byte) string, NULL otherwise, not NUL terminated */
+const char *cbor_raw_string(const char *src, size_t length, size_t offset, size_t *size) {
+    cbor_type type;
+    uint8_t addition;
+    uint64_t arg;
+    if (src == NULL) {
+        return NULL;
+    }
+    offset = cbor__read_head(src, length, offset, &type, &addition, &arg);
+    if (offset == 0
+        || (type != CBOR_TYPE_STRING && type != CBOR_TYPE_BYTESTRING)
+        || addition == 31
+        || arg > length - offset) {
+        return NULL;
+    }
+    if (size) {
+        *size = arg;
+    }
+    return src + offset;
+}
+
+static cbor_value_t *cbor__loads(const char *src, size_t *length, int flags) {
     cbor_type type;
     char addition;
     cbor_value_t *val = NULL;
@@ -482,7 +771,7 @@ cbor_value_t *cbor_loads(const char *src, size_t *length) {
                     break;
                 }
                 size_t remain = *length - offset;
-                cbor_value_t *sub = cbor_loads(src + offset, &remain);
+                cbor_value_t *sub = cbor__loads(src + offset, &remain, flags);
                 if (sub && sub->type == CBOR_TYPE_BYTESTRING) {
                     cbor_blob_append(val, sub->blob.ptr, sub->blob.length);
                     val->blob.ptr[val->blob.length] = 0;
@@ -539,7 +828,7 @@ cbor_value_t *cbor_loads(const char *src, size_t *length) {
                     break;
                 }
                 size_t remain = *length - offset;
-                cbor_value_t *sub = cbor_loads(src + offset, &remain);
+                cbor_value_t *sub = cbor__loads(src + offset, &remain, flags);
                 if (sub && sub->type == CBOR_TYPE_STRING) {
                     cbor_blob_append(val, sub->blob.ptr, sub->blob.length);
                     val->blob.ptr[val->blob.length] = 0;
@@ -559,7 +848,8 @@ cbor_value_t *cbor_loads(const char *src, size_t *length) {
             }
         }
         if (addition != 31) {
-            if (offset + len <= *length) {
+            if (offset + len <= *length
+                && (!(flags & CBOR_LOADS_VALIDATE_UTF8) || cbor__utf8_check(&src[offset], len) == (size_t)len)) {
                 cbor_blob_append(val, &src[offset], len);
                 val->blob.ptr[val->blob.length] = 0;
                 offset += len;
@@ -596,7 +886,7 @@ cbor_value_t *cbor_loads(const char *src, size_t *length) {
                     break;
                 }
                 size_t remain = *length - offset;
-                cbor_value_t *elm = cbor_loads(src + offset, &remain);
+                cbor_value_t *elm = cbor__loads(src + offset, &remain, flags);
                 if (elm && offset + remain <= *length) {
                     offset += remain;
                     cbor_container_insert_tail(val, elm);
@@ -612,7 +902,7 @@ cbor_value_t *cbor_loads(const char *src, size_t *length) {
         if (addition != 31) {
             while (len > 0 && offset < *length) {
                 size_t remain = *length - offset;
-                cbor_value_t *elm = cbor_loads(src + offset, &remain);
+                cbor_value_t *elm = cbor__loads(src + offset, &remain, flags);
                 if (elm && offset + remain <= *length) {
                     offset += remain;
                     cbor_container_insert_tail(val, elm);
@@ -658,11 +948,11 @@ cbor_value_t *cbor_loads(const char *src, size_t *length) {
                     break;
                 }
                 size_t remain = *length - offset;
-                cbor_value_t *k = cbor_loads(src + offset, &remain);
+                cbor_value_t *k = cbor__loads(src + offset, &remain, flags);
                 if (k && offset + remain <= *length) {
                     offset += remain;
                     remain = *length - offset;
-                    cbor_value_t *v = cbor_loads(src + offset, &remain);
+                    cbor_value_t *v = cbor__loads(src + offset, &remain, flags);
                     if (v && offset + remain <= *length) {
                         offset += remain;
                         cbor_value_t *pair = cbor_create(CBOR__TYPE_PAIR);
@@ -690,11 +980,11 @@ cbor_value_t *cbor_loads(const char *src, size_t *length) {
         if (addition != 31) {
             while (len > 0 && offset < *length) {
                 size_t remain = *length - offset;
-                cbor_value_t *k = cbor_loads(src + offset, &remain);
+                cbor_value_t *k = cbor__loads(src + offset, &remain, flags);
                 if (k && offset + remain <= *length) {
                     offset += remain;
                     remain = *length - offset;
-                    cbor_value_t *v = cbor_loads(src + offset, &remain);
+                    cbor_value_t *v = cbor__loads(src + offset, &remain, flags);
                     if (v && offset + remain <= *length) {
                         offset += remain;
                         cbor_value_t *pair = cbor_create(CBOR__TYPE_PAIR);
@@ -745,9 +1035,19 @@ cbor_value_t *cbor_loads(const char *src, size_t *length) {
             offset += 8;
         }
         size_t remain = *length - offset;
-        val->tag.content = cbor_loads(src + offset, &remain);
+        val->tag.content = cbor__loads(src + offset, &remain,
+            val->tag.item == CBOR__TAG_STRINGREF_NAMESPACE ? flags | CBOR__LOADS_NAMESPACE : flags);
         if (val->tag.content && offset + remain <= *length) {
             offset += remain;
+            if ((flags & (CBOR_LOADS_NATIVE_TYPED_ARRAY | CBOR__LOADS_NAMESPACE)) == CBOR_LOADS_NATIVE_TYPED_ARRAY) {
+                cbor__typed_array_normalize(val);
+            }
+            if (val->tag.item == CBOR__TAG_STRINGREF_NAMESPACE && !(flags & CBOR__LOADS_NAMESPACE)) {
+                val = cbor__stringref_resolve(val, flags);
+                if (val == NULL) {
+                    offset = 0;
+                }
+            }
         } else {
             /* error */
             cbor_destroy(val);
@@ -767,7 +1067,7 @@ cbor_value_t *cbor_loads(const char *src, size_t *length) {
         } else if (addition == 21) { /* True */
             val->simple.ctrl = CBOR_SIMPLE_TRUE;
         } else if (addition == 22) { /* Null */
-            val->simple.ctrl = CBOR_SIMPLE_NONE;
+            val->simple.ctrl = CBOR_SIMPLE_NULL;
         } else if (addition == 23) { /* Undefined value */
             val->simple.ctrl = CBOR_SIMPLE_UNDEF;
         } else if (addition == 24 && offset + 1 <= *length) { /* Simple value: extension */
@@ -775,53 +1075,12 @@ cbor_value_t *cbor_loads(const char *src, size_t *length) {
             val->simple.ctrl = src[offset];
             offset++;
         } else if (addition == 25 && offset + 2 <= *length) { /* half float */
-            union {
-                uint64_t u64;
-                double dbl;
-            } f64_val;
             val->simple.ctrl = CBOR_SIMPLE_REAL;
-            uint16_t u16 = be16toh(*(uint16_t *)&src[offset]);
-            int sign = (u16 & 0x8000) >> 15;
-            int exp = (u16 >> 10) & 0x1F;
-            uint64_t frac = u16 & 0x3FF;
-
-            f64_val.u64 = frac << (52 - 10);
-            if (sign) {
-                f64_val.u64 |= (uint64_t)1 << 63;
-            }
-
-            if (exp == 0) {
-                /* do nothing */
-            } else if (exp == 31) {
-                f64_val.u64 |= (uint64_t)0x7FF << 52;
-            } else {
-                f64_val.u64 |= (uint64_t)(exp - 15 + 1023) << 52;
-            }
-            val->simple.real = f64_val.dbl;
+            val->simple.real = cbor__half_to_double(be16toh(*(uint16_t *)&src[offset]));
             offset += 2;
         } else if (addition == 26 && offset + 4 <= *length) { /* float */
-            union {
-                uint64_t u64;
-                double dbl;
-            } f64_val;
             val->simple.ctrl = CBOR_SIMPLE_REAL;
-            uint32_t u32 = be32toh(*(uint32_t *)&src[offset]);
-            int sign = u32 >> 31;
-            int exp = (u32 >> 23) & 0xFF;
-            uint64_t frac = u32 & 0x7FFFFF;
-
-            f64_val.u64 = frac << (52 - 23);
-            if (sign) {
-                f64_val.u64 |= (uint64_t)1 << 63;
-            }
-            if (exp == 0) {
-                /* do nothing */
-            } else if (exp == 255) {
-                f64_val.u64 |= (uint64_t)0x7FF << 52;
-            } else {
-                f64_val.u64 |= (uint64_t)(exp - 127 + 1023) << 52;
-            }
-            val->simple.real = f64_val.dbl;
+            val->simple.real = cbor__float_to_double(be32toh(*(uint32_t *)&src[offset]));
             offset += 4;
         } else if (addition == 27 && offset + 8 <= *length) { /* double */
             union {
@@ -844,6 +1103,14 @@ cbor_value_t *cbor_loads(const char *src, size_t *length) {
     return val;
 }
 
+cbor_value_t *cbor_loads_ex(const char *src, size_t *length, int flags) {
+    return cbor__loads(src, length, flags);
+}
+
+cbor_value_t *cbor_loads(const char *src, size_t *length) {
+    return cbor__loads(src, length, 0);
+}
+
 /* IEEE 754
  *
  *             sign | exponent | fraction
@@ -854,272 +1121,313 @@ cbor_value_t *cbor_loads(const char *src, size_t *length) {
  * -----------+-----+----------+---------
  *     double |  1  |   11     |   52
  *
+ * return: additional information (25, 26 or 27) of the shortest form
+ *         that keeps the value, `bits` holds the encoded argument
  */
-int cbor__dumps(const cbor_value_t *src, cbor_value_t *dst) {
-    uint8_t type = src->type;
-    type <<= 5;
+uint8_t cbor__real_narrow(double real, uint64_t *bits) {
+    union {
+        uint64_t u64;
+        double dbl;
+    } f64_val;
+    union {
+        uint32_t u32;
+        float flt;
+    } f32_val;
+    uint64_t frac;
+    uint32_t sign, mant;
+    int exponent;
+
+    f64_val.dbl = real;
+    sign = f64_val.u64 >> 63;
+    frac = f64_val.u64 & 0xFFFFFFFFFFFFF;
+
+    if (((f64_val.u64 >> 52) & 0x7FF) == 0x7FF) { /* infinity, nan: keep the payload */
+        if ((frac & (((uint64_t)1 << 42) - 1)) == 0) {
+            *bits = (sign << 15) | 0x7C00 | (frac >> 42);
+            return 25;
+        } else if ((frac & (((uint64_t)1 << 29) - 1)) == 0) {
+            *bits = (sign << 31) | 0x7F800000 | (frac >> 29);
+            return 26;
+        }
+        *bits = f64_val.u64;
+        return 27;
+    }
+
+    f32_val.flt = (float)real;
+    if ((double)f32_val.flt != real) {
+        *bits = f64_val.u64;
+        return 27;
+    }
+
+    /* exact as float, try half from the float bits */
+    exponent = (int)((f32_val.u32 >> 23) & 0xFF) - 127;
+    mant = f32_val.u32 & 0x7FFFFF;
+    if ((f32_val.u32 & 0x7FFFFFFF) == 0) {
+        *bits = sign << 15;
+        return 25;
+    }
+    if (exponent >= -14 && exponent <= 15) {
+        if (cbor__ctz32(mant | 0x800000) >= 13) {
+            *bits = (sign << 15) | ((uint32_t)(exponent + 15) << 10) | (mant >> 13);
+            return 25;
+        }
+    } else if (exponent >= -24 && exponent < -14) {
+        /* half subnormal: (1.mant * 2^exponent) / 2^-24 must be an integer */
+        int shift = -1 - exponent;
+        mant |= 0x800000;
+        if (cbor__ctz32(mant) >= shift) {
+            *bits = (sign << 15) | (mant >> shift);
+            return 25;
+        }
+    }
+    *bits = f32_val.u32;
+    return 26;
+}
+
+/* additional information of a simple value other than a real */
+static uint8_t cbor__simple_addition(cbor_simple ctrl) {
+    if (ctrl == CBOR_SIMPLE_FALSE) {
+        return 20;
+    } else if (ctrl == CBOR_SIMPLE_TRUE) {
+        return 21;
+    } else if (ctrl == CBOR_SIMPLE_NONE || ctrl == CBOR_SIMPLE_NULL) {
+        return 22;
+    } else if (ctrl == CBOR_SIMPLE_UNDEF) {
+        return 23;
+    } else if (ctrl < 20) {
+        return (uint8_t)ctrl;
+    }
+    return 24;
+}
+
+size_t cbor_encoded_size(const cbor_value_t *src) {
+    size_t size = 0;
     switch (src->type) {
     case CBOR_TYPE_UINT:
-    case CBOR_TYPE_NEGINT:  {
-        if (src->uint < 24) {
-            type |= (uint8_t)src->uint;
-            cbor_blob_append_byte(dst, type);
-        } else if (src->uint <= UINT8_MAX) {
-            type |= 24;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_byte(dst, src->uint);
-        } else if (src->uint <= UINT16_MAX) {
-            type |= 25;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_word(dst, src->uint);
-        } else if (src->uint <= UINT32_MAX) {
-            type |= 26;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_dword(dst, src->uint);
-        } else if (src->uint <= UINT64_MAX) {
-            type |= 27;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_qword(dst, src->uint);
-        }
+    case CBOR_TYPE_NEGINT: {
+        size = cbor__head_size(src->uint);
         break;
     }
     case CBOR_TYPE_BYTESTRING:
     case CBOR_TYPE_STRING: {
-        if (src->blob.length < 24) {
-            type |= (uint8_t)src->blob.length;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append(dst, src->blob.ptr, src->blob.length);
-        } else if (src->blob.length <= UINT8_MAX) {
-            type |= 24;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_byte(dst, src->blob.length);
-            cbor_blob_append(dst, src->blob.ptr, src->blob.length);
-        } else if (src->blob.length <= UINT16_MAX) {
-            type |= 25;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_word(dst, src->blob.length);
-            cbor_blob_append(dst, src->blob.ptr, src->blob.length);
-        } else if (src->blob.length <= UINT32_MAX) {
-            type |= 26;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_dword(dst, src->blob.length);
-            cbor_blob_append(dst, src->blob.ptr, src->blob.length);
-        } else if (src->blob.length <= UINT64_MAX) {
-            type |= 27;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_qword(dst, src->blob.length);
-            cbor_blob_append(dst, src->blob.ptr, src->blob.length);
-        }
+        size = cbor__head_size(src->blob.length) + src->blob.length;
         break;
     }
     case CBOR_TYPE_ARRAY: {
         cbor_value_t *var;
-        unsigned long long size = cbor_container_size(src);
-        if (size < 24) {
-            type |= (uint8_t)size;
-            cbor_blob_append_byte(dst, type);
-        } else if (size <= UINT8_MAX) {
-            type |= 24;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_byte(dst, size);
-        } else if (size <= UINT16_MAX) {
-            type |= 25;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_word(dst, size);
-        } else if (size <= UINT32_MAX) {
-            type |= 26;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_dword(dst, size);
-        } else if (size <= UINT64_MAX) {
-            type |= 27;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_qword(dst, size);
-        }
-        for (var = cbor_container_first(src);
-             var != NULL;
-             var = cbor_container_next(src, var)) {
-            cbor__dumps(var, dst);
+        unsigned long long count = 0;
+        list_foreach(var, &src->container, entry) {
+            size += cbor_encoded_size(var);
+            count++;
         }
+        size += cbor__head_size(count);
         break;
     }
     case CBOR_TYPE_MAP: {
         cbor_value_t *var;
-        unsigned long long size = cbor_container_size(src);
-        if (size < 24) {
-            type |= (uint8_t)size;
-            cbor_blob_append_byte(dst, type);
-        } else if (size <= UINT8_MAX) {
-            type |= 24;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_byte(dst, size);
-        } else if (size <= UINT16_MAX) {
-            type |= 25;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_word(dst, size);
-        } else if (size <= UINT32_MAX) {
-            type |= 26;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_dword(dst, size);
-        } else if (size <= UINT64_MAX) {
-            type |= 27;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_qword(dst, size);
-        }
-        for (var = cbor_container_first(src);
-             var != NULL;
-             var = cbor_container_next(src, var)) {
-            cbor__dumps(var->pair.key, dst);
-            cbor__dumps(var->pair.value, dst);
+        unsigned long long count = 0;
+        list_foreach(var, &src->container, entry) {
+            size += cbor_encoded_size(var->pair.key);
+            size += cbor_encoded_size(var->pair.value);
+            count++;
         }
+        size += cbor__head_size(count);
         break;
     }
     case CBOR_TYPE_TAG: {
-        if (src->tag.item < 24) {
-            type |= (uint8_t)src->tag.item;
-            cbor_blob_append_byte(dst, type);
-        } else if (src->tag.item <= UINT8_MAX) {
-            type |= 24;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_byte(dst, src->tag.item);
-        } else if (src->tag.item <= UINT16_MAX) {
-            type |= 25;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_word(dst, src->tag.item);
-        } else if (src->tag.item <= UINT32_MAX) {
-            type |= 26;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_dword(dst, src->tag.item);
-        } else if (src->tag.item <= UINT64_MAX) {
-            type |= 27;
-            cbor_blob_append_byte(dst, type);
-            cbor_blob_append_qword(dst, src->tag.item);
-        }
-        cbor__dumps(src->tag.content, dst);
+        size = cbor__head_size(src->tag.item) + cbor_encoded_size(src->tag.content);
         break;
     }
     case CBOR_TYPE_SIMPLE: {
-        uint8_t type = src->type;
-        type <<= 5;
-        if (src->simple.ctrl == CBOR_SIMPLE_FALSE) {
-            type |= 20;
-            cbor_blob_append_byte(dst, type);
-        } else if (src->simple.ctrl == CBOR_SIMPLE_TRUE) {
-            type |= 21;
-            cbor_blob_append_byte(dst, type);
-        } else if (src->simple.ctrl == CBOR_SIMPLE_NONE) {
-            type |= 22;
-            cbor_blob_append_byte(dst, type);
-        } else if (src->simple.ctrl == CBOR_SIMPLE_UNDEF) {
-            type |= 23;
-            cbor_blob_append_byte(dst, type);
-        } else if (src->simple.ctrl == CBOR_SIMPLE_REAL) {
-            union {
-                uint64_t u64;
-                double dbl;
-            } f64_val;
-            f64_val.dbl = src->simple.real;
-            int exponent = (f64_val.u64 >> 52) & 0x7FF;
-            int sign = f64_val.u64 >> 63;
-            uint64_t frac = f64_val.u64 & 0xFFFFFFFFFFFFF;
-            int frac_bitcnt;
-            if (frac) {
-                for (frac_bitcnt = 0; frac_bitcnt < 52; frac_bitcnt++) {
-                    if (frac & 1) {
-                        break;
-                    }
-                    frac >>= 1;
-                }
-            } else {
-                frac_bitcnt = 52;
-            }
+        if (src->simple.ctrl == CBOR_SIMPLE_REAL) {
+            uint64_t bits;
+            size = 1 + (2 << (cbor__real_narrow(src->simple.real, &bits) - 25));
+        } else {
+            size = cbor__simple_addition(src->simple.ctrl) < 24 ? 1 : 2;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    return size;
+}
 
-            frac_bitcnt = 52 - frac_bitcnt;
-            frac = f64_val.u64 & 0xFFFFFFFFFFFFF;
+static bool cbor__key_is_scalar(const cbor_value_t *key) {
+    return key->type == CBOR_TYPE_UINT
+        || key->type == CBOR_TYPE_NEGINT
+        || key->type == CBOR_TYPE_STRING
+        || key->type == CBOR_TYPE_BYTESTRING;
+}
 
-            if (exponent == 0 || exponent == 0x7FF) { /* subnormal double, infinity, nan */
-                if (frac_bitcnt <= 10) {
-                    type |= 25;
-                    cbor_blob_append_byte(dst, type);
+/*
+ * Bytewise order of the encoded keys (RFC 8949, 4.2.1). Shortest-form heads
+ * sort like (major type, argument), so integer and string keys are compared
+ * without encoding them.
+ */
+static int cbor__key_compare(const void *a, const void *b) {
+    const cbor_value_t *ka = (*(const cbor_value_t **)a)->pair.key;
+    const cbor_value_t *kb = (*(const cbor_value_t **)b)->pair.key;
+    bool blob = ka->type == CBOR_TYPE_STRING || ka->type == CBOR_TYPE_BYTESTRING;
+    unsigned long long la = blob ? ka->blob.length : ka->uint;
+    unsigned long long lb = blob ? kb->blob.length : kb->uint;
+
+    if (ka->type != kb->type) {
+        return ka->type < kb->type ? -1 : 1;
+    }
+    if (la != lb) {
+        return la < lb ? -1 : 1;
+    }
+    return blob ? memcmp(ka->blob.ptr, kb->blob.ptr, la) : 0;
+}
+
+/* a pair with its key in deterministic encoding */
+typedef struct {
+    cbor_value_t *pair;
+    const char *key;
+    size_t length;
+} cbor__sort_key_t;
+
+static int cbor__encoded_key_compare(const void *a, const void *b) {
+    const cbor__sort_key_t *ka = (const cbor__sort_key_t *)a;
+    const cbor__sort_key_t *kb = (const cbor__sort_key_t *)b;
+    int r = memcmp(ka->key, kb->key, ka->length < kb->length ? ka->length : kb->length);
+    if (r == 0 && ka->length != kb->length) {
+        r = ka->length < kb->length ? -1 : 1;
+    }
+    return r;
+}
+
+/* fill `pairs` (room for every pair of `map`) in deterministic key order.
+ * Unless every key is an integer or a string, the keys are encoded once,
+ * themselves deterministically, and sorted by those bytes
+ * return: 0, -1 when out of memory */
+int cbor__sort_pairs(const cbor_value_t *map, cbor_value_t **pairs) {
+    cbor_value_t *var;
+    cbor__sort_key_t *keys;
+    size_t count = 0, size = 0, i;
+    bool scalar = true;
+    char *ptr;
 
-                    uint16_t u16 = frac >> (52 - 10);
-                    if (sign) {
-                        u16 |= (1 << 15);
-                    }
-                    if (exponent) {
-                        u16 |= 0x1F << 10;
-                    }
-                    cbor_blob_append_word(dst, u16);
-                } else if (frac_bitcnt <= 23) {
-                    type |= 26;
-                    cbor_blob_append_byte(dst, type);
-
-                    uint32_t u32 = frac >> (52 - 23);
-                    if (sign) {
-                        u32 |= (1 << 31);
-                    }
-                    if (exponent) {
-                        u32 |= 0x3F << 23;
-                    }
-                    cbor_blob_append_dword(dst, u32);
-                } else {
-                    type |= 27;
-                    cbor_blob_append_byte(dst, type);
+    list_foreach(var, &map->container, entry) {
+        pairs[count++] = var;
+        scalar = scalar && cbor__key_is_scalar(var->pair.key);
+    }
+    if (scalar) {
+        qsort(pairs, count, sizeof(cbor_value_t *), cbor__key_compare);
+        return 0;
+    }
+    for (i = 0; i < count; i++) {
+        size += cbor_encoded_size(pairs[i]->pair.key);
+    }
+    keys = (cbor__sort_key_t *)malloc(sizeof(cbor__sort_key_t) * count + size);
+    if (keys == NULL) {
+        return -1;
+    }
+    ptr = (char *)(keys + count);
+    for (i = 0; i < count; i++) {
+        keys[i].pair = pairs[i];
+        keys[i].key = ptr;
+        ptr = cbor__dumps(pairs[i]->pair.key, ptr, CBOR_DUMPS_DETERMINISTIC);
+        if (ptr == NULL) {
+            free(keys);
+            return -1;
+        }
+        keys[i].length = ptr - keys[i].key;
+    }
+    qsort(keys, count, sizeof(cbor__sort_key_t), cbor__encoded_key_compare);
+    for (i = 0; i < count; i++) {
+        pairs[i] = keys[i].pair;
+    }
+    free(keys);
+    return 0;
+}
 
-                    uint64_t u64 = frac;
-                    if (sign) {
-                        u64 |= (uint64_t)1 << 63;
-                    }
-                    if (exponent) {
-                        u64 |= (uint64_t)0x7FF << 52;
-                    }
-                    cbor_blob_append_qword(dst, u64);
-                }
-            } else {
-                exponent -= 1023;
-                if (exponent >= -14
-                    && exponent <= 15
-                    && frac_bitcnt <= 10) {
-                    type |= 25;
-                    cbor_blob_append_byte(dst, type);
-
-                    uint16_t u16 = frac >> (52 - 10);
-                    if (sign) {
-                        u16 |= (1 << 15);
-                    }
-                    u16 |= (exponent + 15) << 10;
-                    cbor_blob_append_word(dst, u16);
-                } else if (exponent >= -126
-                           && exponent <= 127
-                           && frac_bitcnt <= 23) {
-                    type |= 26;
-                    cbor_blob_append_byte(dst, type);
-
-                    uint32_t u32 = frac >> (52 - 23);
-                    if (sign) {
-                        u32 |= (1 << 31);
-                    }
-                    u32 |= (exponent + 127) << 23;
-                    cbor_blob_append_dword(dst, u32);
-                } else {
-                    type |= 27;
-                    cbor_blob_append_byte(dst, type);
+static char *cbor__dumps_sorted_map(const cbor_value_t *src, char *ptr, int flags) {
+    cbor_value_t *stack[16];
+    cbor_value_t **pairs = stack;
+    size_t i, count = cbor_container_size(src);
 
-                    uint64_t u64 = frac;
-                    if (sign) {
-                        u64 |= (uint64_t)1 << 63;
-                    }
-                    u64 |= (uint64_t)(exponent + 1023) << 52;
-                    cbor_blob_append_qword(dst, u64);
-                }
+    if (count > sizeof(stack) / sizeof(stack[0])) {
+        pairs = (cbor_value_t **)malloc(sizeof(cbor_value_t *) * count);
+        if (pairs == NULL) {
+            return NULL;
+        }
+    }
+    if (cbor__sort_pairs(src, pairs) != 0) {
+        ptr = NULL;
+    } else {
+        ptr = cbor__write_head(ptr, src->type, count);
+    }
+    for (i = 0; i < count && ptr; i++) {
+        ptr = cbor__dumps(pairs[i]->pair.key, ptr, flags);
+        if (ptr) {
+            ptr = cbor__dumps(pairs[i]->pair.value, ptr, flags);
+        }
+    }
+    if (pairs != stack) {
+        free(pairs);
+    }
+    return ptr;
+}
+
+/* write `src` at `ptr`, which must hold cbor_encoded_size(src) bytes
+ * return: end of the written item, NULL when a deterministic map could not be sorted */
+char *cbor__dumps(const cbor_value_t *src, char *ptr, int flags) {
+    switch (src->type) {
+    case CBOR_TYPE_UINT:
+    case CBOR_TYPE_NEGINT:  {
+        ptr = cbor__write_head(ptr, src->type, src->uint);
+        break;
+    }
+    case CBOR_TYPE_BYTESTRING:
+    case CBOR_TYPE_STRING: {
+        ptr = cbor__write_head(ptr, src->type, src->blob.length);
+        memcpy(ptr, src->blob.ptr, src->blob.length);
+        ptr += src->blob.length;
+        break;
+    }
+    case CBOR_TYPE_ARRAY: {
+        cbor_value_t *var;
+        ptr = cbor__write_head(ptr, src->type, cbor_container_size(src));
+        list_foreach(var, &src->container, entry) {
+            if ((ptr = cbor__dumps(var, ptr, flags)) == NULL) {
+                break;
             }
+        }
+        break;
+    }
+    case CBOR_TYPE_MAP: {
+        cbor_value_t *var;
+        if (flags & CBOR_DUMPS_DETERMINISTIC) {
+            ptr = cbor__dumps_sorted_map(src, ptr, flags);
+            break;
+        }
+        ptr = cbor__write_head(ptr, src->type, cbor_container_size(src));
+        list_foreach(var, &src->container, entry) {
+            ptr = cbor__dumps(var->pair.key, ptr, flags);
+            if (ptr == NULL || (ptr = cbor__dumps(var->pair.value, ptr, flags)) == NULL) {
+                break;
+            }
+        }
+        break;
+    }
+    case CBOR_TYPE_TAG: {
+        ptr = cbor__write_head(ptr, src->type, src->tag.item);
+        ptr = cbor__dumps(src->tag.content, ptr, flags);
+        break;
+    }
+    case CBOR_TYPE_SIMPLE: {
+        uint8_t type = CBOR_TYPE_SIMPLE << 5;
+        if (src->simple.ctrl == CBOR_SIMPLE_REAL) {
+            uint64_t bits;
+            uint8_t addition = cbor__real_narrow(src->simple.real, &bits);
+            ptr = cbor__write_head_width(ptr, CBOR_TYPE_SIMPLE, addition, bits);
         } else {
-            if (src->simple.ctrl < 20) {
-                type |= (unsigned char)src->simple.ctrl;
-                cbor_blob_append_byte(dst, type);
-            } else {
-                type |= 24;
-                cbor_blob_append_byte(dst, type);
-                cbor_blob_append_byte(dst, (unsigned char)src->simple.ctrl);
+            uint8_t addition = cbor__simple_addition(src->simple.ctrl);
+            *ptr++ = type | addition;
+            if (addition == 24) {
+                *ptr++ = (unsigned char)src->simple.ctrl;
             }
         }
         break;
@@ -1127,36 +1435,69 @@ int cbor__dumps(const cbor_value_t *src, cbor_value_t *dst) {
     default:
         break;
     }
-    return 0;
+    return ptr;
 }
 
-char *cbor_dumps(const cbor_value_t *src, size_t *length) {
-    cbor_value_t *dst;
-    char *ptr;
+/* two passes: size the output, then write it into a single allocation */
+char *cbor_dumps_ex(const cbor_value_t *src, size_t *length, int flags) {
+    size_t size;
+    char *ptr, *end;
 
     if (!src || !length) {
         return NULL;
     }
-    dst = cbor_create(CBOR_TYPE_BYTESTRING);
-    cbor__dumps(src, dst);
-    *length = cbor_string_size(dst);
-    ptr = cbor_string_release(dst);
-    cbor_destroy(dst);
+    if (flags & CBOR_DUMPS_STRINGREF) {
+        return cbor__dumps_stringref(src, length, flags);
+    }
+    size = cbor_encoded_size(src);
+    ptr = (char *)malloc(size + 1);
+    if (ptr == NULL) {
+        return NULL;
+    }
+    end = cbor__dumps(src, ptr, flags);
+    if (end == NULL) {
+        free(ptr);
+        return NULL;
+    }
+    assert(end == ptr + size);
+    *end = 0;
+    *length = size;
     return ptr;
 }
 
+char *cbor_dumps(const cbor_value_t *src, size_t *length) {
+    return cbor_dumps_ex(src, length, 0);
+}
+
+int cbor_dumps_into(const cbor_value_t *src, char *buf, size_t size, size_t *needed) {
+    size_t length;
+
+    if (!src) {
+        return -1;
+    }
+    length = cbor_encoded_size(src);
+    if (needed) {
+        *needed = length;
+    }
+    if (buf == NULL || length > size) {
+        return -1;
+    }
+    cbor__dumps(src, buf, 0);
+    return 0;
+}
+
 long long cbor_integer(const cbor_value_t *val) {
     if (val == NULL) {
         return 0;
     }
     if (val->type == CBOR_TYPE_UINT) {
-        return val->uint;
+        return cbor__uint_to_integer(val->uint);
     }
     if (val->type == CBOR_TYPE_NEGINT) {
-        return -1 - val->uint;
+        return cbor__negint_to_integer(val->uint);
     }
     if (val->type == CBOR_TYPE_SIMPLE && val->simple.ctrl == CBOR_SIMPLE_REAL) {
-        return val->simple.real;
+        return cbor__real_to_integer(val->simple.real);
     }
     return 0;
 }
@@ -1169,7 +1510,7 @@ double cbor_real(const cbor_value_t *val) {
         return val->uint;
     }
     if (val->type == CBOR_TYPE_NEGINT) {
-        return -1 - val->uint;
+        return -1.0 - (double)val->uint;
     }
     if (val->type == CBOR_TYPE_SIMPLE && val->simple.ctrl == CBOR_SIMPLE_REAL) {
         return val->simple.real;
@@ -1450,6 +1791,22 @@ cbor_value_t *cbor_init_pair(cbor_value_t *key, cbor_value_t *val) {
     return p;
 }
 
+cbor_value_t *cbor_init_tag(long item, cbor_value_t *content) {
+    cbor_value_t *t;
+    if (content == NULL) {
+        return NULL;
+    }
+    assert(content->parent == NULL);
+    t = cbor_create(CBOR_TYPE_TAG);
+    if (t == NULL) {
+        return NULL;
+    }
+    t->tag.item = item;
+    t->tag.content = content;
+    content->parent = t;
+    return t;
+}
+
 cbor_value_t *cbor_pair_key(const cbor_value_t *val) {
     if (val && val->type == CBOR__TYPE_PAIR) {
         return val->pair.key;
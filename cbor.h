@@ -5,6 +5,9 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,15 +17,125 @@ enum {
     JSON_PARSER_ALLOW_COMMENT = 1 << 0,
     JSON_PARSER_ALLOW_INF     = 1 << 1,
     JSON_PARSER_ALLOW_NAN     = 1 << 2,
-    JSON_PARSER_REPORT_ERROR  = 1 << 3
+    JSON_PARSER_REPORT_ERROR  = 1 << 3,
+    /* reject strings that are not valid UTF-8 */
+    JSON_PARSER_VALIDATE_UTF8 = 1 << 4
 };
 
+/* or-ed into the parser flags: fail beyond `n` nested containers, 0 for no limit */
+#define JSON_PARSER_MAX_DEPTH(n) ((int)((n) & 0x7FFF) << 16)
+
+/* errors of cbor_json_loadf_ex, errno is kept for an I/O error */
+enum {
+    JSON_LOADF_IO_ERROR    = 1,
+    JSON_LOADF_PARSE_ERROR = 2
+};
+
+enum {
+    /* RFC 8949 core deterministic encoding: map keys sorted by their encoded bytes */
+    CBOR_DUMPS_DETERMINISTIC = 1 << 0,
+    /* wrap the output in a stringref namespace (tag 256) and replace repeated
+     * strings with references (tag 25); cbor_loads resolves them */
+    CBOR_DUMPS_STRINGREF     = 1 << 1
+};
+
+enum {
+    /* reject text strings that are not valid UTF-8 */
+    CBOR_LOADS_VALIDATE_UTF8 = 1 << 0,
+    /* byte swap typed arrays in foreign byte order in place and retag them,
+     * so the accessors hand out their elements; the tree then encodes in host order */
+    CBOR_LOADS_NATIVE_TYPED_ARRAY = 1 << 1
+};
+
+/* RFC 8746 typed arrays, named by their big endian tag.
+ * the little endian tag is the same value | 4 (8-bit elements have no endianness) */
+typedef enum {
+    CBOR_TYPED_UINT8 = 64,
+    CBOR_TYPED_UINT16 = 65,
+    CBOR_TYPED_UINT32 = 66,
+    CBOR_TYPED_UINT64 = 67,
+    CBOR_TYPED_UINT8_CLAMPED = 68,
+    CBOR_TYPED_SINT8 = 72,
+    CBOR_TYPED_SINT16 = 73,
+    CBOR_TYPED_SINT32 = 74,
+    CBOR_TYPED_SINT64 = 75,
+    CBOR_TYPED_FLOAT16 = 80,
+    CBOR_TYPED_FLOAT32 = 81,
+    CBOR_TYPED_FLOAT64 = 82,
+} cbor_typed_array_type;
+
 typedef enum {
     CBOR_ITER_AFTER,
     CBOR_ITER_BEFORE,
 } cbor_iter_dir;
 
 typedef struct _cbor_value cbor_value_t;
+typedef struct _cbor_json_parser cbor_json_parser_t;
+
+typedef int (*cbor_write_cb)(void *userdata, const char *ptr, size_t length);
+/* `val` belongs to the callee and is NULL when line `line` (0 based) is malformed */
+typedef int (*cbor_json_line_cb)(void *userdata, size_t line, cbor_value_t *val);
+
+#define CBOR_INDEFINITE ((size_t)-1)
+#define CBOR_ENCODER_DEPTH 64
+
+/* writes CBOR without building a tree: into a fixed buffer, a growing
+ * heap buffer (`ptr` NULL at init) or block by block through `cb`.
+ * `total` counts every byte produced, also past a fixed buffer's end.
+ * `items` holds, per open container, the items a definite one still
+ * expects, for an indefinite map 1 while a key waits for its value */
+typedef struct _cbor_encoder {
+    char *ptr;
+    size_t size;
+    size_t length;
+    size_t total;
+    cbor_write_cb cb;
+    void *userdata;
+    bool growable;
+    int error;
+    int depth;
+    bool tagged;            /* a tag waits for its content */
+    uint64_t indefinite;    /* bit per depth */
+    uint64_t maps;          /* bit per depth */
+    uint64_t items[CBOR_ENCODER_DEPTH];
+} cbor_encoder_t;
+
+/* events of cbor_json_sax_parse: NULL members are skipped and a nonzero
+ * return stops parsing. Strings without escapes point into the input, others
+ * into a buffer only valid during the call. Integers keep the CBOR range,
+ * the value is -magnitude when `negative` */
+typedef struct _cbor_json_sax {
+    int (*begin_object)(void *userdata);
+    int (*end_object)(void *userdata);
+    int (*begin_array)(void *userdata);
+    int (*end_array)(void *userdata);
+    int (*key)(void *userdata, const char *ptr, size_t length);
+    int (*string)(void *userdata, const char *ptr, size_t length);
+    int (*integer)(void *userdata, bool negative, uint64_t magnitude);
+    int (*real)(void *userdata, double value);
+    int (*boolean)(void *userdata, bool value);
+    int (*null)(void *userdata);
+} cbor_json_sax_t;
+
+/* a position in JSON text for on-demand access, valid as long as the text */
+typedef struct _cbor_json_cursor {
+    const char *ptr;        /* first byte of the value */
+    const char *end;        /* end of the text */
+    const char *key;        /* opening quote of the member name, NULL outside objects */
+    int flag;
+} cbor_json_cursor_t;
+
+#ifndef _WIN32
+/* encoded document as a gather list for writev()/sendmsg(): heads and small
+ * items live in `buffer`, large string payloads are referenced in place and
+ * must outlive the list */
+typedef struct _cbor_iovec {
+    struct iovec *iov;
+    int count;
+    char *buffer;
+    size_t length;
+} cbor_iovec_t;
+#endif
 
 typedef struct _cbor_iter {
     const cbor_value_t *container;
@@ -50,6 +163,7 @@ int cbor_container_insert_head(cbor_value_t *container, cbor_value_t *val);
 int cbor_container_insert_after(cbor_value_t *container, cbor_value_t *elm, cbor_value_t *val);
 int cbor_container_insert_before(cbor_value_t *container, cbor_value_t *elm, cbor_value_t *val);
 
+/* integers beyond long long and out of range reals saturate, NaN gives 0 */
 long long cbor_integer(const cbor_value_t *val);
 double cbor_real(const cbor_value_t *val);
 int cbor_string_size(const cbor_value_t *val);
@@ -91,6 +205,15 @@ cbor_value_t *cbor_container_remove(cbor_value_t *container, cbor_value_t *elm);
 
 int cbor_container_concat(cbor_value_t *dst, cbor_value_t *src);
 
+/* RFC 8746 typed arrays: a tag over one byte string of packed elements.
+ * cbor_loads keeps them as encoded, cbor_typed_array hands out elements in
+ * place and returns NULL for an array in foreign byte order (see
+ * CBOR_LOADS_NATIVE_TYPED_ARRAY); `type` never carries the little endian bit */
+cbor_value_t *cbor_init_typed_array(cbor_typed_array_type type, const void *data, size_t count);
+bool cbor_is_typed_array(const cbor_value_t *val);
+const void *cbor_typed_array(const cbor_value_t *val, cbor_typed_array_type *type, size_t *count);
+const double *cbor_typed_array_double(const cbor_value_t *val, size_t *count);
+
 /* JSON Pointer ref: https://tools.ietf.org/html/rfc6901 */
 cbor_value_t *cbor_pointer_get(const cbor_value_t *container, const char *path);
 cbor_value_t *cbor_pointer_insert(cbor_value_t *container, const char *path, cbor_value_t *value);
@@ -129,14 +252,121 @@ cbor_value_t *cbor_tag_get_content(const cbor_value_t *val);
 
 /* CBOR ref: https://tools.ietf.org/html/rfc7049 */
 cbor_value_t *cbor_loads(const char *src, size_t *length);
+cbor_value_t *cbor_loads_ex(const char *src, size_t *length, int flags);
 char *cbor_dumps(const cbor_value_t *src, size_t *length);
+char *cbor_dumps_ex(const cbor_value_t *src, size_t *length, int flags);
+size_t cbor_encoded_size(const cbor_value_t *src);
+/* encode into caller memory:
+ *   cbor_dumps_into fails with -1 when `size` is short, `needed` always gets the encoded length
+ *   cbor_dumps_cb fills `block` and passes it to `cb` each time it is full; `cb` returns 0 to go on */
+int cbor_dumps_into(const cbor_value_t *src, char *buf, size_t size, size_t *needed);
+int cbor_dumps_cb(const cbor_value_t *src, char *block, size_t size, cbor_write_cb cb, void *userdata);
+/* the input is memory mapped while decoding and must hold exactly one item,
+ * the output is written with writev() straight from the tree's large strings */
+cbor_value_t *cbor_loadf(const char *path);
+int cbor_dumpf(const cbor_value_t *val, const char *path);
+#ifndef _WIN32
+/* strings of at least `threshold` bytes are not copied, release with cbor_iovec_release */
+int cbor_dumps_iov(const cbor_value_t *src, size_t threshold, cbor_iovec_t *out);
+void cbor_iovec_release(cbor_iovec_t *out);
+#endif
+
+/* streaming encoder, same shortest-form rules as cbor_dumps:
+ *   every cbor_encode_begin_* needs a matching cbor_encode_end,
+ *   `count` CBOR_INDEFINITE opens an indefinite-length container,
+ *   a definite container fails unless it gets exactly `count` items (pairs for a map),
+ *   a tag and its content count as one item */
+void cbor_encoder_init(cbor_encoder_t *enc, char *buf, size_t size);
+void cbor_encoder_init_cb(cbor_encoder_t *enc, char *block, size_t size, cbor_write_cb cb, void *userdata);
+int cbor_encoder_flush(cbor_encoder_t *enc);
+char *cbor_encoder_release(cbor_encoder_t *enc, size_t *length);
+int cbor_encode_uint(cbor_encoder_t *enc, uint64_t value);
+int cbor_encode_integer(cbor_encoder_t *enc, long long value);
+int cbor_encode_string(cbor_encoder_t *enc, const char *str, int len);
+int cbor_encode_bytestring(cbor_encoder_t *enc, const char *ptr, size_t len);
+int cbor_encode_boolean(cbor_encoder_t *enc, bool b);
+int cbor_encode_null(cbor_encoder_t *enc);
+int cbor_encode_double(cbor_encoder_t *enc, double d);
+int cbor_encode_tag(cbor_encoder_t *enc, uint64_t item);
+int cbor_encode_begin_array(cbor_encoder_t *enc, size_t count);
+int cbor_encode_begin_map(cbor_encoder_t *enc, size_t count);
+int cbor_encode_end(cbor_encoder_t *enc);
+int cbor_encode_value(cbor_encoder_t *enc, const cbor_value_t *val);
+int cbor_encode_typed_array(cbor_encoder_t *enc, cbor_typed_array_type type, const void *data, size_t count);
+/* JSON text straight to CBOR, without a tree. A heap buffer encoder gets
+ * definite lengths, the same bytes as cbor_dumps(cbor_json_loads_ex(...)),
+ * a fixed buffer or callback encoder gets indefinite-length containers */
+int cbor_encode_json(cbor_encoder_t *enc, const void *src, int size, int flag, int *consume);
+
+/* walk encoded CBOR without decoding it:
+ *   cbor_skip returns the offset just past the item at `offset`,
+ *   cbor_item_length returns the item's encoded length,
+ *   both return 0 when the item is malformed or truncated */
+size_t cbor_skip(const char *src, size_t length, size_t offset);
+size_t cbor_item_length(const char *src, size_t length, size_t offset);
+long long cbor_raw_integer(const char *src, size_t length, size_t offset);
+double cbor_raw_real(const char *src, size_t length, size_t offset);
+bool cbor_raw_boolean(const char *src, size_t length, size_t offset);
+const char *cbor_raw_string(const char *src, size_t length, size_t offset, size_t *size);
+/* return: elements of the typed array at `offset` inside `src`, NULL when the
+ * array is not in host byte order or not aligned for its element type */
+const void *cbor_raw_typed_array(const char *src, size_t length, size_t offset, cbor_typed_array_type *type, size_t *count);
+
+/* JSON Pointer over encoded CBOR, siblings are skipped without decoding */
+int cbor_raw_pointer_get(const char *src, size_t length, const char *path, size_t *offset, size_t *size);
+long long cbor_raw_pointer_geti(const char *src, size_t length, const char *path);
+const char *cbor_raw_pointer_gets(const char *src, size_t length, const char *path, size_t *size);
+bool cbor_raw_pointer_getb(const char *src, size_t length, const char *path);
+double cbor_raw_pointer_getf(const char *src, size_t length, const char *path);
 
 /* JSON ref: https://tools.ietf.org/html/rfc7159 */
 cbor_value_t *cbor_json_loads_ex(const void *src, int size, int flag, int *consume);
 cbor_value_t *cbor_json_loads(const void *src, int size);
+/* resumable parser for input that arrives in pieces: feed chunks of any size,
+ * pop top level values as they complete and call finish at end of input.
+ * feed and finish return -1 once the input turned out malformed */
+cbor_json_parser_t *cbor_json_parser_new(int flag);
+int cbor_json_parser_feed(cbor_json_parser_t *parser, const void *chunk, size_t size);
+int cbor_json_parser_finish(cbor_json_parser_t *parser);
+cbor_value_t *cbor_json_parser_pop(cbor_json_parser_t *parser);
+void cbor_json_parser_destroy(cbor_json_parser_t *parser);
+/* parse one value into events instead of a tree
+ * return: 0 on success, -1 on malformed input, else what a callback stopped with */
+int cbor_json_sax_parse(const void *src, int size, int flag, const cbor_json_sax_t *sax, void *userdata, int *consume);
+/* on-demand access: nothing is decoded until asked for and the subtrees
+ * passed over on the way are only checked for balanced brackets.
+ *   cbor_json_cursor_get follows a JSON Pointer from `cur`,
+ *   cbor_json_cursor_first and cbor_json_cursor_next walk a container,
+ *   cbor_json_cursor_key and cbor_json_cursor_value decode the member name and the value;
+ * the int functions return -1 when there is no such value */
+int cbor_json_cursor_init(cbor_json_cursor_t *cur, const void *src, size_t size, int flag);
+int cbor_json_cursor_get(const cbor_json_cursor_t *cur, const char *path, cbor_json_cursor_t *out);
+int cbor_json_cursor_first(const cbor_json_cursor_t *cur, cbor_json_cursor_t *child);
+int cbor_json_cursor_next(cbor_json_cursor_t *cur);
+cbor_value_t *cbor_json_cursor_key(const cbor_json_cursor_t *cur);
+cbor_value_t *cbor_json_cursor_value(const cbor_json_cursor_t *cur);
+/* NDJSON / JSON Lines, one value per line and blank lines skipped, parsed
+ * on `threads` threads (0: one per CPU):
+ *   cbor_json_loads_lines returns them as one array, NULL if a line is malformed,
+ *   cbor_json_loads_lines_cb passes them to `cb` in input order until it returns nonzero */
+cbor_value_t *cbor_json_loads_lines(const void *src, size_t size, int flag, int threads);
+int cbor_json_loads_lines_cb(const void *src, size_t size, int flag, int threads, cbor_json_line_cb cb, void *userdata);
+/* one document on `threads` threads (0: one per CPU): a top level array is
+ * cut between elements after an index pass, the pieces are parsed at once
+ * and spliced in order. Other documents are parsed on the calling thread */
+cbor_value_t *cbor_json_loads_parallel(const void *src, size_t size, int flag, int threads);
 char *cbor_json_dumps(const cbor_value_t *src, size_t *length, bool pretty);
+/* encoded CBOR straight to JSON text formatted as cbor_json_dumps does, no
+ * tree is built. `src` must hold exactly one item; byte strings, tags and
+ * simple values without a JSON form fail.
+ * cbor_json_transcode_cb hands the text to `cb` in blocks as it is produced */
+char *cbor_json_transcode(const char *src, size_t length, size_t *size, bool pretty);
+int cbor_json_transcode_cb(const char *src, size_t length, bool pretty, cbor_write_cb cb, void *userdata);
 
 cbor_value_t *cbor_json_loadf(const char *path);
+/* the file is memory mapped while parsing instead of copied to the heap and
+ * must hold one value, followed by nothing but whitespace and comments */
+cbor_value_t *cbor_json_loadf_ex(const char *path, int flag, int *error);
 int cbor_json_dumpf(cbor_value_t *val, const char *path, bool pretty);
 
 int cbor_copy(cbor_value_t *dst, const cbor_value_t *src);
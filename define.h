@@ -1,6 +1,8 @@
 #ifndef __CBOR_DEFINE_H__
 #define __CBOR_DEFINE_H__
 
+#include <limits.h>
+#include <string.h>
 #include "list.h"
 
 #ifdef __FreeBSD__
@@ -70,5 +72,176 @@ struct _cbor_value {
     struct _cbor_value *parent;
 };
 
+#if defined(__GNUC__) || defined(__clang__)
+#define cbor__clz64(x) __builtin_clzll(x)
+#define cbor__ctz32(x) __builtin_ctz(x)
+#define cbor__ctz64(x) __builtin_ctzll(x)
+#else
+static inline int cbor__clz64(uint64_t x) {
+    int n = 0;
+    while (!(x & ((uint64_t)1 << 63))) {
+        x <<= 1;
+        n++;
+    }
+    return n;
+}
+
+static inline int cbor__ctz32(uint32_t x) {
+    int n = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+}
+
+static inline int cbor__ctz64(uint64_t x) {
+    int n = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+}
+#endif
+
+/* additional information of an argument: itself below 24, else 24..27 by byte width */
+static inline uint8_t cbor__head_addition(uint64_t arg) {
+    static const uint8_t width[8] = {24, 25, 26, 26, 27, 27, 27, 27};
+    if (arg < 24) {
+        return (uint8_t)arg;
+    }
+    return width[(63 - cbor__clz64(arg)) >> 3];
+}
+
+static inline size_t cbor__head_size(uint64_t arg) {
+    uint8_t addition = cbor__head_addition(arg);
+    return addition < 24 ? 1 : 1 + ((size_t)1 << (addition - 24));
+}
+
+/* one store per argument width, `ptr` needs no alignment */
+static inline char *cbor__write_head_width(char *ptr, uint8_t type, uint8_t addition, uint64_t arg) {
+    *ptr = (char)((type << 5) | addition);
+    switch (addition) {
+    case 24: {
+        ptr[1] = (char)arg;
+        return ptr + 2;
+    }
+    case 25: {
+        uint16_t be = htobe16((uint16_t)arg);
+        memcpy(ptr + 1, &be, 2);
+        return ptr + 3;
+    }
+    case 26: {
+        uint32_t be = htobe32((uint32_t)arg);
+        memcpy(ptr + 1, &be, 4);
+        return ptr + 5;
+    }
+    case 27: {
+        uint64_t be = htobe64(arg);
+        memcpy(ptr + 1, &be, 8);
+        return ptr + 9;
+    }
+    default:
+        return ptr + 1;
+    }
+}
+
+static inline char *cbor__write_head(char *ptr, uint8_t type, uint64_t arg) {
+    return cbor__write_head_width(ptr, type, cbor__head_addition(arg), arg);
+}
+
+/* integer accessors saturate at the long long range instead of wrapping */
+static inline long long cbor__uint_to_integer(uint64_t arg) {
+    return arg > LLONG_MAX ? LLONG_MAX : (long long)arg;
+}
+
+/* `arg` of a negative integer, whose value is -1 - arg */
+static inline long long cbor__negint_to_integer(uint64_t arg) {
+    return arg > LLONG_MAX ? LLONG_MIN : -1 - (long long)arg;
+}
+
+static inline long long cbor__real_to_integer(double real) {
+    if (real != real) {
+        return 0;
+    }
+    if (real >= 9223372036854775808.0) {
+        return LLONG_MAX;
+    }
+    if (real < -9223372036854775808.0) {
+        return LLONG_MIN;
+    }
+    return (long long)real;
+}
+
+/* item count of an indefinite container while walking encoded bytes */
+#define CBOR__INDEFINITE UINT64_MAX
+/* nesting of indefinite containers cbor_skip can track */
+#define CBOR_SKIP_DEPTH 64
+
 struct _cbor_value *cbor_create(cbor_type type);
+char *cbor__dumps(const struct _cbor_value *src, char *ptr, int flags);
+int cbor__blob_reserve(struct _cbor_value *val, size_t size);
+uint8_t cbor__real_narrow(double real, uint64_t *bits);
+void cbor__typed_array_normalize(struct _cbor_value *tag);
+int cbor__sort_pairs(const struct _cbor_value *map, struct _cbor_value **pairs);
+
+/* stringref ref: http://cbor.schmorp.de/stringref */
+#define CBOR__TAG_STRINGREF 25
+#define CBOR__TAG_STRINGREF_NAMESPACE 256
+char *cbor__dumps_stringref(const struct _cbor_value *src, size_t *length, int flags);
+/* cbor__loads flag: decoding below a tag 256, which resolves the nested ones too */
+#define CBOR__LOADS_NAMESPACE (1 << 30)
+struct _cbor_value *cbor__stringref_resolve(struct _cbor_value *ns, int flags);
+
+/* read-only view of a whole file: mmap where available, else a heap copy */
+typedef struct {
+    const char *ptr;
+    size_t length;
+    bool mapped;
+} cbor__file_t;
+int cbor__file_map(cbor__file_t *file, const char *path);
+void cbor__file_unmap(cbor__file_t *file);
+
+/* the limit of JSON_PARSER_MAX_DEPTH, 0 without one */
+#define JSON_DEPTH_LIMIT(flags) (((unsigned)(flags) >> 16) & 0x7FFF)
+
+/* JSON stage 1: token starts outside strings, found one window of input at a time.
+ * The lexer does not use it, cbor_json_loads_parallel cuts arrays with it (ndjson.c) */
+#define JSON_INDEX_WINDOW 16384
+typedef struct {
+    const char *src;
+    size_t length;
+    size_t base;        /* input offset of the current window */
+    size_t next;        /* input offset of the window after it */
+    uint32_t *offsets;  /* ascending, relative to `base` */
+    size_t count;
+    uint64_t escape_carry;
+    uint64_t string_carry;
+    uint64_t scalar_carry;
+} json__index_t;
+int json__index_init(json__index_t *index, const char *src, size_t length);
+int json__index_next(json__index_t *index);
+void json__index_release(json__index_t *index);
+const char *json__string_scan(const char *ptr, const char *end);
+const char *json__space_scan(const char *ptr, const char *end);
+const char *json__skip_scan(const char *ptr, const char *end);
+int json__parse_elements(const char *src, size_t size, int flag, struct _cbor_value *array);
+
+/* JSON number literal split for conversion: value is mantissa * 10^exponent */
+typedef struct {
+    const char *ptr;            /* digits of the literal, sign excluded */
+    const char *end;
+    uint64_t mantissa;          /* first 19 significant digits */
+    int64_t exponent;
+    int64_t explicit_exponent;  /* the part after 'e' alone */
+    bool negative;
+    bool truncated;             /* nonzero digits did not fit the mantissa */
+} json__decimal_t;
+double json__decimal_to_double(const json__decimal_t *dec);
+size_t cbor__read_head(const char *src, size_t length, size_t offset, cbor_type *type, uint8_t *addition, uint64_t *arg);
+/* return: offset of the first malformed UTF-8 sequence, `length` when there is none */
+size_t cbor__utf8_check(const char *ptr, size_t length);
+/* key bytes against a JSON Pointer reference token, NULL on mismatch */
+const char *cbor__pointer_token_match(const char *tok, const char *end, const char *key, size_t size);
 #endif  /* !__CBOR_DEFINE_H__ */
@@ -0,0 +1,363 @@
+#include "test.h"
+#include <math.h>
+
+/* the report of a call, named as "func('input')" */
+static void report_call(bool ok, const char *func, const char *input, const char *content) {
+    char name[128];
+    snprintf(name, sizeof(name), "%s('%s')", func, input);
+    report(ok, name, content);
+}
+
+/* the bytes of cbor_dumps and the size cbor_encoded_size predicts for them */
+void dumps_test(const char *input, const char *output) {
+    size_t length;
+    cbor_value_t *src = cbor_json_loads(input, -1);
+    char *raw = cbor_dumps(src, &length);
+    char *content = tohex(raw, length);
+    report_call(!strcmp(content, output) && cbor_encoded_size(src) == length, "cbor_dumps", input, content);
+    cbor_destroy(src);
+    free(content);
+    free(raw);
+}
+
+/* decoding then encoding gives back the same bytes */
+void roundtrip_test(const char *input) {
+    char buf[256];
+    size_t size = unhex(input, buf), length = size;
+    cbor_value_t *src = cbor_loads(buf, &length);
+    char *raw = src ? cbor_dumps(src, &length) : NULL;
+    char *content = raw ? tohex(raw, length) : NULL;
+    report_call(content && !strcmp(content, input), "cbor_dumps(cbor_loads)", input, content ? content : "");
+    cbor_destroy(src);
+    free(content);
+    free(raw);
+}
+
+/* one value built in C, its bytes, the predicted size and the decoded value */
+static void value_test(cbor_value_t *src, const char *input, const char *output) {
+    size_t length;
+    char *raw = cbor_dumps(src, &length);
+    char *content = tohex(raw, length);
+    size_t size = length;
+    cbor_value_t *back = cbor_loads(raw, &size);
+    bool same = back && size == length;
+    if (same && cbor_is_double(src)) {
+        double a = cbor_real(src), b = cbor_real(back);
+        same = a == b ? (a != 0 || signbit(a) == signbit(b)) : (a != a && b != b);
+    } else if (same) {
+        same = cbor_integer(src) == cbor_integer(back);
+    }
+    report_call(!strcmp(content, output) && cbor_encoded_size(src) == length && same, "cbor_dumps", input, content);
+    cbor_destroy(src);
+    cbor_destroy(back);
+    free(content);
+    free(raw);
+}
+
+#define REAL_TEST(real, output) value_test(cbor_init_double(real), #real, output)
+#define INTEGER_TEST(integer, output) value_test(cbor_init_integer(integer), #integer, output)
+
+/* CBOR_DUMPS_DETERMINISTIC output of the decoded `input` */
+void deterministic_test(const char *input, const char *output) {
+    char buf[256];
+    size_t length = unhex(input, buf);
+    cbor_value_t *src = cbor_loads(buf, &length);
+    char *raw = src ? cbor_dumps_ex(src, &length, CBOR_DUMPS_DETERMINISTIC) : NULL;
+    char *content = raw ? tohex(raw, length) : NULL;
+    report_call(content && !strcmp(content, output), "cbor_dumps_ex(DETERMINISTIC)", input, content ? content : "");
+    cbor_destroy(src);
+    free(content);
+    free(raw);
+}
+
+typedef struct {
+    char buf[256];
+    size_t length;
+    size_t block;
+    bool short_block;   /* a block before the last one came short */
+    size_t last;
+} sink_t;
+
+static int sink_write(void *userdata, const char *ptr, size_t length) {
+    sink_t *sink = (sink_t *)userdata;
+    if (sink->last != 0 && sink->last < sink->block) {
+        sink->short_block = true;
+    }
+    if (sink->length + length > sizeof(sink->buf)) {
+        return -1;
+    }
+    memcpy(sink->buf + sink->length, ptr, length);
+    sink->length += length;
+    sink->last = length;
+    return 0;
+}
+
+/* every block size gives the cbor_dumps bytes, in full blocks but the last */
+void dumps_cb_test(const char *input) {
+    char block[64], content[64] = "";
+    size_t length, size;
+    cbor_value_t *src = cbor_json_loads(input, -1);
+    char *raw = cbor_dumps(src, &length);
+    for (size = 1; size <= 24 && !content[0]; size++) {
+        sink_t sink;
+        memset(&sink, 0, sizeof(sink));
+        sink.block = size;
+        if (cbor_dumps_cb(src, block, size, sink_write, &sink) != 0
+            || sink.length != length || memcmp(sink.buf, raw, length) || sink.short_block) {
+            snprintf(content, sizeof(content), "block %zu: %zu of %zu bytes", size, sink.length, length);
+        }
+    }
+    report_call(!content[0], "cbor_dumps_cb", input, content);
+    cbor_destroy(src);
+    free(raw);
+}
+
+/* a short buffer fails but reports the size it needs, an exact one succeeds */
+void dumps_into_test(const char *input) {
+    char buf[256], content[64];
+    size_t length, needed = 0, short_needed = 0;
+    cbor_value_t *src = cbor_json_loads(input, -1);
+    char *raw = cbor_dumps(src, &length);
+    int short_result = cbor_dumps_into(src, buf, length - 1, &short_needed);
+    int result = cbor_dumps_into(src, buf, length, &needed);
+    snprintf(content, sizeof(content), "%d/%zu, %d/%zu", short_result, short_needed, result, needed);
+    report_call(short_result == -1 && short_needed == length && result == 0 && needed == length
+                && !memcmp(buf, raw, length), "cbor_dumps_into", input, content);
+    cbor_destroy(src);
+    free(raw);
+}
+
+typedef struct {
+    char *ptr;
+    size_t length;
+    int calls;
+} text_t;
+
+static int text_write(void *userdata, const char *ptr, size_t length) {
+    text_t *text = (text_t *)userdata;
+    text->ptr = (char *)realloc(text->ptr, text->length + length + 1);
+    memcpy(text->ptr + text->length, ptr, length);
+    text->length += length;
+    text->ptr[text->length] = '\0';
+    text->calls++;
+    return 0;
+}
+
+/* cbor_json_transcode and cbor_json_transcode_cb of `length` encoded bytes
+ * give what cbor_json_dumps gives for the decoded tree, pretty or not */
+static void transcode_raw_test(const char *name, const char *raw, size_t length) {
+    size_t size = length;
+    cbor_value_t *src = cbor_loads(raw, &size);
+    char content[64] = "";
+    int pretty;
+
+    for (pretty = 0; pretty < 2 && !content[0]; pretty++) {
+        size_t expect_size = 0, direct_size = 0;
+        char *expect = src ? cbor_json_dumps(src, &expect_size, pretty) : NULL;
+        char *direct = cbor_json_transcode(raw, length, &direct_size, pretty);
+        text_t text;
+
+        memset(&text, 0, sizeof(text));
+        if (!expect || !direct || direct_size != expect_size || memcmp(direct, expect, expect_size)) {
+            snprintf(content, sizeof(content), "pretty %d: %.40s", pretty, direct ? direct : "failed");
+        } else if (cbor_json_transcode_cb(raw, length, pretty, text_write, &text) != 0
+                   || text.length != expect_size || memcmp(text.ptr, expect, expect_size)) {
+            snprintf(content, sizeof(content), "pretty %d: %zu of %zu bytes in %d blocks", pretty,
+                     text.length, expect_size, text.calls);
+        }
+        free(text.ptr);
+        free(direct);
+        free(expect);
+    }
+    report_call(!content[0], "cbor_json_transcode", name, content);
+    cbor_destroy(src);
+}
+
+void transcode_test(const char *input) {
+    char buf[256];
+    transcode_raw_test(input, buf, unhex(input, buf));
+}
+
+/* items without a JSON form and malformed input fail both ways */
+void transcode_error_test(const char *input) {
+    char buf[256];
+    size_t length = unhex(input, buf), size = 1;
+    text_t text;
+    char *json = cbor_json_transcode(buf, length, &size, false);
+    int r;
+
+    memset(&text, 0, sizeof(text));
+    r = cbor_json_transcode_cb(buf, length, false, text_write, &text);
+    report_call(json == NULL && size == 0 && r == -1, "cbor_json_transcode", input, json ? json : "");
+    free(json);
+    free(text.ptr);
+}
+
+/* a document far larger than a block is handed out in several */
+void transcode_large_test(int count) {
+    cbor_value_t *src = cbor_init_array();
+    size_t length;
+    char *raw, name[64];
+    int i;
+
+    for (i = 0; i < count; i++) {
+        cbor_value_t *item = cbor_init_map();
+        cbor_container_insert_tail(item, cbor_init_pair(cbor_init_string("id", -1), cbor_init_integer(i)));
+        cbor_container_insert_tail(item, cbor_init_pair(cbor_init_string("name", -1),
+                                   cbor_init_string("a fairly long string value \xc3\xa9\x01", -1)));
+        cbor_container_insert_tail(src, item);
+    }
+    raw = cbor_dumps(src, &length);
+    snprintf(name, sizeof(name), "%d records", count);
+    transcode_raw_test(name, raw, length);
+    free(raw);
+    cbor_destroy(src);
+}
+
+#ifndef _WIN32
+/* the gathered segments concatenate to the cbor_dumps bytes; `count`
+ * segments, the strings of at least `threshold` bytes referenced in place */
+void dumps_iov_test(const char *input, size_t threshold, int count) {
+    char buf[256], content[64] = "";
+    size_t length, size = 0;
+    cbor_value_t *src = cbor_json_loads(input, -1);
+    char *raw = cbor_dumps(src, &length);
+    cbor_iovec_t out;
+    int i, copied = 0;
+
+    if (cbor_dumps_iov(src, threshold, &out) != 0) {
+        report_call(false, "cbor_dumps_iov", input, "failed");
+        cbor_destroy(src);
+        free(raw);
+        return;
+    }
+    for (i = 0; i < out.count && size + out.iov[i].iov_len <= sizeof(buf); i++) {
+        memcpy(buf + size, out.iov[i].iov_base, out.iov[i].iov_len);
+        size += out.iov[i].iov_len;
+        if ((char *)out.iov[i].iov_base < out.buffer || (char *)out.iov[i].iov_base >= out.buffer + out.length) {
+            copied += out.iov[i].iov_len >= threshold ? 0 : 1;
+        }
+    }
+    snprintf(content, sizeof(content), "%d segments, %zu of %zu bytes", out.count, size, out.length);
+    report_call(out.count == count && size == length && out.length == length && !memcmp(buf, raw, length) && !copied,
+                "cbor_dumps_iov", input, content);
+    cbor_iovec_release(&out);
+    cbor_destroy(src);
+    free(raw);
+}
+#endif
+
+int main(int argc, char **argv) {
+    dumps_test(JSON(0), "00");
+    dumps_test(JSON(23), "17");
+    dumps_test(JSON(24), "1818");
+    dumps_test(JSON(1000), "1903e8");
+    dumps_test(JSON(100000), "1a000186a0");
+    dumps_test(JSON(1000000000000), "1b000000e8d4a51000");
+    dumps_test(JSON(-1), "20");
+    dumps_test(JSON(-1000), "3903e7");
+    dumps_test(JSON(1.5), "f93e00");
+    dumps_test(JSON(65504.0), "f97bff");
+    dumps_test(JSON(3.4028234663852886e38), "fa7f7fffff");
+    dumps_test(JSON(0.1), "fb3fb999999999999a");
+    dumps_test(JSON(1e300), "fb7e37e43c8800759c");
+    dumps_test(JSON(true), "f5");
+    dumps_test(JSON(false), "f4");
+    dumps_test(JSON(null), "f6");
+    dumps_test(JSON(""), "60");
+    dumps_test(JSON("IETF"), "6449455446");
+    dumps_test(JSON([]), "80");
+    dumps_test(JSON([1, [2, 3], [4, 5]]), "8301820203820405");
+    dumps_test(JSON({}), "a0");
+    dumps_test(JSON({"a": 1, "b": [2, 3]}), "a26161016162820203");
+    dumps_test(JSON(["aaaaaaaaaaaaaaaaaaaaaaaa"]), "817818616161616161616161616161616161616161616161616161");
+    roundtrip_test("c11a514b67b0");
+    roundtrip_test("d82076687474703a2f2f7777772e6578616d706c652e636f6d");
+    roundtrip_test("f7");
+    roundtrip_test("f820");
+    roundtrip_test("4401020304");
+    roundtrip_test("a201020304");
+    INTEGER_TEST(23, "17");
+    INTEGER_TEST(24, "1818");
+    INTEGER_TEST(255, "18ff");
+    INTEGER_TEST(256, "190100");
+    INTEGER_TEST(65535, "19ffff");
+    INTEGER_TEST(65536, "1a00010000");
+    INTEGER_TEST(4294967295LL, "1affffffff");
+    INTEGER_TEST(4294967296LL, "1b0000000100000000");
+    INTEGER_TEST(9223372036854775807LL, "1b7fffffffffffffff");
+    INTEGER_TEST(-24, "37");
+    INTEGER_TEST(-25, "3818");
+    INTEGER_TEST(-257, "390100");
+    INTEGER_TEST(-9223372036854775807LL - 1, "3b7fffffffffffffff");
+    REAL_TEST(0.0, "f90000");
+    REAL_TEST(-0.0, "f98000");
+    REAL_TEST(1.0, "f93c00");
+    REAL_TEST(-4.0, "f9c400");
+    REAL_TEST(65504.0, "f97bff");
+    REAL_TEST(65505.0, "fa477fe100");
+    REAL_TEST(100000.0, "fa47c35000");
+    REAL_TEST(5.960464477539063e-8, "f90001");
+    REAL_TEST(6.103515625e-05, "f90400");
+    REAL_TEST(2.9802322387695312e-08, "fa33000000");
+    REAL_TEST(1.401298464324817e-45, "fa00000001");
+    REAL_TEST(3.4028234663852886e38, "fa7f7fffff");
+    REAL_TEST(1.1, "fb3ff199999999999a");
+    REAL_TEST(-4.1, "fbc010666666666666");
+    REAL_TEST(INFINITY, "f97c00");
+    REAL_TEST(-INFINITY, "f9fc00");
+    REAL_TEST(NAN, "f97e00");
+    /* length first, then bytes: "a" < "b" < "aa" */
+    deterministic_test("a3626161036162026161" "01", "a3616101616202626161" "03");
+    /* major type first: 10 < -1 < "a" */
+    deterministic_test("a36161010a022003", "a30a022003616101");
+    deterministic_test("a2f4f5f6f7", "a2f4f5f6f7");
+    deterministic_test("a2fb3ff8000000000000" "01f93c0002", "a2f93c0002f93e0001");
+    /* map keys are themselves compared in deterministic form */
+    deterministic_test("a2a2616201616102" "01a161630002", "a2a161630002a26161026162" "0101");
+    deterministic_test("a2a161630002a26161026162" "0101", "a2a161630002a26161026162" "0101");
+    deterministic_test("82a2616201616102a2616102616201", "82a2616102616201a2616102616201");
+    deterministic_test("a2a2616300616101" "01a2616102616200" "02", "a2a2616101616300" "01a2616102616200" "02");
+    deterministic_test("a2a2616102616200" "02a2616101616300" "01", "a2a2616101616300" "01a2616102616200" "02");
+    dumps_into_test(JSON(1));
+    dumps_into_test(JSON({"a": [1, 2, 3], "b": "hello"}));
+    dumps_cb_test(JSON(0));
+    dumps_cb_test(JSON([1, 1000, 100000, 1000000000000, -1, 0.1, 1.5, true, null]));
+    dumps_cb_test(JSON({"a": {"b": ["aaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", 1e300]}, "c": []}));
+    transcode_test("00");
+    transcode_test("3bffffffffffffffff");
+    transcode_test("1bffffffffffffffff");
+    transcode_test("8a0017181820390100f93e00fb3fb999999999999af5f4f6");
+    transcode_test("a2616101616282f97c00f9fc00");
+    transcode_test("6b22615c0a62c3a9e4b8ad01");
+    transcode_test("7f6161626262ff");
+    transcode_test("80");
+    transcode_test("a0");
+    transcode_test("8280a0");
+    transcode_test("9f019f02ffbf6161a0ffff");
+    transcode_test("a1a10102818103");
+    transcode_test("a201020304");
+    transcode_large_test(2000);
+    transcode_error_test("4401020304");
+    transcode_error_test("c11a514b67b0");
+    transcode_error_test("8201c100");
+    transcode_error_test("f7");
+    transcode_error_test("f820");
+    transcode_error_test("820102" "03");
+    transcode_error_test("8201");
+    transcode_error_test("9f01");
+    transcode_error_test("bf6161ff");
+    transcode_error_test("7f616140ff");
+    transcode_error_test("9bffffffffffffffff");
+    transcode_error_test("1f");
+    transcode_error_test("");
+#ifndef _WIN32
+    dumps_iov_test(JSON([1, "abc", 2]), 16, 1);
+    dumps_iov_test(JSON("aaaaaaaaaaaaaaaaaaaa"), 16, 2);
+    dumps_iov_test(JSON(["aaaaaaaaaaaaaaaaaaaa", 1]), 16, 3);
+    dumps_iov_test(JSON({"aaaaaaaaaaaaaaaaaaaa": "bbbbbbbbbbbbbbbbbbbb", "c": 1}), 16, 5);
+    dumps_iov_test(JSON(["abc", "aaaaaaaaaaaaaaaaaaaa"]), 3, 4);
+    dumps_iov_test(JSON([]), 0, 1);
+#endif
+    return failures != 0;
+}
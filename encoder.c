@@ -0,0 +1,591 @@
+#include "cbor.h"
+#include <assert.h>
+#include <string.h>
+#include "define.h"
+
+void cbor_encoder_init(cbor_encoder_t *enc, char *buf, size_t size) {
+    memset(enc, 0, sizeof(cbor_encoder_t));
+    enc->ptr = buf;
+    enc->size = buf ? size : 0;
+    enc->growable = buf == NULL;
+}
+
+void cbor_encoder_init_cb(cbor_encoder_t *enc, char *block, size_t size, cbor_write_cb cb, void *userdata) {
+    assert(block != NULL && size > 0 && cb != NULL);
+    memset(enc, 0, sizeof(cbor_encoder_t));
+    enc->ptr = block;
+    enc->size = size;
+    enc->cb = cb;
+    enc->userdata = userdata;
+}
+
+int cbor_encoder_flush(cbor_encoder_t *enc) {
+    if (enc->cb && enc->length > 0 && enc->error == 0) {
+        if (enc->cb(enc->userdata, enc->ptr, enc->length)) {
+            enc->error = -1;
+        }
+        enc->length = 0;
+    }
+    return enc->error;
+}
+
+char *cbor_encoder_release(cbor_encoder_t *enc, size_t *length) {
+    char *ptr = NULL;
+    if (enc->growable && enc->error == 0 && enc->depth == 0 && !enc->tagged) {
+        ptr = enc->ptr;
+        if (length) {
+            *length = enc->length;
+        }
+    } else if (enc->growable) {
+        free(enc->ptr);
+    }
+    if (enc->growable) {
+        enc->ptr = NULL;
+        enc->size = 0;
+        enc->length = 0;
+    }
+    return ptr;
+}
+
+static bool cbor_encoder_grow(cbor_encoder_t *enc, size_t size) {
+    size_t allocated = enc->size ? enc->size : 64;
+    char *tmp;
+    while (allocated - enc->length < size) {
+        allocated *= 2;
+    }
+    tmp = (char *)realloc(enc->ptr, allocated);
+    if (tmp == NULL) {
+        return false;
+    }
+    enc->ptr = tmp;
+    enc->size = allocated;
+    return true;
+}
+
+static void cbor_encoder_commit(cbor_encoder_t *enc, char *end) {
+    size_t size = end - (enc->ptr + enc->length);
+    enc->length += size;
+    enc->total += size;
+}
+
+static void cbor_encoder_write(cbor_encoder_t *enc, const char *ptr, size_t size) {
+    if (enc->error == 0 && enc->cb == NULL && enc->size - enc->length < size) {
+        if (!enc->growable || !cbor_encoder_grow(enc, size)) {
+            enc->error = -1;
+        }
+    }
+    while (size > 0 && enc->error == 0) {
+        size_t room = enc->size - enc->length;
+        if (room == 0) {
+            cbor_encoder_flush(enc);
+            continue;
+        }
+        if (room > size) {
+            room = size;
+        }
+        memcpy(enc->ptr + enc->length, ptr, room);
+        enc->length += room;
+        enc->total += room;
+        ptr += room;
+        size -= room;
+    }
+    /* keep counting so a fixed buffer caller learns the size it needed */
+    enc->total += size;
+}
+
+/* heads are written in place while a whole one fits, else through
+ * cbor_encoder_write so a block is filled up to its last byte */
+static int cbor_encoder_head_width(cbor_encoder_t *enc, cbor_type type, uint8_t addition, uint64_t arg) {
+    char head[9];
+    if (enc->error == 0 && enc->size - enc->length >= sizeof(head)) {
+        cbor_encoder_commit(enc, cbor__write_head_width(enc->ptr + enc->length, type, addition, arg));
+        return 0;
+    }
+    cbor_encoder_write(enc, head, cbor__write_head_width(head, type, addition, arg) - head);
+    return enc->error;
+}
+
+static int cbor_encoder_head(cbor_encoder_t *enc, cbor_type type, uint64_t arg) {
+    return cbor_encoder_head_width(enc, type, cbor__head_addition(arg), arg);
+}
+
+static int cbor_encoder_byte(cbor_encoder_t *enc, uint8_t byte) {
+    char ptr = (char)byte;
+    cbor_encoder_write(enc, &ptr, 1);
+    return enc->error;
+}
+
+/* account for one more item in the innermost container, the content of a tag is not another one */
+static int cbor_encoder_item(cbor_encoder_t *enc) {
+    uint64_t *items;
+    if (enc->tagged) {
+        enc->tagged = false;
+        return enc->error;
+    }
+    if (enc->depth == 0) {
+        return enc->error;
+    }
+    items = &enc->items[enc->depth - 1];
+    if ((enc->indefinite >> (enc->depth - 1)) & 1) {
+        *items ^= (enc->maps >> (enc->depth - 1)) & 1;
+    } else if (*items == 0) {
+        enc->error = -1;
+    } else {
+        (*items)--;
+    }
+    return enc->error;
+}
+
+int cbor_encode_uint(cbor_encoder_t *enc, uint64_t value) {
+    cbor_encoder_item(enc);
+    cbor_encoder_head(enc, CBOR_TYPE_UINT, value);
+    return enc->error;
+}
+
+int cbor_encode_integer(cbor_encoder_t *enc, long long value) {
+    cbor_encoder_item(enc);
+    if (value < 0) {
+        cbor_encoder_head(enc, CBOR_TYPE_NEGINT, -1 - value);
+    } else {
+        cbor_encoder_head(enc, CBOR_TYPE_UINT, value);
+    }
+    return enc->error;
+}
+
+int cbor_encode_string(cbor_encoder_t *enc, const char *str, int len) {
+    if (len < 0) {
+        len = strlen(str);
+    }
+    cbor_encoder_item(enc);
+    cbor_encoder_head(enc, CBOR_TYPE_STRING, len);
+    cbor_encoder_write(enc, str, len);
+    return enc->error;
+}
+
+int cbor_encode_bytestring(cbor_encoder_t *enc, const char *ptr, size_t len) {
+    cbor_encoder_item(enc);
+    cbor_encoder_head(enc, CBOR_TYPE_BYTESTRING, len);
+    cbor_encoder_write(enc, ptr, len);
+    return enc->error;
+}
+
+int cbor_encode_boolean(cbor_encoder_t *enc, bool b) {
+    cbor_encoder_item(enc);
+    cbor_encoder_byte(enc, (CBOR_TYPE_SIMPLE << 5) | (b ? CBOR_SIMPLE_TRUE : CBOR_SIMPLE_FALSE));
+    return enc->error;
+}
+
+int cbor_encode_null(cbor_encoder_t *enc) {
+    cbor_encoder_item(enc);
+    cbor_encoder_byte(enc, (CBOR_TYPE_SIMPLE << 5) | CBOR_SIMPLE_NULL);
+    return enc->error;
+}
+
+static int cbor_encoder_double(cbor_encoder_t *enc, double d) {
+    uint64_t bits;
+    uint8_t addition = cbor__real_narrow(d, &bits);
+    return cbor_encoder_head_width(enc, CBOR_TYPE_SIMPLE, addition, bits);
+}
+
+int cbor_encode_double(cbor_encoder_t *enc, double d) {
+    cbor_encoder_item(enc);
+    return cbor_encoder_double(enc, d);
+}
+
+int cbor_encode_tag(cbor_encoder_t *enc, uint64_t item) {
+    cbor_encoder_item(enc);
+    cbor_encoder_head(enc, CBOR_TYPE_TAG, item);
+    enc->tagged = true;
+    return enc->error;
+}
+
+static int cbor_encode_begin(cbor_encoder_t *enc, cbor_type type, size_t count) {
+    if (enc->depth >= CBOR_ENCODER_DEPTH) {
+        enc->error = -1;
+        return enc->error;
+    }
+    cbor_encoder_item(enc);
+    enc->maps &= ~((uint64_t)1 << enc->depth);
+    enc->maps |= (uint64_t)(type == CBOR_TYPE_MAP) << enc->depth;
+    if (count == CBOR_INDEFINITE) {
+        enc->indefinite |= (uint64_t)1 << enc->depth;
+        enc->items[enc->depth] = 0;
+        cbor_encoder_byte(enc, (type << 5) | 31);
+    } else {
+        enc->indefinite &= ~((uint64_t)1 << enc->depth);
+        enc->items[enc->depth] = type == CBOR_TYPE_MAP ? (uint64_t)count * 2 : count;
+        cbor_encoder_head(enc, type, count);
+    }
+    enc->depth++;
+    return enc->error;
+}
+
+int cbor_encode_begin_array(cbor_encoder_t *enc, size_t count) {
+    return cbor_encode_begin(enc, CBOR_TYPE_ARRAY, count);
+}
+
+int cbor_encode_begin_map(cbor_encoder_t *enc, size_t count) {
+    return cbor_encode_begin(enc, CBOR_TYPE_MAP, count);
+}
+
+/* close the innermost container, writing the break code if it is indefinite */
+int cbor_encode_end(cbor_encoder_t *enc) {
+    /* short of items, or an indefinite map with a key but no value */
+    if (enc->depth == 0 || enc->tagged || enc->items[enc->depth - 1] != 0) {
+        enc->error = -1;
+        return enc->error;
+    }
+    enc->depth--;
+    if ((enc->indefinite >> enc->depth) & 1) {
+        cbor_encoder_byte(enc, 0xFF);
+    }
+    return enc->error;
+}
+
+static int cbor_encoder_tree(cbor_encoder_t *enc, const cbor_value_t *val) {
+    char scalar[9];
+    if (val == NULL) {
+        enc->error = -1;
+        return enc->error;
+    }
+    switch (val->type) {
+    case CBOR_TYPE_BYTESTRING:
+    case CBOR_TYPE_STRING: {
+        cbor_encoder_head(enc, val->type, val->blob.length);
+        cbor_encoder_write(enc, val->blob.ptr, val->blob.length);
+        break;
+    }
+    case CBOR_TYPE_ARRAY: {
+        cbor_value_t *var;
+        cbor_encoder_head(enc, val->type, cbor_container_size(val));
+        list_foreach(var, &val->container, entry) {
+            cbor_encoder_tree(enc, var);
+        }
+        break;
+    }
+    case CBOR_TYPE_MAP: {
+        cbor_value_t *var;
+        cbor_encoder_head(enc, val->type, cbor_container_size(val));
+        list_foreach(var, &val->container, entry) {
+            cbor_encoder_tree(enc, var->pair.key);
+            cbor_encoder_tree(enc, var->pair.value);
+        }
+        break;
+    }
+    case CBOR_TYPE_TAG: {
+        cbor_encoder_head(enc, val->type, val->tag.item);
+        cbor_encoder_tree(enc, val->tag.content);
+        break;
+    }
+    case CBOR__TYPE_PAIR:
+        break;
+    default:
+        /* scalars never exceed 9 bytes */
+        cbor_encoder_write(enc, scalar, cbor__dumps(val, scalar, 0) - scalar);
+        break;
+    }
+    return enc->error;
+}
+
+int cbor_encode_value(cbor_encoder_t *enc, const cbor_value_t *val) {
+    cbor_encoder_item(enc);
+    return cbor_encoder_tree(enc, val);
+}
+
+/* encode through `block`, handing each full block (and the final partial one) to `cb` */
+int cbor_dumps_cb(const cbor_value_t *src, char *block, size_t size, cbor_write_cb cb, void *userdata) {
+    cbor_encoder_t enc;
+
+    if (!src || !block || !cb || size == 0) {
+        return -1;
+    }
+    cbor_encoder_init_cb(&enc, block, size, cb, userdata);
+    cbor_encode_value(&enc, src);
+    return cbor_encoder_flush(&enc);
+}
+
+/* JSON transcoding: SAX events go straight to the encoder */
+typedef struct {
+    size_t offset;      /* of the container head, back-patched mode only */
+    uint64_t count;
+    cbor_type type;
+} cbor_json_frame_t;
+
+typedef struct {
+    cbor_encoder_t *enc;
+    bool patch;         /* definite lengths written once the container closes */
+    cbor_json_frame_t inline_stack[32];
+    cbor_json_frame_t *stack;
+    size_t depth;
+    size_t allocated;
+} cbor_json_transcoder_t;
+
+/* count a value in the array it belongs to, map entries are counted by key */
+static int cbor_json_item(cbor_json_transcoder_t *t) {
+    if (t->depth > 0 && t->stack[t->depth - 1].type == CBOR_TYPE_ARRAY) {
+        t->stack[t->depth - 1].count++;
+    }
+    return t->enc->error;
+}
+
+static int cbor_json_begin(cbor_json_transcoder_t *t, cbor_type type) {
+    cbor_encoder_t *enc = t->enc;
+    cbor_json_frame_t *frame;
+
+    cbor_json_item(t);
+    if (t->depth == t->allocated) {
+        size_t allocated = t->allocated * 2;
+        cbor_json_frame_t *tmp = (cbor_json_frame_t *)malloc(sizeof(cbor_json_frame_t) * allocated);
+        if (tmp == NULL) {
+            enc->error = -1;
+            return enc->error;
+        }
+        memcpy(tmp, t->stack, sizeof(cbor_json_frame_t) * t->depth);
+        if (t->stack != t->inline_stack) {
+            free(t->stack);
+        }
+        t->stack = tmp;
+        t->allocated = allocated;
+    }
+    frame = &t->stack[t->depth++];
+    frame->offset = enc->length;
+    frame->count = 0;
+    frame->type = type;
+    /* a one byte placeholder, most containers have fewer than 24 items */
+    cbor_encoder_byte(enc, (type << 5) | (t->patch ? 0 : 31));
+    return enc->error;
+}
+
+static int cbor_json_end(cbor_json_transcoder_t *t) {
+    cbor_encoder_t *enc = t->enc;
+    cbor_json_frame_t *frame = &t->stack[--t->depth];
+    size_t head, extra;
+
+    if (!t->patch) {
+        cbor_encoder_byte(enc, 0xFF);
+        return enc->error;
+    }
+    if (enc->error) {
+        return enc->error;
+    }
+    head = cbor__head_size(frame->count);
+    extra = head - 1;
+    if (extra > 0) {
+        if (enc->size - enc->length < extra && !cbor_encoder_grow(enc, extra)) {
+            enc->error = -1;
+            return enc->error;
+        }
+        memmove(enc->ptr + frame->offset + head, enc->ptr + frame->offset + 1, enc->length - frame->offset - 1);
+        enc->length += extra;
+        enc->total += extra;
+    }
+    cbor__write_head(enc->ptr + frame->offset, frame->type, frame->count);
+    return 0;
+}
+
+static int cbor_json_begin_object(void *userdata) {
+    return cbor_json_begin((cbor_json_transcoder_t *)userdata, CBOR_TYPE_MAP);
+}
+
+static int cbor_json_begin_array(void *userdata) {
+    return cbor_json_begin((cbor_json_transcoder_t *)userdata, CBOR_TYPE_ARRAY);
+}
+
+static int cbor_json_end_container(void *userdata) {
+    return cbor_json_end((cbor_json_transcoder_t *)userdata);
+}
+
+static int cbor_json_key(void *userdata, const char *ptr, size_t length) {
+    cbor_json_transcoder_t *t = (cbor_json_transcoder_t *)userdata;
+    t->stack[t->depth - 1].count++;
+    cbor_encoder_head(t->enc, CBOR_TYPE_STRING, length);
+    cbor_encoder_write(t->enc, ptr, length);
+    return t->enc->error;
+}
+
+static int cbor_json_string(void *userdata, const char *ptr, size_t length) {
+    cbor_json_transcoder_t *t = (cbor_json_transcoder_t *)userdata;
+    cbor_encoder_head(t->enc, CBOR_TYPE_STRING, length);
+    cbor_encoder_write(t->enc, ptr, length);
+    return cbor_json_item(t);
+}
+
+static int cbor_json_integer(void *userdata, bool negative, uint64_t magnitude) {
+    cbor_json_transcoder_t *t = (cbor_json_transcoder_t *)userdata;
+    if (negative) {
+        cbor_encoder_head(t->enc, CBOR_TYPE_NEGINT, magnitude - 1);
+    } else {
+        cbor_encoder_head(t->enc, CBOR_TYPE_UINT, magnitude);
+    }
+    return cbor_json_item(t);
+}
+
+static int cbor_json_real(void *userdata, double real) {
+    cbor_json_transcoder_t *t = (cbor_json_transcoder_t *)userdata;
+    cbor_encoder_double(t->enc, real);
+    return cbor_json_item(t);
+}
+
+static int cbor_json_boolean(void *userdata, bool b) {
+    cbor_json_transcoder_t *t = (cbor_json_transcoder_t *)userdata;
+    cbor_encoder_byte(t->enc, (CBOR_TYPE_SIMPLE << 5) | (b ? CBOR_SIMPLE_TRUE : CBOR_SIMPLE_FALSE));
+    return cbor_json_item(t);
+}
+
+static int cbor_json_null(void *userdata) {
+    cbor_json_transcoder_t *t = (cbor_json_transcoder_t *)userdata;
+    cbor_encoder_byte(t->enc, (CBOR_TYPE_SIMPLE << 5) | CBOR_SIMPLE_NULL);
+    return cbor_json_item(t);
+}
+
+int cbor_encode_json(cbor_encoder_t *enc, const void *src, int size, int flag, int *consume) {
+    static const cbor_json_sax_t sax = {
+        cbor_json_begin_object, cbor_json_end_container,
+        cbor_json_begin_array, cbor_json_end_container,
+        cbor_json_key, cbor_json_string,
+        cbor_json_integer, cbor_json_real, cbor_json_boolean, cbor_json_null,
+    };
+    cbor_json_transcoder_t t;
+
+    cbor_encoder_item(enc);
+    memset(&t, 0, sizeof(t));
+    t.enc = enc;
+    t.patch = enc->growable;
+    t.stack = t.inline_stack;
+    t.allocated = sizeof(t.inline_stack) / sizeof(t.inline_stack[0]);
+    if (cbor_json_sax_parse(src, size, flag, &sax, &t, consume) != 0) {
+        enc->error = -1;
+    }
+    if (t.stack != t.inline_stack) {
+        free(t.stack);
+    }
+    return enc->error;
+}
+
+#ifndef _WIN32
+typedef struct {
+    cbor_iovec_t *out;
+    size_t threshold;
+    size_t used;    /* bytes written to out->buffer */
+    size_t start;   /* where the open buffer segment began */
+} cbor_iov_writer_t;
+
+static void cbor_iov_measure(const cbor_value_t *src, size_t threshold, size_t *strings, size_t *bytes) {
+    cbor_value_t *var;
+    switch (src->type) {
+    case CBOR_TYPE_BYTESTRING:
+    case CBOR_TYPE_STRING:
+        if (src->blob.length >= threshold) {
+            (*strings)++;
+            *bytes += src->blob.length;
+        }
+        break;
+    case CBOR_TYPE_ARRAY:
+        list_foreach(var, &src->container, entry) {
+            cbor_iov_measure(var, threshold, strings, bytes);
+        }
+        break;
+    case CBOR_TYPE_MAP:
+        list_foreach(var, &src->container, entry) {
+            cbor_iov_measure(var->pair.key, threshold, strings, bytes);
+            cbor_iov_measure(var->pair.value, threshold, strings, bytes);
+        }
+        break;
+    case CBOR_TYPE_TAG:
+        cbor_iov_measure(src->tag.content, threshold, strings, bytes);
+        break;
+    default:
+        break;
+    }
+}
+
+static void cbor_iov_push(cbor_iov_writer_t *w, char *base, size_t length) {
+    struct iovec *iov = &w->out->iov[w->out->count++];
+    iov->iov_base = base;
+    iov->iov_len = length;
+}
+
+/* close the open buffer segment, if it holds anything */
+static void cbor_iov_cut(cbor_iov_writer_t *w) {
+    if (w->used > w->start) {
+        cbor_iov_push(w, w->out->buffer + w->start, w->used - w->start);
+        w->start = w->used;
+    }
+}
+
+static void cbor_iov_write(cbor_iov_writer_t *w, const cbor_value_t *src) {
+    char *ptr = w->out->buffer + w->used;
+    cbor_value_t *var;
+
+    switch (src->type) {
+    case CBOR_TYPE_BYTESTRING:
+    case CBOR_TYPE_STRING:
+        if (src->blob.length < w->threshold) {
+            w->used = cbor__dumps(src, ptr, 0) - w->out->buffer;
+            break;
+        }
+        w->used = cbor__write_head(ptr, src->type, src->blob.length) - w->out->buffer;
+        cbor_iov_cut(w);
+        cbor_iov_push(w, src->blob.ptr, src->blob.length);
+        break;
+    case CBOR_TYPE_ARRAY:
+        w->used = cbor__write_head(ptr, src->type, cbor_container_size(src)) - w->out->buffer;
+        list_foreach(var, &src->container, entry) {
+            cbor_iov_write(w, var);
+        }
+        break;
+    case CBOR_TYPE_MAP:
+        w->used = cbor__write_head(ptr, src->type, cbor_container_size(src)) - w->out->buffer;
+        list_foreach(var, &src->container, entry) {
+            cbor_iov_write(w, var->pair.key);
+            cbor_iov_write(w, var->pair.value);
+        }
+        break;
+    case CBOR_TYPE_TAG:
+        w->used = cbor__write_head(ptr, src->type, src->tag.item) - w->out->buffer;
+        cbor_iov_write(w, src->tag.content);
+        break;
+    default:
+        w->used = cbor__dumps(src, ptr, 0) - w->out->buffer;
+        break;
+    }
+}
+
+/* return: 0 and the gather list in `out`, -1 on failure */
+int cbor_dumps_iov(const cbor_value_t *src, size_t threshold, cbor_iovec_t *out) {
+    cbor_iov_writer_t w;
+    size_t strings = 0, bytes = 0;
+
+    if (!src || !out) {
+        return -1;
+    }
+    memset(out, 0, sizeof(cbor_iovec_t));
+    if (threshold == 0) {
+        threshold = 1;
+    }
+    cbor_iov_measure(src, threshold, &strings, &bytes);
+    out->length = cbor_encoded_size(src);
+    /* each large string splits the buffer once: at most two entries per string */
+    out->iov = (struct iovec *)malloc(sizeof(struct iovec) * (strings * 2 + 1));
+    out->buffer = (char *)malloc(out->length - bytes + 1);
+    if (out->iov == NULL || out->buffer == NULL) {
+        cbor_iovec_release(out);
+        return -1;
+    }
+    memset(&w, 0, sizeof(w));
+    w.out = out;
+    w.threshold = threshold;
+    cbor_iov_write(&w, src);
+    cbor_iov_cut(&w);
+    assert(w.used == out->length - bytes);
+    return 0;
+}
+
+void cbor_iovec_release(cbor_iovec_t *out) {
+    if (out) {
+        free(out->iov);
+        free(out->buffer);
+        memset(out, 0, sizeof(cbor_iovec_t));
+    }
+}
+#endif
@@ -0,0 +1,241 @@
+#include "test.h"
+
+/* heap buffer: the released bytes, "" when release refuses them */
+static void heap_test(const char *name, void (*encode)(cbor_encoder_t *), const char *output) {
+    cbor_encoder_t enc;
+    size_t length = 0;
+    char *raw, *content;
+    cbor_encoder_init(&enc, NULL, 0);
+    encode(&enc);
+    raw = cbor_encoder_release(&enc, &length);
+    content = tohex(raw ? raw : "", raw ? length : 0);
+    report(!strcmp(content, output) && (raw != NULL) == (output[0] != '\0'), name, content);
+    free(content);
+    free(raw);
+}
+
+/* fixed buffer of exactly `size` bytes: 0 and the bytes when it fits, else -1 and the size it needed */
+static void fixed_test(const char *name, void (*encode)(cbor_encoder_t *), size_t size, int error, size_t total) {
+    char buf[64], content[64];
+    cbor_encoder_t enc;
+    cbor_encoder_init(&enc, buf, size);
+    encode(&enc);
+    snprintf(content, sizeof(content), "%d, %zu of %zu written", enc.error, enc.length, enc.total);
+    report(enc.error == error && enc.total == total && (error || enc.length == total), name, content);
+}
+
+typedef struct {
+    char *ptr;
+    size_t length;
+} encoded_t;
+
+static int collect(void *userdata, const char *ptr, size_t length) {
+    encoded_t *out = (encoded_t *)userdata;
+    out->ptr = (char *)realloc(out->ptr, out->length + length);
+    memcpy(out->ptr + out->length, ptr, length);
+    out->length += length;
+    return 0;
+}
+
+static void encode_zero(cbor_encoder_t *enc) {
+    cbor_encode_uint(enc, 0);
+}
+
+static void encode_pair(cbor_encoder_t *enc) {
+    cbor_encode_begin_array(enc, 2);
+    cbor_encode_uint(enc, 1);
+    cbor_encode_uint(enc, 2);
+    cbor_encode_end(enc);
+}
+
+static void encode_scalars(cbor_encoder_t *enc) {
+    cbor_encode_begin_array(enc, 9);
+    cbor_encode_uint(enc, 1000);
+    cbor_encode_integer(enc, -1000);
+    cbor_encode_integer(enc, 1000000000000LL);
+    cbor_encode_double(enc, 1.5);
+    cbor_encode_double(enc, 0.1);
+    cbor_encode_boolean(enc, true);
+    cbor_encode_null(enc);
+    cbor_encode_string(enc, "IETF", -1);
+    cbor_encode_bytestring(enc, "\x01\x02", 2);
+    cbor_encode_end(enc);
+}
+
+static void encode_nested(cbor_encoder_t *enc) {
+    cbor_encode_begin_map(enc, 2);
+    cbor_encode_string(enc, "a", -1);
+    cbor_encode_tag(enc, 1);
+    cbor_encode_uint(enc, 1363896240);
+    cbor_encode_string(enc, "b", -1);
+    cbor_encode_begin_array(enc, CBOR_INDEFINITE);
+    cbor_encode_uint(enc, 1);
+    cbor_encode_begin_map(enc, CBOR_INDEFINITE);
+    cbor_encode_string(enc, "c", -1);
+    cbor_encode_tag(enc, 2);
+    cbor_encode_tag(enc, 3);
+    cbor_encode_null(enc);
+    cbor_encode_end(enc);
+    cbor_encode_end(enc);
+    cbor_encode_end(enc);
+}
+
+static void encode_too_many(cbor_encoder_t *enc) {
+    cbor_encode_begin_array(enc, 1);
+    cbor_encode_uint(enc, 1);
+    cbor_encode_uint(enc, 2);
+    cbor_encode_uint(enc, 3);
+    cbor_encode_end(enc);
+}
+
+static void encode_too_few(cbor_encoder_t *enc) {
+    cbor_encode_begin_map(enc, 2);
+    cbor_encode_uint(enc, 1);
+    cbor_encode_uint(enc, 2);
+    cbor_encode_uint(enc, 3);
+    cbor_encode_end(enc);
+}
+
+static void encode_key_only(cbor_encoder_t *enc) {
+    cbor_encode_begin_map(enc, CBOR_INDEFINITE);
+    cbor_encode_uint(enc, 1);
+    cbor_encode_end(enc);
+}
+
+static void encode_bare_tag(cbor_encoder_t *enc) {
+    cbor_encode_begin_array(enc, 1);
+    cbor_encode_tag(enc, 1);
+    cbor_encode_end(enc);
+}
+
+static void encode_unclosed(cbor_encoder_t *enc) {
+    cbor_encode_begin_array(enc, CBOR_INDEFINITE);
+}
+
+/* cbor_encode_json into a heap buffer gives the bytes of the parsed tree,
+ * through a callback in 7 byte blocks a document that decodes to the same tree */
+static void json_test(const char *name, const char *input) {
+    cbor_value_t *val = cbor_json_loads_ex(input, -1, 0, NULL), *back = NULL;
+    cbor_encoder_t enc;
+    size_t length = 0, size = 0, back_size = 0;
+    char *raw = val ? cbor_dumps(val, &length) : NULL, *direct, *back_raw = NULL;
+    char block[7], content[64];
+    encoded_t out;
+    int consume = -1;
+
+    cbor_encoder_init(&enc, NULL, 0);
+    cbor_encode_json(&enc, input, -1, 0, &consume);
+    direct = cbor_encoder_release(&enc, &size);
+
+    memset(&out, 0, sizeof(out));
+    cbor_encoder_init_cb(&enc, block, sizeof(block), collect, &out);
+    if (cbor_encode_json(&enc, input, -1, 0, NULL) == 0 && cbor_encoder_flush(&enc) == 0) {
+        back_size = out.length;
+        back = cbor_loads(out.ptr, &back_size);
+    }
+    back_raw = back ? cbor_dumps(back, &back_size) : NULL;
+    snprintf(content, sizeof(content), "%zu of %zu bytes, consumed %d", size, length, consume);
+    report(raw && direct && size == length && !memcmp(direct, raw, length) && consume == (int)strlen(input)
+           && back_raw && back_size == length && !memcmp(back_raw, raw, length), name, content);
+    free(back_raw);
+    free(direct);
+    free(raw);
+    free(out.ptr);
+    cbor_destroy(back);
+    cbor_destroy(val);
+}
+
+/* JSON of `count` + 1 nested arrays around an array of `items` integers and
+ * an object of `items` members */
+static char *json_build(int count, int items) {
+    char *src = (char *)malloc((size_t)count * 2 + (size_t)items * 40 + 16), *ptr = src;
+    int i;
+
+    for (i = 0; i <= count; i++) {
+        *ptr++ = '[';
+    }
+    *ptr++ = '[';
+    for (i = 0; i < items; i++) {
+        ptr += sprintf(ptr, i ? ", %d" : "%d", i * 37 - 500);
+    }
+    ptr += sprintf(ptr, "], {");
+    for (i = 0; i < items; i++) {
+        ptr += sprintf(ptr, i ? ", \"k%d\": %d.5" : "\"k%d\": %d.5", i, i);
+    }
+    *ptr++ = '}';
+    for (i = 0; i <= count; i++) {
+        *ptr++ = ']';
+    }
+    *ptr = '\0';
+    return src;
+}
+
+static void json_build_test(int count, int items) {
+    char *src = json_build(count, items);
+    char name[64];
+    snprintf(name, sizeof(name), "json %d deep, %d items", count, items);
+    json_test(name, src);
+    free(src);
+}
+
+/* malformed JSON fails the encoder and release gives nothing */
+static void json_error_test(const char *input) {
+    cbor_encoder_t enc;
+    size_t length = 0;
+    char *raw;
+    int r;
+
+    cbor_encoder_init(&enc, NULL, 0);
+    r = cbor_encode_json(&enc, input, -1, 0, NULL);
+    raw = cbor_encoder_release(&enc, &length);
+    report(r == -1 && raw == NULL, input, "");
+    free(raw);
+}
+
+static void encode_tree(cbor_encoder_t *enc) {
+    cbor_value_t *val = cbor_json_loads("{\"a\": [1, 2]}", -1);
+    cbor_encode_begin_array(enc, 2);
+    cbor_encode_value(enc, val);
+    cbor_encode_json(enc, "[true, {\"b\": null}]", -1, 0, NULL);
+    cbor_encode_end(enc);
+    cbor_destroy(val);
+}
+
+int main(int argc, char **argv) {
+    heap_test("zero", encode_zero, "00");
+    heap_test("pair", encode_pair, "820102");
+    heap_test("scalars", encode_scalars, "891903e83903e71b000000e8d4a51000f93e00fb3fb999999999999af5f66449455446420102");
+    heap_test("nested", encode_nested, "a26161c11a514b67b061629f01bf6163c2c3f6ffff");
+    heap_test("tree", encode_tree, "82a161618201028" "2f5a16162f6");
+    heap_test("too many", encode_too_many, "");
+    heap_test("too few", encode_too_few, "");
+    heap_test("key only", encode_key_only, "");
+    heap_test("bare tag", encode_bare_tag, "");
+    heap_test("unclosed", encode_unclosed, "");
+    fixed_test("zero in 1 byte", encode_zero, 1, 0, 1);
+    fixed_test("zero in 0 bytes", encode_zero, 0, -1, 1);
+    fixed_test("pair in 3 bytes", encode_pair, 3, 0, 3);
+    fixed_test("pair in 2 bytes", encode_pair, 2, -1, 3);
+    fixed_test("scalars in 38 bytes", encode_scalars, 38, 0, 38);
+    fixed_test("scalars in 37 bytes", encode_scalars, 37, -1, 38);
+    fixed_test("scalars in 20 bytes", encode_scalars, 20, -1, 38);
+    json_test("scalar", "-17");
+    json_test("scalars", "[0, 23, 24, 255, 256, 65536, 4294967296, -1, -25, -18446744073709551616, "
+                         "18446744073709551615, -18446744073709551615, 1.5, 0.1, -2.5e3, true, false, null]");
+    json_test("strings", "{\"\": \"\", \"k\\u00e9y\": \"a\\\"b\\n\", \"long\": \""
+                         "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\"}");
+    json_test("empty", "[[], {}, [[]], {\"a\": {}}]");
+    json_build_test(0, 23);
+    json_build_test(0, 24);
+    json_build_test(1, 255);
+    json_build_test(2, 256);
+    json_build_test(31, 3);
+    json_build_test(32, 3);
+    json_build_test(200, 30);
+    json_build_test(0, 70000);
+    json_error_test("[1, 2,]");
+    json_error_test("{\"a\": [1, {\"b\" 2}]}");
+    json_error_test("[1, [2, 3]");
+    json_error_test("");
+    return failures != 0;
+}
@@ -0,0 +1,179 @@
+#include "cbor.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "define.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* payloads at least this long are written from the tree, not copied */
+#define CBOR_DUMPF_IOV_THRESHOLD 4096
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+/* return: 0 with the whole file in `file`, -1 on error or an empty file,
+ * errno is 0 for the latter */
+int cbor__file_map(cbor__file_t *file, const char *path) {
+#ifndef _WIN32
+    struct stat st;
+    void *ptr;
+    int fd = open(path, O_RDONLY);
+
+    memset(file, 0, sizeof(cbor__file_t));
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size <= 0) {
+        close(fd);
+        errno = 0;
+        return -1;
+    }
+    ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        return -1;
+    }
+    madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+    file->ptr = (const char *)ptr;
+    file->length = st.st_size;
+    file->mapped = true;
+    return 0;
+#else
+    char *content;
+    long length;
+    FILE *fp = fopen(path, "rb");
+
+    memset(file, 0, sizeof(cbor__file_t));
+    if (fp == NULL) {
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    length = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    if (length == 0) {
+        fclose(fp);
+        errno = 0;
+        return -1;
+    }
+    content = length > 0 ? (char *)malloc(length + 1) : NULL;
+    if (content == NULL || (size_t)length != fread(content, sizeof(char), length, fp)) {
+        free(content);
+        fclose(fp);
+        return -1;
+    }
+    content[length] = 0;
+    fclose(fp);
+    file->ptr = content;
+    file->length = length;
+    return 0;
+#endif
+}
+
+void cbor__file_unmap(cbor__file_t *file) {
+#ifndef _WIN32
+    if (file->mapped) {
+        munmap((void *)file->ptr, file->length);
+    } else
+#endif
+    {
+        free((void *)file->ptr);
+    }
+    memset(file, 0, sizeof(cbor__file_t));
+}
+
+cbor_value_t *cbor_loadf(const char *path) {
+    cbor__file_t file;
+    cbor_value_t *val;
+    size_t length;
+
+    if (path == NULL || cbor__file_map(&file, path) != 0) {
+        return NULL;
+    }
+    length = file.length;
+    val = cbor_loads(file.ptr, &length);
+    if (val && length != file.length) {
+        /* trailing bytes after the first item */
+        cbor_destroy(val);
+        val = NULL;
+    }
+    cbor__file_unmap(&file);
+    return val;
+}
+
+#ifndef _WIN32
+/* writev the whole list, IOV_MAX entries at a time, resuming short writes */
+static int cbor_dumpf_writev(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count < IOV_MAX ? count : IOV_MAX);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+#endif
+
+int cbor_dumpf(const cbor_value_t *val, const char *path) {
+#ifndef _WIN32
+    cbor_iovec_t out;
+    int fd, r;
+
+    if (val == NULL || path == NULL || cbor_dumps_iov(val, CBOR_DUMPF_IOV_THRESHOLD, &out) != 0) {
+        return -1;
+    }
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        cbor_iovec_release(&out);
+        return -1;
+    }
+    r = cbor_dumpf_writev(fd, out.iov, out.count);
+    if (close(fd) != 0) {
+        r = -1;
+    }
+    cbor_iovec_release(&out);
+    return r;
+#else
+    FILE *fp;
+    size_t length;
+    int r = -1;
+    char *content;
+
+    if (val == NULL || path == NULL) {
+        return -1;
+    }
+    content = cbor_dumps(val, &length);
+    fp = content ? fopen(path, "wb") : NULL;
+    if (fp) {
+        r = length == fwrite(content, sizeof(char), length, fp) ? 0 : -1;
+        if (fclose(fp) != 0) {
+            r = -1;
+        }
+    }
+    free(content);
+    return r;
+#endif
+}
@@ -0,0 +1,143 @@
+#include "test.h"
+#include <errno.h>
+
+#define TEST_PATH "file_test.tmp"
+
+static void write_file(const char *ptr, size_t length) {
+    FILE *fp = fopen(TEST_PATH, "wb");
+    if (fp) {
+        fwrite(ptr, 1, length, fp);
+        fclose(fp);
+    }
+}
+
+/* cbor_dumpf then cbor_loadf gives back the cbor_dumps bytes */
+/* files of exactly `size` bytes, a page multiple, so the mapping ends right
+ * after the last digit of a number */
+static void json_loadf_page_test(size_t size) {
+    char *src = (char *)malloc(size);
+    cbor_value_t *val;
+    char name[64];
+    int error = -1;
+
+    snprintf(name, sizeof(name), "%zu byte file", size);
+    memset(src, ' ', size);
+    memcpy(src, "[1", 2);
+    memcpy(src + size - 9, ",  23456]", 9);
+    write_file(src, size);
+    val = cbor_json_loadf_ex(TEST_PATH, 0, &error);
+    report(val && cbor_container_size(val) == 2 && cbor_integer(cbor_container_last(val)) == 23456 && error == 0,
+           name, "[1, 23456]");
+    cbor_destroy(val);
+
+    memcpy(src + size - 9, "], 123456", 9);
+    write_file(src, size);
+    val = cbor_json_loadf_ex(TEST_PATH, 0, &error);
+    report(val == NULL && error == JSON_LOADF_PARSE_ERROR, name, "[1] 123456");
+    cbor_destroy(val);
+
+    memset(src, '1', size);
+    write_file(src, size);
+    val = cbor_json_loadf_ex(TEST_PATH, 0, &error);
+    report(val && cbor_is_double(val) && error == 0, name, "all digits");
+    cbor_destroy(val);
+    free(src);
+}
+
+static void dumpf_test(const char *name, cbor_value_t *src) {
+    size_t length, size = 0;
+    char *raw = cbor_dumps(src, &length), *back = NULL;
+    cbor_value_t *dst = NULL;
+    char content[64];
+
+    if (cbor_dumpf(src, TEST_PATH) == 0) {
+        dst = cbor_loadf(TEST_PATH);
+    }
+    if (dst) {
+        back = cbor_dumps(dst, &size);
+    }
+    snprintf(content, sizeof(content), "%zu of %zu bytes", size, length);
+    report(back && size == length && !memcmp(back, raw, length), name, content);
+    free(back);
+    free(raw);
+    cbor_destroy(dst);
+    cbor_destroy(src);
+}
+
+/* cbor_loadf of a file holding `input`, "" when it fails */
+static void loadf_test(const char *input, bool ok) {
+    char buf[64];
+    cbor_value_t *val;
+
+    write_file(buf, unhex(input, buf));
+    val = cbor_loadf(TEST_PATH);
+    report((val != NULL) == ok, input, val ? "loaded" : "");
+    cbor_destroy(val);
+}
+
+/* cbor_json_loadf_ex of a file holding `input` and the error it reports */
+static void json_loadf_test(const char *input, int flag, int error) {
+    int result = -1;
+    char content[64];
+    cbor_value_t *val;
+
+    write_file(input, strlen(input));
+    val = cbor_json_loadf_ex(TEST_PATH, flag, &result);
+    snprintf(content, sizeof(content), "%s, error %d", val ? "loaded" : "failed", result);
+    report(result == error && (val != NULL) == (error == 0), input, content);
+    cbor_destroy(val);
+}
+
+int main(int argc, char **argv) {
+    cbor_value_t *large = cbor_init_string(NULL, 0);
+    cbor_value_t *array, *val = NULL;
+    char chunk[1000];
+    int i, error = -1;
+
+    dumpf_test("small", cbor_json_loads(JSON({"a": [1, 2.5, "b"], "c": null}), -1));
+    memset(chunk, 'x', sizeof(chunk));
+    for (i = 0; i < 10; i++) {
+        cbor_blob_append(large, chunk, sizeof(chunk));
+    }
+    array = cbor_init_array();
+    cbor_container_insert_tail(array, cbor_init_integer(1));
+    cbor_container_insert_tail(array, large);
+    cbor_container_insert_tail(array, cbor_duplicate(large));
+    cbor_container_insert_tail(array, cbor_init_integer(2));
+    dumpf_test("large strings", array);
+
+    loadf_test("820102", true);
+    loadf_test("01", true);
+    loadf_test("01ffffff", false);
+    loadf_test("820102" "00", false);
+    loadf_test("8201", false);
+    loadf_test("", false);
+
+    json_loadf_test(JSON({"a": [1, 2, 3]}), 0, 0);
+    json_loadf_test(JSON({"a": [1, 2, 3]}) " \n", 0, 0);
+    json_loadf_test(JSON({"a": [1, 2, }), 0, JSON_LOADF_PARSE_ERROR);
+    json_loadf_test("", 0, JSON_LOADF_PARSE_ERROR);
+    json_loadf_test(" \n\t", 0, JSON_LOADF_PARSE_ERROR);
+    json_loadf_test("[1] [2]", 0, JSON_LOADF_PARSE_ERROR);
+    json_loadf_test("[1] x", 0, JSON_LOADF_PARSE_ERROR);
+    json_loadf_test("1 2", 0, JSON_LOADF_PARSE_ERROR);
+    json_loadf_test("[1] // done\n", 0, JSON_LOADF_PARSE_ERROR);
+    json_loadf_test("/* a */ [1] // done\n /* b */ # c", JSON_PARSER_ALLOW_COMMENT, 0);
+    json_loadf_test("[1] // done\n 2", JSON_PARSER_ALLOW_COMMENT, JSON_LOADF_PARSE_ERROR);
+    json_loadf_page_test(4096);
+    json_loadf_page_test(65536 * 4);
+
+    array = cbor_json_loads(JSON([1, "two"]), -1);
+    report(cbor_json_dumpf(array, TEST_PATH, false) == 0 && (val = cbor_json_loadf_ex(TEST_PATH, 0, &error)) != NULL
+           && error == 0 && cbor_container_size(val) == 2, "cbor_json_dumpf", "");
+    cbor_destroy(val);
+    report(cbor_json_dumpf(array, "file_test.missing/" TEST_PATH, false) == -1, "cbor_json_dumpf missing dir", "");
+    cbor_destroy(array);
+
+    remove(TEST_PATH);
+    errno = 0;
+    report(cbor_loadf(TEST_PATH) == NULL, "cbor_loadf missing file", "");
+    report(cbor_json_loadf_ex(TEST_PATH, 0, &error) == NULL && error == JSON_LOADF_IO_ERROR && errno == ENOENT,
+           "cbor_json_loadf_ex missing file", "");
+    return failures != 0;
+}
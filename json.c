@@ -1,5 +1,7 @@
 #include "cbor.h"
 #include <ctype.h>
+#include <errno.h>
+#include <limits.h>
 #include <math.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -17,6 +19,8 @@ typedef enum {
     JSON_ERR_STRING_INFINITY,
     JSON_ERR_STRING_CODEPOINT,
     JSON_ERR_UNSUPPORTED_TYPE,
+    JSON_ERR_DEPTH,
+    JSON_ERR_UTF8,
 } lexer_error;
 
 const char *json_err_str[] = {
@@ -30,6 +34,8 @@ const char *json_err_str[] = {
     "infinity string value",
     "unicode point error",
     "unsupported cbor type",
+    "nesting too deep",
+    "invalid utf-8",
     NULL,
 };
 
@@ -37,99 +43,102 @@ typedef struct lexer_s {
     const char *source;
     const char *eof;
     const char *cursor;
-    const char *linst;
     int flags;
     lexer_error last_error;
-    int linum;
-    int linoff;
 } lexer_t;
 
+enum {
+    JSON_SCALAR_INTEGER,        /* `uint` with `negative` */
+    JSON_SCALAR_REAL,           /* `dbl` */
+    JSON_SCALAR_TRUE,
+    JSON_SCALAR_FALSE,
+    JSON_SCALAR_NULL,
+};
+
+typedef struct {
+    int kind;
+    bool negative;
+    uint64_t uint;
+    double dbl;
+} json_scalar_t;
+
+/* an open container, stack[0] holds the root which owns the rest */
+typedef struct {
+    cbor_value_t *container;
+    cbor_value_t *key;          /* object key still waiting for its value */
+} json_frame_t;
+
+static bool json_depth_exceeded(int flags, size_t depth) {
+    size_t limit = JSON_DEPTH_LIMIT(flags);
+    return limit > 0 && depth >= limit;
+}
+
 cbor_value_t *json_parse_string(lexer_t *lexer);
 cbor_value_t *json_parse_value(lexer_t *lexer);
 
+/* byte `n` past the cursor, 0 at or beyond the end of input */
+static int lexer_peek(const lexer_t *lexer, size_t n) {
+    return n < (size_t)(lexer->eof - lexer->cursor) ? (unsigned char)lexer->cursor[n] : 0;
+}
+
+static bool lexer_match(const lexer_t *lexer, const char *word, size_t n, bool icase) {
+    if ((size_t)(lexer->eof - lexer->cursor) < n) {
+        return false;
+    }
+    return icase ? !strncasecmp(lexer->cursor, word, n) : !strncmp(lexer->cursor, word, n);
+}
+
+/* isspace() of the C locale, without the per byte locale lookup */
+static const bool json_space[256] = {
+    ['\t'] = true, ['\n'] = true, ['\v'] = true, ['\f'] = true, ['\r'] = true, [' '] = true,
+};
+
+/* the opening delimiter is consumed, nested comments must close too */
 static void lexer_skip_block_comment(lexer_t *lexer) {
+    size_t depth = 1;
     while (lexer->cursor < lexer->eof) {
         int ch = (unsigned char)*lexer->cursor;
-        if (ch == '*' && lexer->cursor + 2 < lexer->eof) {
-            int next = lexer->cursor[1];
-            if (next == '/') {
-                lexer->linoff += 2;
-                lexer->cursor += 2;
+        if (ch == '*' && lexer->cursor + 1 < lexer->eof && lexer->cursor[1] == '/') {
+            lexer->cursor += 2;
+            if (--depth == 0) {
                 break;
-            } else {
-                lexer->linoff++;
-                lexer->cursor++;
-            }
-        } else if (ch == '/' && lexer->cursor + 2 < lexer->eof) {
-            int next = (unsigned char)lexer->cursor[1];
-            if (next == '*') {
-                lexer->linoff += 2;
-                lexer->cursor += 2;
-                lexer_skip_block_comment(lexer);
-            } else {
-                lexer->cursor++;
-                lexer->linoff++;
-            }
-        } else if (ch == '\r') {
-            lexer->linum++;
-            lexer->cursor++;
-            lexer->linoff = 0;
-            lexer->linst = lexer->cursor;
-        } else if (ch == '\n') {
-            int prev = (unsigned char)lexer->cursor[-1];
-            if (prev != '\r' && lexer->cursor > lexer->source) {
-                lexer->linum++;
-                lexer->cursor++;
-                lexer->linoff = 0;
-                lexer->linst = lexer->cursor;
-            } else {
-                lexer->cursor++;
             }
+        } else if (ch == '/' && lexer->cursor + 1 < lexer->eof && lexer->cursor[1] == '*') {
+            lexer->cursor += 2;
+            depth++;
         } else {
             lexer->cursor++;
-            lexer->linoff++;
         }
     }
 }
 
+static void lexer_skip_line(lexer_t *lexer) {
+    while (lexer->cursor < lexer->eof && *lexer->cursor != '\n' && *lexer->cursor != '\r') {
+        lexer->cursor++;
+    }
+}
+
 static void lexer_skip_whitespace(lexer_t *lexer) {
     while (lexer->cursor < lexer->eof) {
         int ch = (unsigned char)*lexer->cursor;
-        if (ch == '\r' && lexer->cursor[1] == '\n') {
-            lexer->linum++;
-            lexer->cursor += 2;
-            lexer->linoff = 0;
-            lexer->linst = lexer->cursor;
-        } else if (ch == '\r' || ch == '\n') {
-            lexer->linum++;
+        if (json_space[ch]) {
+            /* separators are one space, longer runs are indentation for the vector scan */
             lexer->cursor++;
-            lexer->linoff = 0;
-            lexer->linst = lexer->cursor;
-        } else if (isspace(ch)) {
-            lexer->cursor++;
-            lexer->linoff++;
-        } else if (ch == '#' && lexer->flags & JSON_PARSER_ALLOW_COMMENT) {
-            while (lexer->cursor < lexer->eof
-                   && *lexer->cursor != '\n'
-                   && *lexer->cursor != '\r') {
-                lexer->cursor++;
-                lexer->linoff++;
+            if (lexer->cursor < lexer->eof && json_space[(unsigned char)*lexer->cursor]) {
+                lexer->cursor = json__space_scan(lexer->cursor + 1, lexer->eof);
             }
-        } else if (ch == '/' && lexer->cursor + 2 < lexer->eof && lexer->flags & JSON_PARSER_ALLOW_COMMENT) {
+        } else if (ch == '#' && lexer->flags & JSON_PARSER_ALLOW_COMMENT) {
+            lexer_skip_line(lexer);
+        } else if (ch == '/' && lexer->cursor + 1 < lexer->eof && lexer->flags & JSON_PARSER_ALLOW_COMMENT) {
             int next = lexer->cursor[1];
             if (next == '/') {
                 lexer->cursor += 2;
-                lexer->linoff += 2;
-                while (lexer->cursor < lexer->eof
-                       && *lexer->cursor != '\n'
-                       && *lexer->cursor != '\r') {
-                    lexer->cursor++;
-                    lexer->linoff++;
-                }
+                lexer_skip_line(lexer);
             } else if (next == '*') {
                 lexer->cursor += 2;
-                lexer->linoff += 2;
                 lexer_skip_block_comment(lexer);
+            } else {
+                break;
             }
         } else {
             break;
@@ -137,22 +146,41 @@ static void lexer_skip_whitespace(lexer_t *lexer) {
     }
 }
 
+/* line of the cursor, counted from the start only when an error is reported:
+ * "\r\n", "\r" and "\n" each end a line */
+static int lexer_line(const lexer_t *lexer, const char **linst) {
+    const char *ptr;
+    int linum = 1;
+
+    *linst = lexer->source;
+    for (ptr = lexer->source; ptr < lexer->cursor; ptr++) {
+        if (*ptr == '\n' || (*ptr == '\r' && (ptr + 1 == lexer->eof || ptr[1] != '\n'))) {
+            linum++;
+            *linst = ptr + 1;
+        }
+    }
+    return linum;
+}
+
 void json_lexer_error(lexer_t *lexer) {
     int i;
     int offset = 0;
+    const char *linst;
+    int linum = lexer_line(lexer, &linst);
+    int linoff = (int)(lexer->cursor - linst);
     cbor_value_t *output = cbor_init_string(NULL, 0);
-    cbor_blob_append_v(output, "json lexer error at line %d, offset %d\n", lexer->linum, lexer->linoff);
-    cbor_blob_append_v(output, "%04d | ", lexer->linum);
+    cbor_blob_append_v(output, "json lexer error at line %d, offset %d\n", linum, linoff);
+    cbor_blob_append_v(output, "%04d | ", linum);
     offset = 7;
-    if (lexer->linoff > 50) {
+    if (linoff > 50) {
         cbor_blob_append_v(output, " ... ");
         offset += 5;
-        for (i = lexer->linoff - 20;
-             lexer->linst[i] != '\r' && lexer->linst[i] != '\n' && i < lexer->linoff + 20;
+        for (i = linoff - 20;
+             linst + i < lexer->eof && linst[i] != '\r' && linst[i] != '\n' && i < linoff + 20;
              i++) {
-            cbor_blob_append_byte(output, (unsigned char)lexer->linst[i]);
+            cbor_blob_append_byte(output, (unsigned char)linst[i]);
         }
-        if (lexer->linst[i] != '\r' && lexer->linst[i] != '\n') {
+        if (linst + i < lexer->eof && linst[i] != '\r' && linst[i] != '\n') {
             cbor_blob_append_v(output, " ...\n");
         } else {
             cbor_blob_append_byte(output, '\n');
@@ -160,16 +188,16 @@ void json_lexer_error(lexer_t *lexer) {
         offset += 20;
     } else {
         for (i = 0;
-             lexer->linst[i] != '\r' && lexer->linst[i] != '\n' && i < 70;
+             linst + i < lexer->eof && linst[i] != '\r' && linst[i] != '\n' && i < 70;
              i++) {
-            cbor_blob_append_byte(output, (unsigned char)lexer->linst[i]);
+            cbor_blob_append_byte(output, (unsigned char)linst[i]);
         }
-        if (lexer->linst[i] != '\r' && lexer->linst[i] != '\n') {
+        if (linst + i < lexer->eof && linst[i] != '\r' && linst[i] != '\n') {
             cbor_blob_append_v(output, " ...\n");
         } else {
             cbor_blob_append_byte(output, '\n');
         }
-        offset += lexer->linoff;
+        offset += linoff;
     }
     offset++;
     cbor_blob_append_v(output, "%*s\n", offset, "^");
@@ -179,145 +207,6 @@ void json_lexer_error(lexer_t *lexer) {
     cbor_destroy(output);
 }
 
-cbor_value_t *json_parse_object(lexer_t *lexer) {
-    cbor_value_t *object;
-
-    object = cbor_init_map();
-
-    lexer_skip_whitespace(lexer);
-
-    int leader = (unsigned char)*lexer->cursor;
-    if (leader == '}') {
-        lexer->cursor++;
-        lexer->linoff++;
-        return object;
-    }
-
-    while (lexer->cursor < lexer->eof) {
-        cbor_value_t *item;
-        cbor_value_t *key = NULL;
-        cbor_value_t *val = NULL;
-
-        lexer_skip_whitespace(lexer);
-
-        int leader = (unsigned char)*lexer->cursor;
-
-        if (leader == '"') {
-            key = json_parse_string(lexer);
-            if (key == NULL) {
-                cbor_destroy(object);
-                object = NULL;
-                break;
-            }
-
-            lexer_skip_whitespace(lexer);
-
-            leader = (unsigned char)*lexer->cursor;
-
-            if (leader == ':') {
-                lexer->cursor++;
-                lexer->linoff++;
-
-                val = json_parse_value(lexer);
-
-                if (val == NULL) {
-                    cbor_destroy(key);
-                    cbor_destroy(object);
-                    object = NULL;
-                    break;
-                }
-
-                item = cbor_init_pair(key, val);
-                cbor_container_insert_tail(object, item);
-
-                lexer_skip_whitespace(lexer);
-
-                leader = *lexer->cursor;
-
-                if (leader == ',') {
-                    lexer->cursor++;
-                    lexer->linoff++;
-                    continue;
-                } else if (leader == '}') {
-                    lexer->cursor++;
-                    lexer->linoff++;
-                    break;
-                } else {
-                    /* unexpected */
-                    lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
-                    cbor_destroy(object);
-                    object = NULL;
-                    break;
-                }
-            } else {
-                /* unexpected */
-                lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
-                cbor_destroy(key);
-                cbor_destroy(object);
-                object = NULL;
-                break;
-            }
-        } else {
-            /* unexpected */
-            lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
-            cbor_destroy(object);
-            object = NULL;
-            break;
-        }
-    }
-    return object;
-}
-
-cbor_value_t *json_parse_array(lexer_t *lexer) {
-    cbor_value_t *array;
-
-    array = cbor_init_array();
-
-    lexer_skip_whitespace(lexer);
-
-    int leader = (unsigned char)*lexer->cursor;
-    if (leader == ']') {
-        lexer->cursor++;
-        lexer->linoff++;
-        return array;
-    }
-
-    while (lexer->cursor < lexer->eof) {
-        cbor_value_t *elm = NULL;
-
-        elm = json_parse_value(lexer);
-        if (elm) {
-            cbor_container_insert_tail(array, elm);
-            elm = NULL;
-        } else {
-            cbor_destroy(array);
-            array = NULL;
-            break;
-        }
-
-        lexer_skip_whitespace(lexer);
-
-        int leader = (unsigned char)*lexer->cursor;
-
-        if (leader == ',') {
-            lexer->cursor++;
-            lexer->linoff++;
-            continue;
-        } else if (leader == ']') {
-            lexer->cursor++;
-            lexer->linoff++;
-            break;
-        } else {
-            /* unexpected */
-            lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
-            cbor_destroy(array);
-            array = NULL;
-            break;
-        }
-    }
-    return array;
-}
-
 int json_read_utf16(lexer_t *lexer) {
     int codepoint = 0;
     for (int i = 0; i < 4; i++) {
@@ -329,7 +218,6 @@ int json_read_utf16(lexer_t *lexer) {
         }
     }
     lexer->cursor += 4;
-    lexer->linoff += 4;
     return codepoint;
 }
 
@@ -360,70 +248,106 @@ void json_string_write_codepoint(cbor_value_t *str, int codepoint) {
     }
 }
 
-cbor_value_t *json_parse_string(lexer_t *lexer) {
-    cbor_value_t *str = cbor_init_string("", 0);
+/* return: closing quote of the string whose body starts at `ptr`, or where it ends early */
+static const char *json_string_extent(const char *ptr, const char *eof, bool *escaped) {
+    while ((ptr = json__string_scan(ptr, eof)) < eof) {
+        if (*ptr == '"' || *ptr == '\n' || *ptr == '\r') {
+            break;
+        }
+        if (*ptr == '\\') {
+            *escaped = true;
+            ptr++;
+        }
+        ptr++;
+    }
+    return ptr < eof ? ptr : eof;
+}
+
+/* the raw body of a string, escapes are ASCII and need no decoding first */
+static int lexer_check_utf8(lexer_t *lexer, const char *ptr, const char *close) {
+    size_t valid;
+    if (!(lexer->flags & JSON_PARSER_VALIDATE_UTF8)) {
+        return 0;
+    }
+    valid = cbor__utf8_check(ptr, close - ptr);
+    if (valid == (size_t)(close - ptr)) {
+        return 0;
+    }
+    lexer->cursor = ptr + valid;
+    lexer->last_error = JSON_ERR_UTF8;
+    return -1;
+}
+
+/* decode the string at the cursor, appending to `str`
+ * return: 0 on success, -1 with last_error set */
+static int json_lex_string(lexer_t *lexer, cbor_value_t *str) {
+    bool escaped = false;
+    bool failed = false;
+    const char *close;
 
     lexer->cursor++;
-    lexer->linoff++;
 
-    while (*lexer->cursor != '"') {
-        if (*lexer->cursor == '\\') {
-            if (lexer->cursor[1] == 'r') {
+    /* escapes only shrink a string: its raw length is enough room */
+    close = json_string_extent(lexer->cursor, lexer->eof, &escaped);
+    if (lexer_check_utf8(lexer, lexer->cursor, close) != 0) {
+        return -1;
+    }
+    cbor__blob_reserve(str, close - lexer->cursor);
+
+    while (lexer->cursor < lexer->eof) {
+        const char *run = json__string_scan(lexer->cursor, lexer->eof);
+        if (run > lexer->cursor) {
+            cbor_blob_append(str, lexer->cursor, run - lexer->cursor);
+            lexer->cursor = run;
+            continue;
+        }
+        if (*lexer->cursor == '"') {
+            break;
+        } else if (*lexer->cursor == '\\') {
+            if (lexer_peek(lexer, 1) == 'r') {
                 cbor_blob_append_byte(str, '\r');
                 lexer->cursor += 2;
-                lexer->linoff += 2;
-            } else if (lexer->cursor[1] == 'n') {
+            } else if (lexer_peek(lexer, 1) == 'n') {
                 cbor_blob_append_byte(str, '\n');
                 lexer->cursor += 2;
-                lexer->linoff += 2;
-            } else if (lexer->cursor[1] == 't') {
+            } else if (lexer_peek(lexer, 1) == 't') {
                 cbor_blob_append_byte(str, '\t');
                 lexer->cursor += 2;
-                lexer->linoff += 2;
-            } else if (lexer->cursor[1] == 'f') {
+            } else if (lexer_peek(lexer, 1) == 'f') {
                 cbor_blob_append_byte(str, '\f');
                 lexer->cursor += 2;
-                lexer->linoff += 2;
-            } else if (lexer->cursor[1] == '"') {
+            } else if (lexer_peek(lexer, 1) == '"') {
                 cbor_blob_append_byte(str, '"');
                 lexer->cursor += 2;
-                lexer->linoff += 2;
-            } else if (lexer->cursor[1] == '\\') {
+            } else if (lexer_peek(lexer, 1) == '\\') {
                 cbor_blob_append_byte(str, '\\');
                 lexer->cursor += 2;
-                lexer->linoff += 2;
-            } else if (lexer->cursor[1] == '/') {
+            } else if (lexer_peek(lexer, 1) == '/') {
                 cbor_blob_append_byte(str, '/');
                 lexer->cursor += 2;
-                lexer->linoff += 2;
-            } else if (lexer->cursor[1] == 'b') {
+            } else if (lexer_peek(lexer, 1) == 'b') {
                 cbor_blob_append_byte(str, '\b');
                 lexer->cursor += 2;
-                lexer->linoff += 2;
-            } else if (lexer->cursor[1] == 'u') {
+            } else if (lexer_peek(lexer, 1) == 'u') {
                 int high_surrogate = 0;
                 int low_surrogate = 0;
-                if (isxdigit((unsigned char)lexer->cursor[2])
-                    && isxdigit((unsigned char)lexer->cursor[3])
-                    && isxdigit((unsigned char)lexer->cursor[4])
-                    && isxdigit((unsigned char)lexer->cursor[5])) {
+                if (isxdigit(lexer_peek(lexer, 2))
+                    && isxdigit(lexer_peek(lexer, 3))
+                    && isxdigit(lexer_peek(lexer, 4))
+                    && isxdigit(lexer_peek(lexer, 5))) {
                     lexer->cursor += 2;
-                    lexer->linoff += 2;
                     high_surrogate = json_read_utf16(lexer);
                 } else {
                     lexer->last_error = JSON_ERR_HEX_VALUE;
-                    lexer->linoff += 2;
-                    cbor_destroy(str);
-                    str = NULL;
+                    failed = true;
                     break;
                 }
                 if (high_surrogate >= 0xD800 && high_surrogate <= 0xDBFF) {
-                    if (isxdigit((unsigned char)lexer->cursor[2])
-                        && isxdigit((unsigned char)lexer->cursor[3])
-                        && isxdigit((unsigned char)lexer->cursor[4])
-                        && isxdigit((unsigned char)lexer->cursor[5])) {
+                    if (isxdigit(lexer_peek(lexer, 2))
+                        && isxdigit(lexer_peek(lexer, 3))
+                        && isxdigit(lexer_peek(lexer, 4))
+                        && isxdigit(lexer_peek(lexer, 5))) {
                         lexer->cursor += 2;
-                        lexer->linoff += 2;
 
                         low_surrogate = json_read_utf16(lexer);
                         if (low_surrogate >= 0xDC00 && low_surrogate <= 0xDFFF) {
@@ -435,16 +359,12 @@ cbor_value_t *json_parse_string(lexer_t *lexer) {
                             json_string_write_codepoint(str, low_surrogate);
                         } else {
                             lexer->last_error = JSON_ERR_UTF16;
-                            lexer->linoff -= 4;
-                            cbor_destroy(str);
-                            str = NULL;
+                            failed = true;
                             break;
                         }
                     } else {
                         lexer->last_error = JSON_ERR_HEX_VALUE;
-                        lexer->linoff += 2;
-                        cbor_destroy(str);
-                        str = NULL;
+                        failed = true;
                         break;
                     }
                 } else {
@@ -453,420 +373,1399 @@ cbor_value_t *json_parse_string(lexer_t *lexer) {
             } else {
                 cbor_blob_append_byte(str, '\\');
                 lexer->cursor++;
-                lexer->linoff++;
             }
         } else if (*lexer->cursor == '\n' || *lexer->cursor == '\r') {
             lexer->last_error = JSON_ERR_STRING_BREAKLINE;
-            cbor_destroy(str);
-            str = NULL;
+            failed = true;
             break;
         } else {
             cbor_blob_append_byte(str, *lexer->cursor);
             lexer->cursor++;
-            lexer->linoff++;
         }
     }
 
+    if (failed) {
+        return -1;
+    }
     if (lexer->cursor < lexer->eof && *lexer->cursor == '"') {
         lexer->cursor++;
-        lexer->linoff++;
     } else {
-        if (lexer->last_error == JSON_ERR_NONE) {
-            lexer->last_error = JSON_ERR_STRING_INFINITY;
-            cbor_destroy(str);
-            str = NULL;
-        }
+        lexer->last_error = JSON_ERR_STRING_INFINITY;
+        return -1;
     }
+    cbor_blob_append(str, "", 0);
+    return 0;
+}
 
-    if (str) {
-        cbor_blob_append(str, "", 0);
+cbor_value_t *json_parse_string(lexer_t *lexer) {
+    cbor_value_t *str = cbor_init_string("", 0);
+    if (json_lex_string(lexer, str) != 0) {
+        cbor_destroy(str);
+        return NULL;
     }
-
     return str;
 }
 
-cbor_value_t *json_parse_number(lexer_t *lexer) {
-    char *end;
-    int sign = 0;
-    int frac = 0;
-    int exponent = 0;
+#define JSON_DECIMAL_DIGITS 19
+/* larger exponents only ever give 0 or infinity */
+#define JSON_EXPONENT_LIMIT 100000000
+
+static bool json_is_digit(int ch) {
+    return ch >= '0' && ch <= '9';
+}
+
+static bool json_is_alnum(int ch) {
+    return json_is_digit(ch) || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z');
+}
+
+/* digits at the cursor into the mantissa of `dec`, digits past the point
+ * scale the exponent down and digits that do not fit scale it up
+ * return: number of digits read */
+static size_t json_scan_digits(lexer_t *lexer, json__decimal_t *dec, int *significant, bool fraction) {
+    const char *start = lexer->cursor;
+
+    while (lexer->cursor < lexer->eof && json_is_digit(*lexer->cursor)) {
+        int digit = *lexer->cursor - '0';
+        if (*significant < JSON_DECIMAL_DIGITS) {
+            if (dec->mantissa != 0 || digit != 0) {
+                dec->mantissa = dec->mantissa * 10 + digit;
+                (*significant)++;
+            }
+            dec->exponent -= fraction;
+        } else {
+            dec->exponent += !fraction;
+            dec->truncated |= digit != 0;
+        }
+        lexer->cursor++;
+    }
+    return lexer->cursor - start;
+}
+
+/* return: 0 with the integer literal of `dec` in `value`, -1 if it exceeds 64 bits */
+static int json_decimal_to_uint64(const json__decimal_t *dec, uint64_t *value) {
+    const char *ptr;
+
+    if (!dec->truncated && dec->exponent == 0) {
+        *value = dec->mantissa;
+        return 0;
+    }
+    *value = 0;
+    for (ptr = dec->ptr; ptr < dec->end; ptr++) {
+        uint64_t digit = *ptr - '0';
+        if (*value > (UINT64_MAX - digit) / 10) {
+            return -1;
+        }
+        *value = *value * 10 + digit;
+    }
+    return 0;
+}
+
+/* -inf and -infinity after the sign, when JSON_PARSER_ALLOW_INF is set */
+static int json_lex_negative_inf(lexer_t *lexer, json_scalar_t *out) {
+    size_t left = lexer->eof - lexer->cursor;
+    int length = 0;
 
-    const char *ptr = lexer->cursor;
-    cbor_value_t *num = NULL;
+    if (left >= 8 && lexer_match(lexer, "infinity", 8, true)) {
+        length = 8;
+    } else if (left >= 3 && lexer_match(lexer, "inf", 3, true)) {
+        length = 3;
+    }
+    if (length == 0 || (length < (int)left && json_is_alnum((unsigned char)lexer->cursor[length]))) {
+        lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
+        return -1;
+    }
+    lexer->cursor += length;
+    out->kind = JSON_SCALAR_REAL;
+    out->dbl = -INFINITY;
+    return 0;
+}
 
+/* integers keep the full 64-bit range of CBOR and become doubles beyond it,
+ * fractions and exponents go to the nearest double */
+static int json_lex_number(lexer_t *lexer, json_scalar_t *out) {
+    json__decimal_t dec;
+    int significant = 0;
+    size_t digits;
+    bool fraction = false;
+    bool exponent = false;
+    size_t exponent_digits = 0;
+
+    memset(&dec, 0, sizeof(dec));
     if (*lexer->cursor == '-') {
-        sign = 1;
+        dec.negative = true;
         lexer->cursor++;
-        lexer->linoff++;
-    } else {
-        sign = 0;
     }
+    dec.ptr = lexer->cursor;
 
-    if (*lexer->cursor == '0') {
+    if (lexer->cursor < lexer->eof && *lexer->cursor == '0') {
         lexer->cursor++;
-        lexer->linoff++;
+        digits = 1;
     } else {
-        while (lexer->cursor < lexer->eof && isdigit(*lexer->cursor)) {
-            lexer->cursor++;
-            lexer->linoff++;
-        }
+        digits = json_scan_digits(lexer, &dec, &significant, false);
     }
 
-    if (*lexer->cursor == '.') {
+    if (lexer->cursor < lexer->eof && *lexer->cursor == '.') {
         lexer->cursor++;
-        lexer->linoff++;
-        frac = 1;
-        while (lexer->cursor < lexer->eof && isdigit(*lexer->cursor)) {
-            lexer->cursor++;
-            lexer->linoff++;
-        }
+        fraction = true;
+        digits += json_scan_digits(lexer, &dec, &significant, true);
     }
 
-    if (*lexer->cursor == 'e' || *lexer->cursor == 'E') {
-        exponent = 1;
+    if (lexer->cursor < lexer->eof && (*lexer->cursor == 'e' || *lexer->cursor == 'E')) {
+        bool negative = false;
+        int64_t value = 0;
+
+        exponent = true;
         lexer->cursor++;
-        lexer->linoff++;
-        if (*lexer->cursor == '-') {
-            lexer->cursor++;
-            lexer->linoff++;
-        } else if (*lexer->cursor == '+') {
+        if (lexer->cursor < lexer->eof && (*lexer->cursor == '-' || *lexer->cursor == '+')) {
+            negative = *lexer->cursor == '-';
             lexer->cursor++;
-            lexer->linoff++;
         }
-
-        while (lexer->cursor < lexer->eof && isdigit(*lexer->cursor)) {
+        while (lexer->cursor < lexer->eof && json_is_digit(*lexer->cursor)) {
+            if (value < JSON_EXPONENT_LIMIT) {
+                value = value * 10 + (*lexer->cursor - '0');
+            }
             lexer->cursor++;
-            lexer->linoff++;
+            exponent_digits++;
         }
+        dec.explicit_exponent = negative ? -value : value;
+        dec.exponent += dec.explicit_exponent;
     }
-    int tail = (unsigned char)*lexer->cursor;
+    dec.end = lexer->cursor;
 
-    if (isprint(tail)
-        && (isalpha(tail) || isdigit(tail))) {
-        /* handle +inf, -inf */
-        double dbl = strtod(ptr, &end);
-        if (isinf(dbl) && lexer->flags & JSON_PARSER_ALLOW_INF) {
-            lexer->linoff += (end - ptr);
-            lexer->cursor = end;
-            num = cbor_init_double(dbl);
-        } else {
-            lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
-        }
-    } else {
-        if (frac || exponent) {
-            num = cbor_init_double(strtod(ptr, &end));
-        } else {
-            num = cbor_init_integer(strtoll(ptr, &end, 10));
+    if (lexer->cursor < lexer->eof && json_is_alnum((unsigned char)*lexer->cursor)) {
+        if (dec.negative && digits == 0 && !fraction && !exponent
+            && (lexer->flags & JSON_PARSER_ALLOW_INF)) {
+            return json_lex_negative_inf(lexer, out);
         }
-        if (end != lexer->cursor) {
-            lexer->last_error = JSON_ERR_CONVERT_NUMBER;
+        lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
+        return -1;
+    }
+    if (digits == 0 || (exponent && exponent_digits == 0)) {
+        lexer->last_error = JSON_ERR_CONVERT_NUMBER;
+        return -1;
+    }
+
+    if (!fraction && !exponent && json_decimal_to_uint64(&dec, &out->uint) == 0) {
+        out->kind = JSON_SCALAR_INTEGER;
+        out->negative = dec.negative && out->uint != 0;
+        return 0;
+    }
+    out->kind = JSON_SCALAR_REAL;
+    out->dbl = json__decimal_to_double(&dec);
+    return 0;
+}
+
+/* a literal of `n` bytes at the cursor, which must not run into a letter or digit */
+static int json_lex_word(lexer_t *lexer, size_t n, int kind, double dbl, json_scalar_t *out) {
+    lexer->cursor += n;
+    if (json_is_alnum(lexer_peek(lexer, 0))) {
+        lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
+        return -1;
+    }
+    out->kind = kind;
+    out->dbl = dbl;
+    return 0;
+}
+
+/* any value but a string or container at the cursor
+ * return: 0 with the value in `out`, -1 with last_error set */
+static int json_lex_scalar(lexer_t *lexer, json_scalar_t *out) {
+    int leader = lexer_peek(lexer, 0);
+    bool nan = lexer->flags & JSON_PARSER_ALLOW_NAN;
+    bool inf = lexer->flags & JSON_PARSER_ALLOW_INF;
+
+    memset(out, 0, sizeof(json_scalar_t));
+    if (leader == '-' || json_is_digit(leader)) {
+        return json_lex_number(lexer, out);
+    } else if (leader == 't' && lexer_match(lexer, "true", 4, false)) {
+        return json_lex_word(lexer, 4, JSON_SCALAR_TRUE, 0, out);
+    } else if (leader == 'f' && lexer_match(lexer, "false", 5, false)) {
+        return json_lex_word(lexer, 5, JSON_SCALAR_FALSE, 0, out);
+    } else if (leader == 'n' && lexer_match(lexer, "null", 4, false)) {
+        return json_lex_word(lexer, 4, JSON_SCALAR_NULL, 0, out);
+    } else if ((leader == 'n' || leader == 'N') && nan && lexer_match(lexer, "nan", 3, true)) {
+        return json_lex_word(lexer, 3, JSON_SCALAR_REAL, NAN, out);
+    } else if ((leader == 'i' || leader == 'I') && inf) {
+        if (lexer_match(lexer, "infinity", 8, true)) {
+            return json_lex_word(lexer, 8, JSON_SCALAR_REAL, INFINITY, out);
+        } else if (lexer_match(lexer, "inf", 3, true)) {
+            return json_lex_word(lexer, 3, JSON_SCALAR_REAL, INFINITY, out);
         }
+        lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
+        return -1;
     }
+    lexer->last_error = leader == 't' || leader == 'f' || leader == 'n' || (leader == 'N' && nan)
+                        ? JSON_ERR_CHARACTER_SEQUENCE : JSON_ERR_UNEXPECTED_CHARACTER;
+    return -1;
+}
 
-    return num;
+static cbor_value_t *json_scalar_value(const json_scalar_t *scalar) {
+    cbor_value_t *val;
+    switch (scalar->kind) {
+    case JSON_SCALAR_INTEGER:
+        val = cbor_create(scalar->negative ? CBOR_TYPE_NEGINT : CBOR_TYPE_UINT);
+        val->uint = scalar->negative ? scalar->uint - 1 : scalar->uint;
+        return val;
+    case JSON_SCALAR_REAL:
+        return cbor_init_double(scalar->dbl);
+    case JSON_SCALAR_TRUE:
+        return cbor_init_boolean(true);
+    case JSON_SCALAR_FALSE:
+        return cbor_init_boolean(false);
+    default:
+        return cbor_init_null();
+    }
 }
 
-cbor_value_t *json_parse_value(lexer_t *lexer) {
+/* `"key" :` of an object member */
+static int json_parse_key(lexer_t *lexer, cbor_value_t **key) {
     lexer_skip_whitespace(lexer);
-    if (lexer->cursor >= lexer->eof) {
-        return NULL;
+    if (lexer_peek(lexer, 0) != '"') {
+        lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
+        return -1;
+    }
+    *key = json_parse_string(lexer);
+    if (*key == NULL) {
+        return -1;
+    }
+    lexer_skip_whitespace(lexer);
+    if (lexer_peek(lexer, 0) != ':') {
+        lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
+        cbor_destroy(*key);
+        *key = NULL;
+        return -1;
     }
+    lexer->cursor++;
+    return 0;
+}
 
-    int leader = (unsigned char)*lexer->cursor;
-    if (leader == '{') {
-        lexer->cursor += 1;
-        lexer->linoff += 1;
-        return json_parse_object(lexer);
-    } else if (leader == '[') {
-        lexer->cursor += 1;
-        lexer->linoff += 1;
-        return json_parse_array(lexer);
-    } else if (leader == '\"') {
-        return json_parse_string(lexer);
-    } else if (leader == 't') {
-        if (!strncmp(lexer->cursor, "true", 4)) {
-            lexer->cursor += 4;
-            lexer->linoff += 4;
-            int tail = (unsigned char)*lexer->cursor;
-            if (isprint(tail)
-                && (isalpha(tail)
-                    || isdigit(tail))) {
-                lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
-                return NULL;
-            } else {
-                return cbor_init_boolean(true);
+/* hand a complete value to the innermost open container */
+static void json_parse_link(json_frame_t *stack, size_t depth, cbor_value_t **root, cbor_value_t *val) {
+    json_frame_t *top;
+    if (depth == 0) {
+        *root = val;
+        return;
+    }
+    top = &stack[depth - 1];
+    if (top->key) {
+        cbor_container_insert_tail(top->container, cbor_init_pair(top->key, val));
+        top->key = NULL;
+    } else {
+        cbor_container_insert_tail(top->container, val);
+    }
+}
+
+/* one value, open containers on an explicit stack rather than the C stack */
+cbor_value_t *json_parse_value(lexer_t *lexer) {
+    json_frame_t inline_stack[32];
+    json_frame_t *stack = inline_stack;
+    size_t depth = 0;
+    size_t allocated = sizeof(inline_stack) / sizeof(inline_stack[0]);
+    cbor_value_t *root = NULL;
+    size_t i;
+
+    for (;;) {
+        json_scalar_t scalar;
+        cbor_value_t *val;
+        int leader;
+
+        lexer_skip_whitespace(lexer);
+        if (lexer->cursor >= lexer->eof) {
+            break;
+        }
+        leader = lexer_peek(lexer, 0);
+        if (leader == '{' || leader == '[') {
+            if (json_depth_exceeded(lexer->flags, depth)) {
+                lexer->last_error = JSON_ERR_DEPTH;
+                break;
             }
-        } else {
-            lexer->last_error = JSON_ERR_CHARACTER_SEQUENCE;
-            return NULL;
-        }
-
-    } else if (leader == 'f') {
-        if (!strncmp(lexer->cursor, "false", 5)) {
-            lexer->cursor += 5;
-            lexer->linoff += 5;
-            int tail = (unsigned char)*lexer->cursor;
-            if (isprint(tail)
-                && (isalpha(tail)
-                    || isdigit(tail))) {
-                lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
-                return NULL;
-            } else {
-                return cbor_init_boolean(false);
+            if (depth == allocated) {
+                json_frame_t *tmp = (json_frame_t *)malloc(sizeof(json_frame_t) * allocated * 2);
+                if (tmp == NULL) {
+                    break;
+                }
+                memcpy(tmp, stack, sizeof(json_frame_t) * depth);
+                if (stack != inline_stack) {
+                    free(stack);
+                }
+                stack = tmp;
+                allocated *= 2;
             }
-        } else {
-            lexer->last_error = JSON_ERR_CHARACTER_SEQUENCE;
-            return NULL;
-        }
-    } else if (leader == 'n') {
-        if (!strncmp(lexer->cursor, "null", 4)) {
-            lexer->cursor += 4;
-            lexer->linoff += 4;
-            int tail = (unsigned char)*lexer->cursor;
-            if (isprint(tail)
-                && (isalpha(tail)
-                    || isdigit(tail))) {
-                lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
-                return NULL;
-            } else {
-                return cbor_init_null();
-            }
-        } else if (!strncasecmp(lexer->cursor, "nan", 3) && lexer->flags & JSON_PARSER_ALLOW_NAN) {
-            double dbl = strtod(lexer->cursor, NULL);
-            lexer->cursor += 3;
-            lexer->linoff += 3;
-            int tail = (unsigned char)*lexer->cursor;
-            if (isprint(tail)
-                && (isalpha(tail)
-                    || isdigit(tail))) {
-                lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
-                return NULL;
+            lexer->cursor++;
+            val = leader == '{' ? cbor_init_map() : cbor_init_array();
+            json_parse_link(stack, depth, &root, val);
+            stack[depth].container = val;
+            stack[depth].key = NULL;
+            depth++;
+
+            lexer_skip_whitespace(lexer);
+            if (lexer_peek(lexer, 0) == (leader == '{' ? '}' : ']')) {
+                lexer->cursor++;
+                depth--;
+            } else if (leader == '{' && json_parse_key(lexer, &stack[depth - 1].key) != 0) {
+                break;
             } else {
-                return cbor_init_double(dbl);
+                continue;
             }
         } else {
-            lexer->last_error = JSON_ERR_CHARACTER_SEQUENCE;
-            return NULL;
-        }
-    } else if (leader == '-' || isdigit(leader)) {
-        return json_parse_number(lexer);
-    } else if ((leader == 'i' || leader == 'I') && lexer->flags & JSON_PARSER_ALLOW_INF) {
-        char *end;
-        if (!strncasecmp(lexer->cursor, "infinity", 8)) {
-            double dbl = strtod(lexer->cursor, &end);
-            lexer->cursor += 8;
-            lexer->linoff += 8;
-            int tail = (unsigned char)*lexer->cursor;
-            if (isprint(tail)
-                && (isalpha(tail)
-                    || isdigit(tail))) {
-                lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
-                return NULL;
-            } else {
-                return cbor_init_double(dbl);
-            }
-        } else if (!strncasecmp(lexer->cursor, "inf", 3)) {
-            double dbl = strtod(lexer->cursor, &end);
-            lexer->cursor += 3;
-            lexer->linoff += 3;
-            int tail = (unsigned char)*lexer->cursor;
-            if (isprint(tail)
-                && (isalpha(tail)
-                    || isdigit(tail))) {
-                lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
-                return NULL;
+            if (leader == '"') {
+                val = json_parse_string(lexer);
             } else {
-                return cbor_init_double(dbl);
+                val = json_lex_scalar(lexer, &scalar) == 0 ? json_scalar_value(&scalar) : NULL;
             }
-        } else {
-            lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
-            return NULL;
-        }
-    } else if (leader == 'N' && lexer->flags & JSON_PARSER_ALLOW_NAN) {
-        if (!strncasecmp(lexer->cursor, "nan", 3)) {
-            double dbl = strtod(lexer->cursor, NULL);
-            lexer->cursor += 3;
-            lexer->linoff += 3;
-            int tail = (unsigned char)*lexer->cursor;
-            if (isprint(tail)
-                && (isalpha(tail)
-                    || isdigit(tail))) {
+            if (val == NULL) {
+                break;
+            }
+            json_parse_link(stack, depth, &root, val);
+        }
+
+        /* close what ends here, stop before the next value */
+        while (depth > 0) {
+            bool map = cbor_is_map(stack[depth - 1].container);
+            lexer_skip_whitespace(lexer);
+            leader = lexer_peek(lexer, 0);
+            if (leader == (map ? '}' : ']')) {
+                lexer->cursor++;
+                depth--;
+                continue;
+            }
+            if (leader != ',') {
                 lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
-                return NULL;
             } else {
-                return cbor_init_double(dbl);
+                lexer->cursor++;
+                if (!map || json_parse_key(lexer, &stack[depth - 1].key) == 0) {
+                    break;
+                }
             }
-        } else {
-            lexer->last_error = JSON_ERR_CHARACTER_SEQUENCE;
-            return NULL;
+            goto fail;
         }
-    } else {
+        if (depth == 0) {
+            goto done;
+        }
+    }
+
+fail:
+    /* the input ended, or the value failed, with containers still open */
+    if (depth > 0 && lexer->last_error == JSON_ERR_NONE) {
         lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
-        return NULL;
     }
+    for (i = 0; i < depth; i++) {
+        cbor_destroy(stack[i].key);
+    }
+    cbor_destroy(root);
+    root = NULL;
+done:
+    if (stack != inline_stack) {
+        free(stack);
+    }
+    return root;
 }
 
-cbor_value_t *cbor_json_loads_ex(const void *src, int size, int flag, int *consume) {
+static void lexer_init(lexer_t *lexer, const char *src, size_t size, int flag) {
+    memset(lexer, 0, sizeof(lexer_t));
+    lexer->flags = flag;
+    lexer->source = src;
+    lexer->eof = src + size;
+    lexer->cursor = src;
+}
+
+static void lexer_release(lexer_t *lexer, int *consume) {
+    if (lexer->last_error != JSON_ERR_NONE && lexer->flags & JSON_PARSER_REPORT_ERROR) {
+        json_lexer_error(lexer);
+    }
+    if (consume) {
+        *consume = lexer->cursor - lexer->source;
+    }
+}
+
+cbor_value_t *cbor_json_loads_ex(const void *src, int size, int flag, int *consume) {
     lexer_t lexer;
     cbor_value_t *json;
-    memset(&lexer, 0, sizeof(lexer));
-    lexer.flags = flag;
-    lexer.source = src;
     if (!src) {
         return NULL;
     }
     if (size < 0) {
         size = strlen(src);
     }
-    lexer.eof = lexer.source + size;
-    lexer.cursor = lexer.source;
-    lexer.linst = lexer.source;
-    lexer.linum = 1;
-    lexer.linoff = 0;
+    lexer_init(&lexer, src, size, flag);
     json = json_parse_value(&lexer);
-    if (lexer.last_error != JSON_ERR_NONE && lexer.flags & JSON_PARSER_REPORT_ERROR) {
-        json_lexer_error(&lexer);
+    lexer_release(&lexer, consume);
+    return json;
+}
+
+/* `value, value, ...` up to the end of [src, src + size), appended to `array`:
+ * a slice of a top level array for cbor_json_loads_parallel
+ * return: 0 on success, -1 on malformed input */
+int json__parse_elements(const char *src, size_t size, int flag, cbor_value_t *array) {
+    lexer_t lexer;
+    int r = 0;
+
+    lexer_init(&lexer, src, size, flag);
+    for (;;) {
+        cbor_value_t *val = json_parse_value(&lexer);
+        if (val == NULL) {
+            r = -1;
+            break;
+        }
+        cbor_container_insert_tail(array, val);
+        lexer_skip_whitespace(&lexer);
+        if (lexer.cursor >= lexer.eof) {
+            break;
+        }
+        if (*lexer.cursor != ',') {
+            r = -1;
+            break;
+        }
+        lexer.cursor++;
     }
-    if (consume) {
-        *consume = lexer.cursor - lexer.source;
+    lexer_release(&lexer, NULL);
+    return r;
+}
+
+typedef enum {
+    JSON_SAX_VALUE,
+    JSON_SAX_KEY,
+    JSON_SAX_NEXT,              /* ',' or the closing bracket */
+} json_sax_state;
+
+/* the string at the cursor: a slice of the input unless it has escapes,
+ * which are decoded into `scratch` */
+static int json_sax_string(lexer_t *lexer, cbor_value_t **scratch, const char **ptr, size_t *length) {
+    bool escaped = false;
+    const char *close = json_string_extent(lexer->cursor + 1, lexer->eof, &escaped);
+
+    if (!escaped && close < lexer->eof && *close == '"') {
+        if (lexer_check_utf8(lexer, lexer->cursor + 1, close) != 0) {
+            return -1;
+        }
+        *ptr = lexer->cursor + 1;
+        *length = close - *ptr;
+        lexer->cursor = close + 1;
+        return 0;
     }
-    return json;
+    if (*scratch == NULL) {
+        *scratch = cbor_init_string("", 0);
+    }
+    (*scratch)->blob.length = 0;
+    if (json_lex_string(lexer, *scratch) != 0) {
+        return -1;
+    }
+    *ptr = (*scratch)->blob.ptr;
+    *length = (*scratch)->blob.length;
+    return 0;
 }
 
-cbor_value_t *cbor_json_loads(const void *src, int size) {
-    return cbor_json_loads_ex(src, size, 0, NULL);
+static int json_sax_scalar(const cbor_json_sax_t *sax, void *userdata, const json_scalar_t *scalar) {
+    switch (scalar->kind) {
+    case JSON_SCALAR_INTEGER:
+        return sax->integer ? sax->integer(userdata, scalar->negative, scalar->uint) : 0;
+    case JSON_SCALAR_REAL:
+        return sax->real ? sax->real(userdata, scalar->dbl) : 0;
+    case JSON_SCALAR_TRUE:
+    case JSON_SCALAR_FALSE:
+        return sax->boolean ? sax->boolean(userdata, scalar->kind == JSON_SCALAR_TRUE) : 0;
+    default:
+        return sax->null ? sax->null(userdata) : 0;
+    }
 }
 
-void json__dumps(const cbor_value_t *src, int indent, const char *space, int length, cbor_value_t *dst) {
-    int i;
-    char buffer[1024];
-    cbor_value_t *val;
-    if (cbor_is_integer(src)) {
-        int len = snprintf(buffer, sizeof(buffer), "%lld", cbor_integer(src));
-        cbor_blob_append(dst, buffer, len);
-    } else if (cbor_is_string(src)) {
-        cbor_blob_append_byte(dst, '"');
-        const char *ptr = cbor_string(src);
-        int size = cbor_string_size(src);
-
-        for (i = 0; i < size; i++) {
-            switch ((unsigned char)ptr[i]) {
-            case '\n':
-                cbor_blob_append_byte(dst, '\\');
-                cbor_blob_append_byte(dst, 'n');
+static int json_sax_event(int (*cb)(void *), void *userdata) {
+    return cb ? cb(userdata) : 0;
+}
+
+/* one value with the same grammar as json_parse_value, open containers are
+ * kept as their opening bracket on an explicit stack */
+static int json_sax_run(lexer_t *lexer, const cbor_json_sax_t *sax, void *userdata) {
+    char inline_stack[256];
+    char *stack = inline_stack;
+    size_t depth = 0;
+    size_t allocated = sizeof(inline_stack);
+    cbor_value_t *scratch = NULL;
+    json_sax_state state = JSON_SAX_VALUE;
+    int r = 0;
+
+    while (r == 0) {
+        json_scalar_t scalar;
+        const char *ptr;
+        size_t length;
+        int leader;
+
+        lexer_skip_whitespace(lexer);
+        if (lexer->cursor >= lexer->eof) {
+            /* empty input is no error, like in json_parse_value */
+            if (depth > 0 || state != JSON_SAX_VALUE) {
+                lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
+            }
+            r = -1;
+            break;
+        }
+        leader = lexer_peek(lexer, 0);
+
+        if (state == JSON_SAX_NEXT) {
+            bool object = stack[depth - 1] == '{';
+            if (leader == ',') {
+                lexer->cursor++;
+                state = object ? JSON_SAX_KEY : JSON_SAX_VALUE;
+            } else if (leader == (object ? '}' : ']')) {
+                lexer->cursor++;
+                depth--;
+                r = json_sax_event(object ? sax->end_object : sax->end_array, userdata);
+                if (depth == 0) {
+                    break;
+                }
+            } else {
+                lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
+                r = -1;
+            }
+            continue;
+        }
+
+        if (state == JSON_SAX_KEY) {
+            if (leader != '"') {
+                lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
+                r = -1;
                 break;
-            case '\t':
-                cbor_blob_append_byte(dst, '\\');
-                cbor_blob_append_byte(dst, 't');
+            }
+            if (json_sax_string(lexer, &scratch, &ptr, &length) != 0) {
+                r = -1;
                 break;
-            case '\\':
-                cbor_blob_append_byte(dst, '\\');
-                cbor_blob_append_byte(dst, '\\');
+            }
+            r = sax->key ? sax->key(userdata, ptr, length) : 0;
+            if (r != 0) {
                 break;
-            case '"':
-                cbor_blob_append_byte(dst, '\\');
-                cbor_blob_append_byte(dst, '"');
+            }
+            lexer_skip_whitespace(lexer);
+            if (lexer_peek(lexer, 0) != ':') {
+                lexer->last_error = JSON_ERR_UNEXPECTED_CHARACTER;
+                r = -1;
                 break;
-            case '\r':
-                cbor_blob_append_byte(dst, '\\');
-                cbor_blob_append_byte(dst, 'r');
+            }
+            lexer->cursor++;
+            state = JSON_SAX_VALUE;
+            continue;
+        }
+
+        if (leader == '{' || leader == '[') {
+            int close = leader == '{' ? '}' : ']';
+            if (json_depth_exceeded(lexer->flags, depth)) {
+                lexer->last_error = JSON_ERR_DEPTH;
+                r = -1;
                 break;
-            case '\f':
-                cbor_blob_append_byte(dst, '\\');
-                cbor_blob_append_byte(dst, 'f');
+            }
+            lexer->cursor++;
+            r = json_sax_event(leader == '{' ? sax->begin_object : sax->begin_array, userdata);
+            if (r != 0) {
                 break;
-            default: {
-                int codepoint = -1;
-                if ((unsigned char)ptr[i] <= 0x7F) {
-                    /* 0xxxxxxx */
-                    codepoint = (unsigned char)ptr[i];
-                } else if ((unsigned char)ptr[i] >= 0xC0
-                           && (unsigned char)ptr[i] <= 0xDF) {
-                    /* 110xxxxx 10xxxxxx */
-                    codepoint = (unsigned char)ptr[i] & 0x1F;
-                    codepoint <<= 6;
-                    if ((unsigned char)ptr[i + 1] >= 0x80
-                        && (unsigned char)ptr[i + 1] <= 0xBF) {
-                        codepoint |= (unsigned char)ptr[i + 1] & 0x3F;
-                    } else {
-                        codepoint = -1;
-                        fprintf(stderr, "dump utf-8 code point fail 0x%02x, offset %d", ptr[i + 1], i + 1);
-                    }
-                    i += 1;
-                } else if ((unsigned char)ptr[i] >= 0xE0
-                           && (unsigned char)ptr[i] <= 0xEF) {
-                    /* 1110xxxx 10xxxxxx 10xxxxxx */
-                    codepoint = (unsigned char)ptr[i] & 0xF;
-                    codepoint <<= 12;
-                    if ((unsigned char)ptr[i + 1] >= 0x80
-                        && (unsigned char)ptr[i + 1] <= 0xBF) {
-                        codepoint |= ((unsigned char)ptr[i + 1] & 0x3F) << 6;
-                        if ((unsigned char)ptr[i + 2] >= 0x80
-                            && (unsigned char)ptr[i + 2] <= 0xBF) {
-                            codepoint |= (unsigned char)ptr[i + 2] & 0x3F;
-                        } else {
-                            codepoint = -1;
-                            fprintf(stderr, "dump utf-8 code point fail 0x%02x, offset %d", ptr[i + 2], i + 2);
-                        }
-                    } else {
-                        codepoint = -1;
-                        fprintf(stderr, "dump utf-8 code point fail 0x%02x, offset %d", ptr[i + 1], i + 1);
+            }
+            lexer_skip_whitespace(lexer);
+            if (lexer_peek(lexer, 0) == close) {
+                lexer->cursor++;
+                r = json_sax_event(leader == '{' ? sax->end_object : sax->end_array, userdata);
+            } else {
+                if (depth == allocated) {
+                    char *tmp = (char *)malloc(allocated * 2);
+                    if (tmp == NULL) {
+                        r = -1;
+                        break;
                     }
-                    i += 2;
-                } else if ((unsigned char)ptr[i] >= 0xF0
-                           && (unsigned char)ptr[i] <= 0xF7) {
-                    /* 11110xxx 10xxxxxx 10xxxxxx 10xxxxxx */
-                    codepoint = (unsigned char)ptr[i] & 0x7;
-                    codepoint <<= 18;
-                    if ((unsigned char)ptr[i + 1] >= 0x80
-                        && (unsigned char)ptr[i + 1] <= 0xBF) {
-                        codepoint |= ((unsigned char)ptr[i + 1] & 0x3F) << 12;
-                        if ((unsigned char)ptr[i + 2] >= 0x80
-                            && (unsigned char)ptr[i + 2] <= 0xBF) {
-                            codepoint |= ((unsigned char)ptr[i + 2] & 0x3F) << 6;
-                            if ((unsigned char)ptr[i + 3] >= 0x80
-                                && (unsigned char)ptr[i + 3] <= 0xBF) {
-                                codepoint |= (unsigned char)ptr[i + 3] & 0x3F;
-                            } else {
-                                codepoint = -1;
-                                fprintf(stderr, "dump utf-8 code point fail 0x%02x, offset %d", ptr[i + 3], i + 3);
-                            }
-                        } else {
-                            codepoint = -1;
-                            fprintf(stderr, "dump utf-8 code point fail 0x%02x, offset %d", ptr[i + 2], i + 2);
-                        }
-                    } else {
-                        codepoint = -1;
-                        fprintf(stderr, "dump utf-8 code point fail 0x%02x, offset %d", ptr[i + 1], i + 1);
+                    memcpy(tmp, stack, depth);
+                    if (stack != inline_stack) {
+                        free(stack);
                     }
-                    i += 3;
+                    stack = tmp;
+                    allocated *= 2;
                 }
-                if (codepoint != -1) {
-                    if (codepoint <= 0x7F) {
-                        if (isprint(codepoint)) {
-                            cbor_blob_append_byte(dst, codepoint);
-                        } else {
-                            int len = snprintf(buffer, sizeof(buffer), "\\u%04x", codepoint);
-                            cbor_blob_append(dst, buffer, len);
-                        }
-                    } else if (codepoint <= 0xD7FF || (codepoint >= 0xE000 && codepoint <= 0xFFFF)) {
-                        int len = snprintf(buffer, sizeof(buffer), "\\u%04x", codepoint);
-                        cbor_blob_append(dst, buffer, len);
-                    } else if (codepoint <= 0x10FFFF) {
-                        codepoint -= 0x10000;
-                        int len = snprintf(buffer, sizeof(buffer), "\\u%04x", ((codepoint >> 10) & 0x3FF) | 0xD800);
-                        cbor_blob_append(dst, buffer, len);
-                        len = snprintf(buffer, sizeof(buffer), "\\u%04x", (codepoint & 0x3FF) | 0xDC00);
-                        cbor_blob_append(dst, buffer, len);
-                    } else {
-                        fprintf(stderr, "invalid codepoint: 0x%08x, offset %d", codepoint, i);
-                    }
-                } else {
-                    fprintf(stderr, "dump string character fail, offset %d", i);
+                stack[depth++] = (char)leader;
+                state = leader == '{' ? JSON_SAX_KEY : JSON_SAX_VALUE;
+                continue;
+            }
+        } else if (leader == '"') {
+            if (json_sax_string(lexer, &scratch, &ptr, &length) != 0) {
+                r = -1;
+                break;
+            }
+            r = sax->string ? sax->string(userdata, ptr, length) : 0;
+        } else {
+            if (json_lex_scalar(lexer, &scalar) != 0) {
+                r = -1;
+                break;
+            }
+            r = json_sax_scalar(sax, userdata, &scalar);
+        }
+        if (depth == 0) {
+            break;
+        }
+        state = JSON_SAX_NEXT;
+    }
+    if (stack != inline_stack) {
+        free(stack);
+    }
+    cbor_destroy(scratch);
+    return r;
+}
+
+int cbor_json_sax_parse(const void *src, int size, int flag, const cbor_json_sax_t *sax, void *userdata, int *consume) {
+    lexer_t lexer;
+    int r;
+    if (!src || !sax) {
+        return -1;
+    }
+    if (size < 0) {
+        size = strlen(src);
+    }
+    lexer_init(&lexer, src, size, flag);
+    r = json_sax_run(&lexer, sax, userdata);
+    lexer_release(&lexer, consume);
+    return r;
+}
+
+/* bytes json__skip_scan stops at, which also end a scalar */
+static const bool json_skip_stop[256] = {
+    ['"'] = true, ['#'] = true, ['/'] = true,
+    ['['] = true, [']'] = true, ['{'] = true, ['}'] = true,
+};
+
+static void json_cursor_lexer(lexer_t *lexer, const char *ptr, const char *end, int flag) {
+    memset(lexer, 0, sizeof(lexer_t));
+    lexer->flags = flag;
+    lexer->source = ptr;
+    lexer->cursor = ptr;
+    lexer->eof = end;
+}
+
+/* move past the value at the cursor without decoding it, only brackets and
+ * strings are tracked so skipped text is not otherwise validated */
+static int json_cursor_skip(lexer_t *lexer) {
+    size_t depth = 0;
+
+    lexer_skip_whitespace(lexer);
+    do {
+        int ch;
+        if (lexer->cursor >= lexer->eof) {
+            return -1;
+        }
+        ch = (unsigned char)*lexer->cursor;
+        if (ch == '"') {
+            bool escaped = false;
+            lexer->cursor = json_string_extent(lexer->cursor + 1, lexer->eof, &escaped);
+            if (lexer->cursor >= lexer->eof || *lexer->cursor != '"') {
+                return -1;
+            }
+            lexer->cursor++;
+        } else if (ch == '{' || ch == '[') {
+            depth++;
+            lexer->cursor++;
+        } else if (ch == '}' || ch == ']') {
+            if (depth == 0) {
+                return -1;
+            }
+            depth--;
+            lexer->cursor++;
+        } else if ((ch == '/' || ch == '#') && lexer->flags & JSON_PARSER_ALLOW_COMMENT) {
+            const char *at = lexer->cursor;
+            lexer_skip_whitespace(lexer);
+            if (lexer->cursor == at) {
+                lexer->cursor++;
+            }
+        } else if (depth == 0) {
+            /* a scalar ends at whitespace or the next token */
+            const char *start = lexer->cursor;
+            while (lexer->cursor < lexer->eof) {
+                ch = (unsigned char)*lexer->cursor;
+                if (json_space[ch] || json_skip_stop[ch] || ch == ',' || ch == ':') {
+                    break;
                 }
+                lexer->cursor++;
+            }
+            return lexer->cursor > start ? 0 : -1;
+        } else {
+            lexer->cursor = json__skip_scan(lexer->cursor + 1, lexer->eof);
+        }
+    } while (depth > 0);
+    return 0;
+}
+
+/* `"name" :` of an object member, the cursor ends on its value */
+static int json_cursor_member(lexer_t *lexer, cbor_json_cursor_t *child) {
+    bool escaped = false;
+    const char *close;
+
+    lexer_skip_whitespace(lexer);
+    if (lexer->cursor >= lexer->eof || *lexer->cursor != '"') {
+        return -1;
+    }
+    close = json_string_extent(lexer->cursor + 1, lexer->eof, &escaped);
+    if (close >= lexer->eof || *close != '"') {
+        return -1;
+    }
+    child->key = lexer->cursor;
+    lexer->cursor = close + 1;
+    lexer_skip_whitespace(lexer);
+    if (lexer->cursor >= lexer->eof || *lexer->cursor != ':') {
+        return -1;
+    }
+    lexer->cursor++;
+    lexer_skip_whitespace(lexer);
+    return lexer->cursor < lexer->eof ? 0 : -1;
+}
+
+int cbor_json_cursor_init(cbor_json_cursor_t *cur, const void *src, size_t size, int flag) {
+    lexer_t lexer;
+
+    if (cur == NULL || src == NULL) {
+        return -1;
+    }
+    json_cursor_lexer(&lexer, src, (const char *)src + size, flag);
+    lexer_skip_whitespace(&lexer);
+    cur->ptr = lexer.cursor;
+    cur->end = lexer.eof;
+    cur->key = NULL;
+    cur->flag = flag;
+    return lexer.cursor < lexer.eof ? 0 : -1;
+}
+
+int cbor_json_cursor_first(const cbor_json_cursor_t *cur, cbor_json_cursor_t *child) {
+    lexer_t lexer;
+    int open;
+
+    if (cur->ptr >= cur->end || (*cur->ptr != '{' && *cur->ptr != '[')) {
+        return -1;
+    }
+    open = *cur->ptr;
+    json_cursor_lexer(&lexer, cur->ptr + 1, cur->end, cur->flag);
+    lexer_skip_whitespace(&lexer);
+    if (lexer.cursor >= lexer.eof || *lexer.cursor == (open == '{' ? '}' : ']')) {
+        return -1;
+    }
+    *child = *cur;
+    child->key = NULL;
+    if (open == '{' && json_cursor_member(&lexer, child) != 0) {
+        return -1;
+    }
+    child->ptr = lexer.cursor;
+    return 0;
+}
+
+int cbor_json_cursor_next(cbor_json_cursor_t *cur) {
+    lexer_t lexer;
+
+    json_cursor_lexer(&lexer, cur->ptr, cur->end, cur->flag);
+    if (json_cursor_skip(&lexer) != 0) {
+        return -1;
+    }
+    lexer_skip_whitespace(&lexer);
+    if (lexer.cursor >= lexer.eof || *lexer.cursor != ',') {
+        return -1;
+    }
+    lexer.cursor++;
+    if (cur->key) {
+        if (json_cursor_member(&lexer, cur) != 0) {
+            return -1;
+        }
+    } else {
+        lexer_skip_whitespace(&lexer);
+    }
+    cur->ptr = lexer.cursor;
+    return 0;
+}
+
+static bool json_cursor_key_match(const cbor_json_cursor_t *cur, const char *tok, const char *end) {
+    bool escaped = false;
+    const char *close = json_string_extent(cur->key + 1, cur->end, &escaped);
+    cbor_value_t *key;
+    bool match;
+
+    if (!escaped) {
+        return cbor__pointer_token_match(tok, end, cur->key + 1, close - cur->key - 1) == end;
+    }
+    key = cbor_json_cursor_key(cur);
+    match = key && cbor__pointer_token_match(tok, end, key->blob.ptr, key->blob.length) == end;
+    cbor_destroy(key);
+    return match;
+}
+
+/* the element or member named by one reference token */
+static int json_cursor_child(const cbor_json_cursor_t *cur, const char *tok, const char *end, cbor_json_cursor_t *child) {
+    size_t idx = 0;
+    bool tail = (end - tok == 1 && *tok == '-');
+
+    if (cbor_json_cursor_first(cur, child) != 0) {
+        return -1;
+    }
+    if (*cur->ptr == '{') {
+        while (!json_cursor_key_match(child, tok, end)) {
+            if (cbor_json_cursor_next(child) != 0) {
+                return -1;
             }
+        }
+        return 0;
+    }
+    if (!tail) {
+        const char *ptr;
+        if (tok == end) {
+            return -1;
+        }
+        for (ptr = tok; ptr < end; ptr++) {
+            if (*ptr < '0' || *ptr > '9' || idx > (SIZE_MAX - 9) / 10) {
+                return -1;
             }
+            idx = idx * 10 + (*ptr - '0');
+        }
+    }
+    for (;;) {
+        cbor_json_cursor_t next;
+        if (!tail && idx-- == 0) {
+            return 0;
         }
+        next = *child;
+        if (cbor_json_cursor_next(&next) != 0) {
+            return tail ? 0 : -1;
+        }
+        *child = next;
+    }
+}
+
+int cbor_json_cursor_get(const cbor_json_cursor_t *cur, const char *path, cbor_json_cursor_t *out) {
+    cbor_json_cursor_t current, child;
+
+    if (cur == NULL || path == NULL || (path[0] != 0 && path[0] != '/')) {
+        return -1;
+    }
+    current = *cur;
+    while (*path == '/') {
+        const char *tok = path + 1;
+        const char *end = strchr(tok, '/');
+        if (end == NULL) {
+            end = tok + strlen(tok);
+        }
+        if (json_cursor_child(&current, tok, end, &child) != 0) {
+            return -1;
+        }
+        current = child;
+        path = end;
+    }
+    *out = current;
+    return 0;
+}
+
+cbor_value_t *cbor_json_cursor_key(const cbor_json_cursor_t *cur) {
+    lexer_t lexer;
+    cbor_value_t *key;
+
+    if (cur->key == NULL) {
+        return NULL;
+    }
+    json_cursor_lexer(&lexer, cur->key, cur->end, cur->flag);
+    key = json_parse_string(&lexer);
+    lexer_release(&lexer, NULL);
+    return key;
+}
+
+cbor_value_t *cbor_json_cursor_value(const cbor_json_cursor_t *cur) {
+    lexer_t lexer;
+    cbor_value_t *val;
+
+    json_cursor_lexer(&lexer, cur->ptr, cur->end, cur->flag);
+    if (json_cursor_skip(&lexer) != 0) {
+        return NULL;
+    }
+    /* the extent is known now, parse just that */
+    lexer_init(&lexer, cur->ptr, lexer.cursor - cur->ptr, cur->flag);
+    val = json_parse_value(&lexer);
+    lexer_release(&lexer, NULL);
+    return val;
+}
+
+cbor_value_t *cbor_json_loads(const void *src, int size) {
+    return cbor_json_loads_ex(src, size, 0, NULL);
+}
+
+/*
+ * Push parser: the input arrives in chunks of any size. A string, number or
+ * literal that straddles two chunks is collected in `buffer` and parsed by
+ * json_parse_value once complete, containers are kept on an explicit stack,
+ * so no state lives on the C stack between calls.
+ */
+typedef enum {
+    JSON_EXPECT_VALUE,
+    JSON_EXPECT_VALUE_OR_END,   /* after '[' */
+    JSON_EXPECT_KEY,
+    JSON_EXPECT_KEY_OR_END,     /* after '{' */
+    JSON_EXPECT_COLON,
+    JSON_EXPECT_NEXT,           /* ',' or the closing bracket */
+} json_expect;
+
+typedef enum {
+    JSON_TOKEN_NONE,
+    JSON_TOKEN_STRING,
+    JSON_TOKEN_SCALAR,          /* number or literal, ends at a delimiter */
+    JSON_TOKEN_SLASH,
+    JSON_TOKEN_LINE_COMMENT,
+    JSON_TOKEN_BLOCK_COMMENT,
+} json_token;
+
+struct _cbor_json_parser {
+    int flags;
+    lexer_error error;
+    json_expect expect;
+    json_token token;
+    bool escape;
+    int comment_depth;
+    int comment_prev;
+    cbor_value_t *buffer;
+    json_frame_t *stack;        /* stack[0] holds the root, which owns the rest */
+    size_t depth;
+    size_t allocated;
+    cbor_value_t *values;       /* completed top level values, oldest first */
+    size_t offset;              /* input bytes before the current chunk */
+};
+
+static bool json_is_delimiter(int ch) {
+    switch (ch) {
+    case ' ': case '\t': case '\n': case '\v': case '\f': case '\r':
+    case ',': case ':': case '[': case ']': case '{': case '}':
+    case '"': case '/': case '#':
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void json_push_fail(cbor_json_parser_t *parser, lexer_error error, size_t offset) {
+    parser->error = error;
+    if (parser->flags & JSON_PARSER_REPORT_ERROR) {
+        fprintf(stdout, "json lexer error at input offset %zu: %s\n", offset, json_err_str[error]);
+    }
+}
+
+static bool json_push_expects_value(const cbor_json_parser_t *parser) {
+    return parser->expect == JSON_EXPECT_VALUE || parser->expect == JSON_EXPECT_VALUE_OR_END;
+}
+
+/* put a complete value where the parser stands */
+static void json_push_value(cbor_json_parser_t *parser, cbor_value_t *val) {
+    json_frame_t *top;
+
+    if (parser->depth == 0) {
+        cbor_container_insert_tail(parser->values, val);
+        parser->expect = JSON_EXPECT_VALUE;
+        return;
+    }
+    top = &parser->stack[parser->depth - 1];
+    if (cbor_is_array(top->container)) {
+        cbor_container_insert_tail(top->container, val);
+        parser->expect = JSON_EXPECT_NEXT;
+    } else if (parser->expect == JSON_EXPECT_KEY || parser->expect == JSON_EXPECT_KEY_OR_END) {
+        top->key = val;
+        parser->expect = JSON_EXPECT_COLON;
+    } else {
+        cbor_container_insert_tail(top->container, cbor_init_pair(top->key, val));
+        top->key = NULL;
+        parser->expect = JSON_EXPECT_NEXT;
+    }
+}
+
+/* the token in [start, end), prefixed by whatever earlier chunks left in `buffer` */
+static void json_push_token(cbor_json_parser_t *parser, const char *start, const char *end, size_t offset) {
+    lexer_t lexer;
+    cbor_value_t *val;
+
+    if (parser->buffer->blob.length > 0) {
+        if (end > start) {
+            cbor_blob_append(parser->buffer, start, end - start);
+        }
+        start = cbor_string(parser->buffer);
+        end = start + parser->buffer->blob.length;
+    }
+    memset(&lexer, 0, sizeof(lexer));
+    lexer.flags = parser->flags;
+    lexer.source = start;
+    lexer.cursor = start;
+    lexer.eof = end;
+
+    val = json_parse_value(&lexer);
+    if (val && lexer.cursor != lexer.eof) {
+        cbor_destroy(val);
+        val = NULL;
+        lexer.last_error = JSON_ERR_UNEXPECTED_CHARACTER;
+    }
+    parser->buffer->blob.length = 0;
+    parser->token = JSON_TOKEN_NONE;
+    if (val == NULL) {
+        json_push_fail(parser, lexer.last_error ? lexer.last_error : JSON_ERR_UNEXPECTED_CHARACTER, offset);
+        return;
+    }
+    json_push_value(parser, val);
+}
+
+static int json_push_open(cbor_json_parser_t *parser, cbor_value_t *container) {
+    if (parser->depth == parser->allocated) {
+        size_t allocated = parser->allocated ? parser->allocated * 2 : 16;
+        json_frame_t *tmp = (json_frame_t *)realloc(parser->stack, sizeof(json_frame_t) * allocated);
+        if (tmp == NULL) {
+            cbor_destroy(container);
+            return -1;
+        }
+        parser->stack = tmp;
+        parser->allocated = allocated;
+    }
+    if (parser->depth > 0) {
+        json_push_value(parser, container);
+    }
+    parser->stack[parser->depth].container = container;
+    parser->stack[parser->depth].key = NULL;
+    parser->depth++;
+    parser->expect = cbor_is_map(container) ? JSON_EXPECT_KEY_OR_END : JSON_EXPECT_VALUE_OR_END;
+    return 0;
+}
+
+static int json_push_close(cbor_json_parser_t *parser, bool map) {
+    cbor_value_t *container;
+
+    if (parser->depth == 0) {
+        return -1;
+    }
+    container = parser->stack[parser->depth - 1].container;
+    if (cbor_is_map(container) != map
+        || !(parser->expect == JSON_EXPECT_NEXT
+             || parser->expect == (map ? JSON_EXPECT_KEY_OR_END : JSON_EXPECT_VALUE_OR_END))) {
+        return -1;
+    }
+    parser->depth--;
+    if (parser->depth == 0) {
+        cbor_container_insert_tail(parser->values, container);
+        parser->expect = JSON_EXPECT_VALUE;
+    } else {
+        parser->expect = JSON_EXPECT_NEXT;
+    }
+    return 0;
+}
+
+/* one byte outside of any token */
+static int json_push_structural(cbor_json_parser_t *parser, int ch) {
+    switch (ch) {
+    case ' ': case '\t': case '\n': case '\v': case '\f': case '\r':
+        return 0;
+    case '#':
+    case '/':
+        if (!(parser->flags & JSON_PARSER_ALLOW_COMMENT)) {
+            return -1;
+        }
+        parser->token = ch == '#' ? JSON_TOKEN_LINE_COMMENT : JSON_TOKEN_SLASH;
+        return 0;
+    case '{':
+    case '[':
+        if (!json_push_expects_value(parser)) {
+            return -1;
+        }
+        if (json_depth_exceeded(parser->flags, parser->depth)) {
+            parser->error = JSON_ERR_DEPTH;
+            return -1;
+        }
+        return json_push_open(parser, ch == '{' ? cbor_init_map() : cbor_init_array());
+    case '}':
+    case ']':
+        return json_push_close(parser, ch == '}');
+    case ',':
+        if (parser->depth == 0 || parser->expect != JSON_EXPECT_NEXT) {
+            return -1;
+        }
+        parser->expect = cbor_is_map(parser->stack[parser->depth - 1].container) ? JSON_EXPECT_KEY : JSON_EXPECT_VALUE;
+        return 0;
+    case ':':
+        if (parser->expect != JSON_EXPECT_COLON) {
+            return -1;
+        }
+        parser->expect = JSON_EXPECT_VALUE;
+        return 0;
+    case '"':
+        if (!json_push_expects_value(parser)
+            && parser->expect != JSON_EXPECT_KEY && parser->expect != JSON_EXPECT_KEY_OR_END) {
+            return -1;
+        }
+        parser->token = JSON_TOKEN_STRING;
+        parser->escape = false;
+        return 0;
+    default:
+        if (!json_push_expects_value(parser)) {
+            return -1;
+        }
+        parser->token = JSON_TOKEN_SCALAR;
+        return 0;
+    }
+}
+
+cbor_json_parser_t *cbor_json_parser_new(int flag) {
+    cbor_json_parser_t *parser = (cbor_json_parser_t *)calloc(1, sizeof(cbor_json_parser_t));
+    if (parser == NULL) {
+        return NULL;
+    }
+    parser->flags = flag;
+    parser->buffer = cbor_init_string("", 0);
+    parser->values = cbor_init_array();
+    return parser;
+}
+
+int cbor_json_parser_feed(cbor_json_parser_t *parser, const void *chunk, size_t size) {
+    const char *ptr = (const char *)chunk;
+    const char *end = ptr + size;
+    const char *start = ptr;    /* first byte of the token in progress */
+
+    if (parser->error != JSON_ERR_NONE) {
+        return -1;
+    }
+    while (ptr < end && parser->error == JSON_ERR_NONE) {
+        int ch;
+        switch (parser->token) {
+        case JSON_TOKEN_STRING:
+            if (parser->escape) {
+                parser->escape = false;
+                ptr++;
+                break;
+            }
+            ptr = json__string_scan(ptr, end);
+            if (ptr == end) {
+                break;
+            }
+            ch = (unsigned char)*ptr++;
+            if (ch == '\\') {
+                parser->escape = true;
+            } else if (ch == '"' || ch == '\n' || ch == '\r') {
+                /* a line break is reported by json_parse_string */
+                json_push_token(parser, start, ptr, parser->offset + (ptr - (const char *)chunk));
+            }
+            break;
+        case JSON_TOKEN_SCALAR:
+            while (ptr < end && !json_is_delimiter((unsigned char)*ptr)) {
+                ptr++;
+            }
+            if (ptr < end) {
+                json_push_token(parser, start, ptr, parser->offset + (ptr - (const char *)chunk));
+            }
+            break;
+        case JSON_TOKEN_SLASH:
+            ch = (unsigned char)*ptr++;
+            if (ch == '/') {
+                parser->token = JSON_TOKEN_LINE_COMMENT;
+            } else if (ch == '*') {
+                parser->token = JSON_TOKEN_BLOCK_COMMENT;
+                parser->comment_depth = 1;
+                parser->comment_prev = 0;
+            } else {
+                json_push_fail(parser, JSON_ERR_UNEXPECTED_CHARACTER, parser->offset + (ptr - (const char *)chunk));
+            }
+            break;
+        case JSON_TOKEN_LINE_COMMENT:
+            while (ptr < end && *ptr != '\n' && *ptr != '\r') {
+                ptr++;
+            }
+            if (ptr < end) {
+                parser->token = JSON_TOKEN_NONE;
+            }
+            break;
+        case JSON_TOKEN_BLOCK_COMMENT:
+            /* nested like lexer_skip_block_comment */
+            ch = (unsigned char)*ptr++;
+            if (parser->comment_prev == '*' && ch == '/') {
+                parser->comment_prev = 0;
+                if (--parser->comment_depth == 0) {
+                    parser->token = JSON_TOKEN_NONE;
+                }
+            } else if (parser->comment_prev == '/' && ch == '*') {
+                parser->comment_prev = 0;
+                parser->comment_depth++;
+            } else {
+                parser->comment_prev = ch;
+            }
+            break;
+        case JSON_TOKEN_NONE:
+            start = ptr;
+            if (json_push_structural(parser, (unsigned char)*ptr) != 0) {
+                json_push_fail(parser, parser->error != JSON_ERR_NONE ? parser->error : JSON_ERR_UNEXPECTED_CHARACTER,
+                               parser->offset + (ptr - (const char *)chunk));
+            }
+            if (parser->token != JSON_TOKEN_SCALAR) {
+                ptr++;
+            }
+            break;
+        }
+    }
+    if (parser->error == JSON_ERR_NONE
+        && (parser->token == JSON_TOKEN_STRING || parser->token == JSON_TOKEN_SCALAR) && end > start) {
+        cbor_blob_append(parser->buffer, start, end - start);
+    }
+    parser->offset += size;
+    return parser->error == JSON_ERR_NONE ? 0 : -1;
+}
+
+int cbor_json_parser_finish(cbor_json_parser_t *parser) {
+    if (parser->error != JSON_ERR_NONE) {
+        return -1;
+    }
+    if (parser->token == JSON_TOKEN_SCALAR) {
+        /* a top level number ends with the input */
+        json_push_token(parser, NULL, NULL, parser->offset);
+    } else if (parser->token == JSON_TOKEN_STRING) {
+        json_push_fail(parser, JSON_ERR_STRING_INFINITY, parser->offset);
+    } else if (parser->token == JSON_TOKEN_SLASH || parser->token == JSON_TOKEN_BLOCK_COMMENT) {
+        json_push_fail(parser, JSON_ERR_UNEXPECTED_CHARACTER, parser->offset);
+    }
+    /* also after a scalar that only the end of input completed, as in "[1, 2" */
+    if (parser->error == JSON_ERR_NONE && parser->depth > 0) {
+        json_push_fail(parser, JSON_ERR_UNEXPECTED_CHARACTER, parser->offset);
+    }
+    parser->token = JSON_TOKEN_NONE;
+    return parser->error == JSON_ERR_NONE ? 0 : -1;
+}
+
+cbor_value_t *cbor_json_parser_pop(cbor_json_parser_t *parser) {
+    return cbor_container_remove(parser->values, cbor_container_first(parser->values));
+}
+
+void cbor_json_parser_destroy(cbor_json_parser_t *parser) {
+    size_t i;
+
+    if (parser == NULL) {
+        return;
+    }
+    for (i = 0; i < parser->depth; i++) {
+        cbor_destroy(parser->stack[i].key);
+    }
+    if (parser->depth > 0) {
+        cbor_destroy(parser->stack[0].container);
+    }
+    free(parser->stack);
+    cbor_destroy(parser->buffer);
+    cbor_destroy(parser->values);
+    free(parser);
+}
+
+/* the whole CBOR range, down to -2^64, not just long long: `arg` is the head argument */
+static void json_dump_integer(cbor_value_t *dst, cbor_type type, uint64_t arg) {
+    char buffer[32];
+    int len;
+    if (type == CBOR_TYPE_UINT) {
+        len = snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long)arg);
+    } else if (arg == UINT64_MAX) {
+        len = snprintf(buffer, sizeof(buffer), "-18446744073709551616");
+    } else {
+        len = snprintf(buffer, sizeof(buffer), "-%llu", (unsigned long long)arg + 1);
+    }
+    cbor_blob_append(dst, buffer, len);
+}
+
+static void json_dump_real(cbor_value_t *dst, double real) {
+    char buffer[1024];
+    int len;
+    if (isinf(real) || isnan(real)) {
+        len = snprintf(buffer, sizeof(buffer), "%lf", .0);
+    } else {
+        len = snprintf(buffer, sizeof(buffer), "%lf", real);
+    }
+    cbor_blob_append(dst, buffer, len);
+}
+
+static void json_dump_indent(cbor_value_t *dst, int indent, const char *space, int length) {
+    int i;
+    for (i = 0; i < indent; i++) {
+        cbor_blob_append(dst, space, length);
+    }
+}
+
+static bool json_dump_plain(unsigned char ch) {
+    return ch >= 0x20 && ch < 0x7F && ch != '"' && ch != '\\';
+}
+
+/* code point of the well-formed sequence at `ptr`, `*size` gets its length */
+static int json_dump_codepoint(const unsigned char *ptr, int *size) {
+    if (ptr[0] < 0xE0) {
+        *size = 2;
+        return (ptr[0] & 0x1F) << 6 | (ptr[1] & 0x3F);
+    }
+    if (ptr[0] < 0xF0) {
+        *size = 3;
+        return (ptr[0] & 0x0F) << 12 | (ptr[1] & 0x3F) << 6 | (ptr[2] & 0x3F);
+    }
+    *size = 4;
+    return (ptr[0] & 0x07) << 18 | (ptr[1] & 0x3F) << 12 | (ptr[2] & 0x3F) << 6 | (ptr[3] & 0x3F);
+}
+
+/* string contents with JSON escapes, quotes excluded. The string is
+ * validated up front so well-formed sequences decode without checks,
+ * a byte of a malformed one becomes U+FFFD */
+static void json_dump_chars(cbor_value_t *dst, const char *ptr, int size) {
+    int i;
+    int valid = (int)cbor__utf8_check(ptr, size);
+    char buffer[16];
+    for (i = 0; i < size; i++) {
+        if (json_dump_plain((unsigned char)ptr[i])) {
+            int start = i;
+            while (i + 1 < size && json_dump_plain((unsigned char)ptr[i + 1])) {
+                i++;
+            }
+            cbor_blob_append(dst, ptr + start, i + 1 - start);
+            continue;
+        }
+        switch ((unsigned char)ptr[i]) {
+        case '\n':
+            cbor_blob_append_byte(dst, '\\');
+            cbor_blob_append_byte(dst, 'n');
+            break;
+        case '\t':
+            cbor_blob_append_byte(dst, '\\');
+            cbor_blob_append_byte(dst, 't');
+            break;
+        case '\\':
+            cbor_blob_append_byte(dst, '\\');
+            cbor_blob_append_byte(dst, '\\');
+            break;
+        case '"':
+            cbor_blob_append_byte(dst, '\\');
+            cbor_blob_append_byte(dst, '"');
+            break;
+        case '\r':
+            cbor_blob_append_byte(dst, '\\');
+            cbor_blob_append_byte(dst, 'r');
+            break;
+        case '\f':
+            cbor_blob_append_byte(dst, '\\');
+            cbor_blob_append_byte(dst, 'f');
+            break;
+        default: {
+            int codepoint;
+            int len;
+            if ((unsigned char)ptr[i] <= 0x7F) {
+                codepoint = (unsigned char)ptr[i];
+            } else if (i < valid) {
+                codepoint = json_dump_codepoint((const unsigned char *)ptr + i, &len);
+                i += len - 1;
+            } else {
+                codepoint = 0xFFFD;
+                valid = i + 1 + (int)cbor__utf8_check(ptr + i + 1, size - i - 1);
+            }
+            if (codepoint <= 0x7F && isprint(codepoint)) {
+                cbor_blob_append_byte(dst, codepoint);
+            } else if (codepoint <= 0xFFFF) {
+                len = snprintf(buffer, sizeof(buffer), "\\u%04x", codepoint);
+                cbor_blob_append(dst, buffer, len);
+            } else {
+                codepoint -= 0x10000;
+                len = snprintf(buffer, sizeof(buffer), "\\u%04x\\u%04x",
+                               ((codepoint >> 10) & 0x3FF) | 0xD800, (codepoint & 0x3FF) | 0xDC00);
+                cbor_blob_append(dst, buffer, len);
+            }
+        }
+        }
+    }
+}
+
+void json__dumps(const cbor_value_t *src, int indent, const char *space, int length, cbor_value_t *dst) {
+    cbor_value_t *val;
+    if (cbor_is_integer(src)) {
+        json_dump_integer(dst, src->type, src->uint);
+    } else if (cbor_is_string(src)) {
+        cbor_blob_append_byte(dst, '"');
+        json_dump_chars(dst, cbor_string(src), cbor_string_size(src));
         cbor_blob_append_byte(dst, '"');
     } else if (cbor_is_array(src)) {
         cbor_blob_append_byte(dst, '[');
@@ -878,9 +1777,7 @@ void json__dumps(const cbor_value_t *src, int indent, const char *space, int len
              val != NULL;
              val = cbor_container_next(src, val)) {
             if (space) {
-                for (i = 0; i < indent; i++) {
-                    cbor_blob_append(dst, space, length);
-                }
+                json_dump_indent(dst, indent, space, length);
             }
             json__dumps(val, indent, space, length, dst);
             if (cbor_container_next(src, val)) {
@@ -895,9 +1792,7 @@ void json__dumps(const cbor_value_t *src, int indent, const char *space, int len
         }
         indent--;
         if (space) {
-            for (i = 0; i < indent; i++) {
-                cbor_blob_append(dst, space, length);
-            }
+            json_dump_indent(dst, indent, space, length);
         }
         cbor_blob_append_byte(dst, ']');
     } else if (cbor_is_map(src)) {
@@ -910,9 +1805,7 @@ void json__dumps(const cbor_value_t *src, int indent, const char *space, int len
              val != NULL;
              val = cbor_container_next(src, val)) {
             if (space) {
-                for (i = 0; i < indent; i++) {
-                    cbor_blob_append(dst, space, length);
-                }
+                json_dump_indent(dst, indent, space, length);
             }
             json__dumps(cbor_pair_key(val), indent, space, length, dst);
             cbor_blob_append_byte(dst, ':');
@@ -930,19 +1823,11 @@ void json__dumps(const cbor_value_t *src, int indent, const char *space, int len
         }
         indent--;
         if (space) {
-            for (i = 0; i < indent; i++) {
-                cbor_blob_append(dst, space, length);
-            }
+            json_dump_indent(dst, indent, space, length);
         }
         cbor_blob_append_byte(dst, '}');
     } else if (cbor_is_double(src)) {
-        int len;
-        if (isinf(cbor_real(src)) || isnan(cbor_real(src))) {
-            len = snprintf(buffer, sizeof(buffer), "%lf", .0);
-        } else {
-            len = snprintf(buffer, sizeof(buffer), "%lf", cbor_real(src));
-        }
-        cbor_blob_append(dst, buffer, len);
+        json_dump_real(dst, cbor_real(src));
     } else if (cbor_is_null(src)) {
         cbor_blob_append(dst, "null", 4);
     } else if (cbor_is_boolean(src)) {
@@ -973,25 +1858,330 @@ char *cbor_json_dumps(const cbor_value_t *src, size_t *length, bool pretty) {
     return ptr;
 }
 
-cbor_value_t *cbor_json_loadf(const char *path) {
-    char *content;
-    size_t length;
-    cbor_value_t *val = NULL;
-    FILE *fp = fopen(path, "r");
-    if (fp) {
-        fseek(fp, 0, SEEK_END);
-        length = ftell(fp);
-        fseek(fp, 0, SEEK_SET);
-        content = (char *)malloc(length + 1);
-        if (length == fread(content, sizeof(char), length, fp)) {
-            content[length] = 0;
-            val = cbor_json_loads_ex(content, length, JSON_PARSER_ALLOW_COMMENT | JSON_PARSER_ALLOW_INF | JSON_PARSER_ALLOW_NAN | JSON_PARSER_REPORT_ERROR, NULL);
-            if (val == NULL) {
-                fprintf(stderr, "load json file %s failed\n", path);
+/* CBOR to JSON over encoded bytes: output goes through a text blob handed to
+ * the callback whenever it reaches JSON_TRANSCODE_BLOCK */
+#define JSON_TRANSCODE_BLOCK 16384
+
+typedef struct {
+    cbor_type type;
+    uint64_t remain;    /* keys and values count apart, CBOR__INDEFINITE until the break */
+    uint64_t written;
+} json_transcode_frame_t;
+
+typedef struct {
+    cbor_value_t *dst;
+    cbor_write_cb cb;
+    void *userdata;
+} json_transcode_out_t;
+
+static int json_transcode_flush(json_transcode_out_t *out, size_t threshold) {
+    if (out->cb && out->dst->blob.length > 0 && out->dst->blob.length >= threshold) {
+        int r = out->cb(out->userdata, out->dst->blob.ptr, out->dst->blob.length);
+        out->dst->blob.length = 0;
+        return r ? -1 : 0;
+    }
+    return 0;
+}
+
+/* a text string, chunk by chunk when it has indefinite length */
+static size_t json_transcode_string(const char *src, size_t length, size_t offset, uint8_t addition, uint64_t arg, cbor_value_t *dst) {
+    bool chunked = addition == 31;
+    cbor_type type;
+
+    cbor_blob_append_byte(dst, '"');
+    for (;;) {
+        if (chunked) {
+            if (offset < length && (unsigned char)src[offset] == 0xFF) {
+                offset++;
+                break;
+            }
+            offset = cbor__read_head(src, length, offset, &type, &addition, &arg);
+            if (offset == 0 || type != CBOR_TYPE_STRING || addition == 31) {
+                return 0;
+            }
+        }
+        if (arg > length - offset || arg > INT_MAX) {
+            return 0;
+        }
+        json_dump_chars(dst, src + offset, (int)arg);
+        offset += arg;
+        if (!chunked) {
+            break;
+        }
+    }
+    cbor_blob_append_byte(dst, '"');
+    return offset;
+}
+
+static int json_transcode(const char *src, size_t length, const char *space, int space_length, json_transcode_out_t *out) {
+    json_transcode_frame_t inline_stack[32];
+    json_transcode_frame_t *stack = inline_stack;
+    size_t depth = 0;
+    size_t allocated = sizeof(inline_stack) / sizeof(inline_stack[0]);
+    cbor_value_t *dst = out->dst;
+    size_t offset = 0;
+    int r = 0;
+
+    while (r == 0) {
+        size_t head;
+        cbor_type type;
+        uint8_t addition;
+        uint64_t arg;
+
+        r = json_transcode_flush(out, JSON_TRANSCODE_BLOCK);
+        if (r != 0) {
+            break;
+        }
+        if (depth > 0) {
+            json_transcode_frame_t *frame = &stack[depth - 1];
+            bool end;
+            if (frame->remain == CBOR__INDEFINITE) {
+                if (offset >= length) {
+                    r = -1;
+                    break;
+                }
+                end = (unsigned char)src[offset] == 0xFF;
+                if (end) {
+                    offset++;
+                }
+            } else {
+                end = frame->remain == 0;
+            }
+            if (end) {
+                if (frame->type == CBOR_TYPE_MAP && (frame->written & 1)) {
+                    /* a key without its value */
+                    r = -1;
+                    break;
+                }
+                if (space) {
+                    if (frame->written > 0) {
+                        cbor_blob_append_byte(dst, '\n');
+                    }
+                    json_dump_indent(dst, (int)depth - 1, space, space_length);
+                }
+                cbor_blob_append_byte(dst, frame->type == CBOR_TYPE_MAP ? '}' : ']');
+                if (--depth == 0) {
+                    break;
+                }
+                continue;
+            }
+            if (frame->type == CBOR_TYPE_MAP && (frame->written & 1)) {
+                cbor_blob_append(dst, ": ", 2);
+            } else {
+                if (frame->written > 0) {
+                    cbor_blob_append_byte(dst, ',');
+                    cbor_blob_append_byte(dst, space ? '\n' : ' ');
+                }
+                if (space) {
+                    json_dump_indent(dst, (int)depth, space, space_length);
+                }
+            }
+            frame->written++;
+            if (frame->remain != CBOR__INDEFINITE) {
+                frame->remain--;
+            }
+        }
+
+        head = offset;
+        offset = cbor__read_head(src, length, offset, &type, &addition, &arg);
+        if (offset == 0) {
+            r = -1;
+            break;
+        }
+        switch (type) {
+        case CBOR_TYPE_UINT:
+        case CBOR_TYPE_NEGINT:
+            if (addition == 31) {
+                r = -1;
+                break;
+            }
+            json_dump_integer(dst, type, arg);
+            break;
+        case CBOR_TYPE_STRING:
+            offset = json_transcode_string(src, length, offset, addition, arg, dst);
+            r = offset ? 0 : -1;
+            break;
+        case CBOR_TYPE_ARRAY:
+        case CBOR_TYPE_MAP: {
+            json_transcode_frame_t *frame;
+            /* every item takes at least one byte */
+            if (addition != 31 && (arg > length - offset || (type == CBOR_TYPE_MAP && arg * 2 > length - offset))) {
+                r = -1;
+                break;
+            }
+            if (depth == allocated) {
+                json_transcode_frame_t *tmp = (json_transcode_frame_t *)malloc(sizeof(json_transcode_frame_t) * allocated * 2);
+                if (tmp == NULL) {
+                    r = -1;
+                    break;
+                }
+                memcpy(tmp, stack, sizeof(json_transcode_frame_t) * depth);
+                if (stack != inline_stack) {
+                    free(stack);
+                }
+                stack = tmp;
+                allocated *= 2;
+            }
+            frame = &stack[depth++];
+            frame->type = type;
+            frame->remain = addition == 31 ? CBOR__INDEFINITE : (type == CBOR_TYPE_MAP ? arg * 2 : arg);
+            frame->written = 0;
+            cbor_blob_append_byte(dst, type == CBOR_TYPE_MAP ? '{' : '[');
+            if (space) {
+                cbor_blob_append_byte(dst, '\n');
+            }
+            continue;
+        }
+        case CBOR_TYPE_SIMPLE:
+            if (addition == CBOR_SIMPLE_FALSE) {
+                cbor_blob_append(dst, "false", 5);
+            } else if (addition == CBOR_SIMPLE_TRUE) {
+                cbor_blob_append(dst, "true", 4);
+            } else if (addition == CBOR_SIMPLE_NULL) {
+                cbor_blob_append(dst, "null", 4);
+            } else if (addition >= 25 && addition <= 27) {
+                json_dump_real(dst, cbor_raw_real(src, length, head));
+            } else {
+                r = -1;
             }
+            break;
+        default:
+            /* byte strings and tags have no JSON form */
+            r = -1;
+            break;
+        }
+        if (depth == 0) {
+            break;
+        }
+    }
+    if (stack != inline_stack) {
+        free(stack);
+    }
+    if (r == 0 && offset != length) {
+        /* bytes past the item */
+        r = -1;
+    }
+    if (r == 0) {
+        r = json_transcode_flush(out, 0);
+    }
+    return r;
+}
+
+char *cbor_json_transcode(const char *src, size_t length, size_t *size, bool pretty) {
+    json_transcode_out_t out;
+    char *ptr = NULL;
+
+    *size = 0;
+    if (src == NULL) {
+        return NULL;
+    }
+    memset(&out, 0, sizeof(out));
+    out.dst = cbor_init_string("", 0);
+    if (json_transcode(src, length, pretty ? "    " : NULL, 4, &out) == 0) {
+        *size = cbor_string_size(out.dst);
+        ptr = cbor_string_release(out.dst);
+    }
+    cbor_destroy(out.dst);
+    return ptr;
+}
+
+int cbor_json_transcode_cb(const char *src, size_t length, bool pretty, cbor_write_cb cb, void *userdata) {
+    json_transcode_out_t out;
+    int r;
+
+    if (src == NULL || cb == NULL) {
+        return -1;
+    }
+    out.dst = cbor_init_string("", 0);
+    out.cb = cb;
+    out.userdata = userdata;
+    r = json_transcode(src, length, pretty ? "    " : NULL, 4, &out);
+    cbor_destroy(out.dst);
+    return r;
+}
+
+/* the whole mapping is one value, only whitespace and comments may follow it */
+static cbor_value_t *json_loadf_whole(const cbor__file_t *file, int flag) {
+    lexer_t lexer;
+    cbor_value_t *val;
+
+    lexer_init(&lexer, file->ptr, file->length, flag);
+    val = json_parse_value(&lexer);
+    if (val) {
+        lexer_skip_whitespace(&lexer);
+        if (lexer.cursor != lexer.eof) {
+            lexer.last_error = JSON_ERR_UNEXPECTED_CHARACTER;
+            cbor_destroy(val);
+            val = NULL;
+        }
+    }
+    lexer_release(&lexer, NULL);
+    return val;
+}
+
+/* mappings past INT_MAX go through the push parser, as long NDJSON lines do */
+#define JSON_LOADF_CHUNK (1 << 24)
+
+static cbor_value_t *json_loadf_stream(const cbor__file_t *file, int flag) {
+    cbor_json_parser_t *parser = cbor_json_parser_new(flag);
+    cbor_value_t *val = NULL, *extra;
+    size_t offset;
+
+    if (parser == NULL) {
+        return NULL;
+    }
+    for (offset = 0; offset < file->length; offset += JSON_LOADF_CHUNK) {
+        size_t size = file->length - offset < JSON_LOADF_CHUNK ? file->length - offset : JSON_LOADF_CHUNK;
+        if (cbor_json_parser_feed(parser, file->ptr + offset, size) != 0) {
+            break;
+        }
+    }
+    if (offset >= file->length && cbor_json_parser_finish(parser) == 0) {
+        val = cbor_json_parser_pop(parser);
+        if ((extra = cbor_json_parser_pop(parser)) != NULL) {
+            cbor_destroy(extra);
+            cbor_destroy(val);
+            val = NULL;
+        }
+    }
+    cbor_json_parser_destroy(parser);
+    return val;
+}
+
+cbor_value_t *cbor_json_loadf_ex(const char *path, int flag, int *error) {
+    cbor__file_t file;
+    cbor_value_t *val;
+
+    if (error) {
+        *error = 0;
+    }
+    if (path == NULL) {
+        errno = EINVAL;
+    }
+    if (path == NULL || cbor__file_map(&file, path) != 0) {
+        if (error) {
+            /* an empty file reads fine, it just holds no value */
+            *error = errno ? JSON_LOADF_IO_ERROR : JSON_LOADF_PARSE_ERROR;
         }
-        free(content);
-        fclose(fp);
+        return NULL;
+    }
+    if (file.length <= INT_MAX) {
+        val = json_loadf_whole(&file, flag);
+    } else {
+        val = json_loadf_stream(&file, flag);
+    }
+    cbor__file_unmap(&file);
+    if (val == NULL && error) {
+        *error = JSON_LOADF_PARSE_ERROR;
+    }
+    return val;
+}
+
+cbor_value_t *cbor_json_loadf(const char *path) {
+    int error;
+    cbor_value_t *val = cbor_json_loadf_ex(path, JSON_PARSER_ALLOW_COMMENT | JSON_PARSER_ALLOW_INF | JSON_PARSER_ALLOW_NAN | JSON_PARSER_REPORT_ERROR, &error);
+    if (error == JSON_LOADF_PARSE_ERROR) {
+        fprintf(stderr, "load json file %s failed\n", path);
     }
     return val;
 }
@@ -1003,13 +2193,15 @@ int cbor_json_dumpf(cbor_value_t *val, const char *path, bool pretty) {
     char *content = cbor_json_dumps(val, &length, pretty);
     if (content && length) {
         fp = fopen(path, "w");
-        if (length != fwrite(content, sizeof(char), length, fp)) {
+        if (fp == NULL || length != fwrite(content, sizeof(char), length, fp)) {
             r = -1;
         } else {
             r = 0;
         }
-        fclose(fp);
-        free(content);
+        if (fp) {
+            fclose(fp);
+        }
     }
+    free(content);
     return r;
 }
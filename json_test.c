@@ -0,0 +1,578 @@
+#include "test.h"
+#include <math.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#include "define.h"
+
+static uint32_t seed = 1;
+
+static uint32_t next_random(void) {
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 16) & 0x7FFF;
+}
+
+/* token starts one byte at a time: structurals, opening quotes and the
+ * first byte of each scalar, nothing inside strings */
+static size_t index_oracle(const char *src, size_t length, size_t *offsets) {
+    bool string = false, escape = false, scalar = false;
+    size_t i, count = 0;
+
+    for (i = 0; i < length; i++) {
+        int ch = (unsigned char)src[i];
+        bool escaped = escape;
+        bool quote = ch == '"' && !escaped;
+
+        escape = ch == '\\' && !escaped;
+        if (string) {
+            string = !quote;
+            scalar = false;
+        } else if (quote || (ch && strchr("{}[]:,", ch))) {
+            offsets[count++] = i;
+            string = quote;
+            scalar = false;
+        } else if (ch == ' ' || (ch >= '\t' && ch <= '\r')) {
+            scalar = false;
+        } else {
+            if (!scalar) {
+                offsets[count++] = i;
+            }
+            scalar = true;
+        }
+    }
+    return count;
+}
+
+/* the windows of the stage 1 index, joined, against the oracle */
+static void index_test(const char *name, const char *src, size_t length) {
+    size_t *expect = (size_t *)malloc(sizeof(size_t) * (length + 1));
+    size_t count = index_oracle(src, length, expect), found = 0, i;
+    json__index_t index;
+    bool same = json__index_init(&index, src, length) == 0;
+    char content[64];
+
+    while (same && json__index_next(&index) == 0) {
+        for (i = 0; i < index.count; i++, found++) {
+            if (found >= count || index.base + index.offsets[i] != expect[found]) {
+                same = false;
+                break;
+            }
+        }
+    }
+    json__index_release(&index);
+    snprintf(content, sizeof(content), "%zu of %zu token starts", found, count);
+    report(same && found == count, name, content);
+    free(expect);
+}
+
+/* random bytes drawn from the characters the index classifies */
+static void index_random_test(size_t length) {
+    static const char alphabet[] = "{}[]:,\"\\ \t\n\r0123456789.-+eEtrufalsn\x80\xff";
+    char *src = (char *)malloc(length + 1);
+    char name[64];
+    size_t i;
+
+    for (i = 0; i < length; i++) {
+        src[i] = alphabet[next_random() % (sizeof(alphabet) - 1)];
+    }
+    src[length] = 0;
+    snprintf(name, sizeof(name), "json__index %zu random bytes", length);
+    index_test(name, src, length);
+    free(src);
+}
+
+/* the same text parsed with and without comments allowed: same tree, same
+ * consumed length, same success */
+static void loads_diff_test(const char *src, size_t length, const char *name) {
+    int consume = -1, consume_comment = -1;
+    cbor_value_t *a = cbor_json_loads_ex(src, (int)length, 0, &consume);
+    cbor_value_t *b = cbor_json_loads_ex(src, (int)length, JSON_PARSER_ALLOW_COMMENT, &consume_comment);
+    size_t size_a = 0, size_b = 0;
+    char *raw_a = a ? cbor_dumps(a, &size_a) : NULL;
+    char *raw_b = b ? cbor_dumps(b, &size_b) : NULL;
+    char content[64];
+
+    snprintf(content, sizeof(content), "%s/%s, consumed %d/%d", a ? "ok" : "error", b ? "ok" : "error",
+             consume, consume_comment);
+    report((a != NULL) == (b != NULL) && consume == consume_comment && size_a == size_b
+           && (!raw_a || !memcmp(raw_a, raw_b, size_a)), name, content);
+    free(raw_a);
+    free(raw_b);
+    cbor_destroy(a);
+    cbor_destroy(b);
+}
+
+static void append(char *buf, size_t *length, const char *str) {
+    size_t n = strlen(str);
+    memcpy(buf + *length, str, n);
+    *length += n;
+}
+
+/* pretty printed records with escapes, then each copy mutated in a few bytes */
+static void loads_random_test(int records, int mutations) {
+    static const char noise[] = "{}[]:,\"\\ \n0123456789.-etrufalsn";
+    size_t capacity = (size_t)records * 160 + 16, length = 0, i;
+    char *doc = (char *)malloc(capacity), *copy = (char *)malloc(capacity);
+    char name[64], line[160];
+    int r;
+
+    append(doc, &length, "[\n");
+    for (r = 0; r < records; r++) {
+        snprintf(line, sizeof(line),
+                 "  {\n    \"id\": %d,\n    \"name\": \"user\\\"%d\\\\\",\n    \"score\": %d.%de-%d,\n"
+                 "    \"tags\": [true, false, null],\n    \"nested\": {\"x\": -%d}\n  }%s\n",
+                 r, r, r, r % 10, r % 5, r * 3, r + 1 < records ? "," : "");
+        append(doc, &length, line);
+    }
+    append(doc, &length, "]\n");
+    snprintf(name, sizeof(name), "cbor_json_loads_ex %d records", records);
+    loads_diff_test(doc, length, name);
+    index_test(name, doc, length);
+
+    for (r = 0; r < mutations; r++) {
+        memcpy(copy, doc, length);
+        for (i = 0; i <= (size_t)r % 3; i++) {
+            copy[next_random() * 7919 % length] = noise[next_random() % (sizeof(noise) - 1)];
+        }
+        snprintf(name, sizeof(name), "mutation %d of %d records", r, records);
+        loads_diff_test(copy, length, name);
+    }
+    free(copy);
+    free(doc);
+}
+
+/* the JSON string `input` parses to the `size` bytes of `output`, NULL for an error */
+static void string_test(const char *input, const char *output, size_t size) {
+    cbor_value_t *val = cbor_json_loads_ex(input, -1, 0, NULL);
+    bool ok = output ? val && cbor_is_string(val) && (size_t)cbor_string_size(val) == size
+                       && !memcmp(cbor_string(val), output, size)
+                     : val == NULL;
+    report(ok, input, val && cbor_is_string(val) ? cbor_string(val) : "");
+    cbor_destroy(val);
+}
+
+#define STRING_TEST(input, output) string_test(input, output, sizeof(output) - 1)
+
+/* a run of `length` plain bytes with an escape or the closing quote right after */
+static void string_run_test(size_t length) {
+    char *input = (char *)malloc(length + 8), *output = (char *)malloc(length + 2);
+    char name[64];
+    cbor_value_t *val;
+
+    input[0] = '"';
+    memset(input + 1, 'a', length);
+    memset(output, 'a', length);
+    memcpy(input + 1 + length, "\\\\b\"", 5);
+    memcpy(output + length, "\\b", 2);
+    val = cbor_json_loads_ex(input, -1, 0, NULL);
+    snprintf(name, sizeof(name), "%zu bytes before an escape", length);
+    report(val && (size_t)cbor_string_size(val) == length + 2 && !memcmp(cbor_string(val), output, length + 2),
+           name, "");
+    cbor_destroy(val);
+
+    input[1 + length] = '"';
+    input[2 + length] = '\0';
+    val = cbor_json_loads_ex(input, -1, 0, NULL);
+    snprintf(name, sizeof(name), "%zu bytes before the quote", length);
+    report(val && (size_t)cbor_string_size(val) == length && !memcmp(cbor_string(val), output, length), name, "");
+    cbor_destroy(val);
+
+    input[1 + length] = '\0';
+    val = cbor_json_loads_ex(input, -1, 0, NULL);
+    snprintf(name, sizeof(name), "%zu bytes unterminated", length);
+    report(val == NULL, name, "");
+    cbor_destroy(val);
+    free(input);
+    free(output);
+}
+
+/* json__space_scan stops at the first byte after a run of `length` blanks
+ * starting `align` bytes into the buffer, whatever that byte is */
+static void space_scan_test(size_t align, size_t length) {
+    static const char blanks[] = " \t\n\v\f\r";
+    static const char stops[] = "x\x08\x0e\x1f!\x80\xa0\xff\x89\x8b\x00";
+    char buf[256 + 64];
+    char name[64];
+    size_t i, j;
+    bool ok = true;
+
+    for (j = 0; j < sizeof(stops) && ok; j++) {
+        for (i = 0; i < length; i++) {
+            buf[align + i] = blanks[next_random() % (sizeof(blanks) - 1)];
+        }
+        buf[align + length] = stops[j];
+        memset(buf + align + length + 1, ' ', 32);
+        ok = json__space_scan(buf + align, buf + align + length + 33) == buf + align + length;
+    }
+    /* a run up to the end of the input stops there */
+    ok = ok && json__space_scan(buf + align, buf + align + length) == buf + align + length;
+    snprintf(name, sizeof(name), "json__space_scan %zu blanks at %zu", length, align);
+    report(ok, name, ok ? "" : stops + j - 1);
+}
+
+/* compact JSON without blanks in its strings, reindented with `indent` per
+ * level and `eol` line ends, parses to the same tree */
+static void indent_test(const char *name, const char *input, const char *indent, const char *eol) {
+    size_t capacity = strlen(input) * (strlen(indent) * 8 + strlen(eol) + 2) + 1, length = 0;
+    char *pretty = (char *)malloc(capacity);
+    cbor_value_t *a = cbor_json_loads(input, -1), *b;
+    size_t size_a = 0, size_b = 0;
+    char *raw_a, *raw_b;
+    const char *ptr;
+    int depth = 0, i;
+
+    for (ptr = input; *ptr; ptr++) {
+        bool open = *ptr == '[' || *ptr == '{', close = *ptr == ']' || *ptr == '}';
+        if (close) {
+            depth--;
+            append(pretty, &length, eol);
+            for (i = 0; i < depth; i++) {
+                append(pretty, &length, indent);
+            }
+        }
+        if (*ptr != ' ') {
+            pretty[length++] = *ptr;
+        }
+        if (open || *ptr == ',') {
+            depth += open;
+            append(pretty, &length, eol);
+            for (i = 0; i < depth; i++) {
+                append(pretty, &length, indent);
+            }
+        } else if (*ptr == ':') {
+            append(pretty, &length, indent);
+        }
+    }
+    pretty[length] = '\0';
+    b = cbor_json_loads_ex(pretty, (int)length, 0, NULL);
+    raw_a = a ? cbor_dumps(a, &size_a) : NULL;
+    raw_b = b ? cbor_dumps(b, &size_b) : NULL;
+    report(raw_a && raw_b && size_a == size_b && !memcmp(raw_a, raw_b, size_a), name, b ? "same" : "failed");
+    free(raw_a);
+    free(raw_b);
+    cbor_destroy(a);
+    cbor_destroy(b);
+    free(pretty);
+}
+
+#ifndef _WIN32
+/* the first line JSON_PARSER_REPORT_ERROR prints for `input` */
+static void error_line_test(const char *input, const char *output) {
+    char line[128] = "", *end;
+    FILE *fp = tmpfile();
+    int saved;
+    cbor_value_t *val;
+
+    fflush(stdout);
+    saved = dup(fileno(stdout));
+    dup2(fileno(fp), fileno(stdout));
+    val = cbor_json_loads_ex(input, -1, JSON_PARSER_REPORT_ERROR, NULL);
+    fflush(stdout);
+    dup2(saved, fileno(stdout));
+    close(saved);
+    rewind(fp);
+    if (fgets(line, sizeof(line), fp) && (end = strchr(line, '\n')) != NULL) {
+        *end = '\0';
+    }
+    fclose(fp);
+    report(val == NULL && !strcmp(line, output), output, line);
+    cbor_destroy(val);
+}
+#endif
+
+/* Table 3-7 of the Unicode standard, byte by byte: offset of the first
+ * malformed sequence */
+static size_t utf8_oracle(const unsigned char *ptr, size_t length) {
+    size_t i = 0;
+
+    while (i < length) {
+        unsigned char ch = ptr[i];
+        unsigned char lo = 0x80, hi = 0xBF;
+        size_t need = 0, j;
+
+        if (ch <= 0x7F) {
+            i++;
+            continue;
+        } else if (ch >= 0xC2 && ch <= 0xDF) {
+            need = 1;
+        } else if (ch == 0xE0) {
+            need = 2, lo = 0xA0;
+        } else if (ch == 0xED) {
+            need = 2, hi = 0x9F;
+        } else if (ch >= 0xE1 && ch <= 0xEF) {
+            need = 2;
+        } else if (ch == 0xF0) {
+            need = 3, lo = 0x90;
+        } else if (ch == 0xF4) {
+            need = 3, hi = 0x8F;
+        } else if (ch >= 0xF1 && ch <= 0xF3) {
+            need = 3;
+        } else {
+            return i;
+        }
+        for (j = 1; j <= need; j++) {
+            unsigned char next = i + j < length ? ptr[i + j] : 0;
+            if (j == 1 ? next < lo || next > hi : (next & 0xC0) != 0x80) {
+                return i;
+            }
+        }
+        i += need + 1;
+    }
+    return length;
+}
+
+/* cbor__utf8_check finds the malformed sequence the oracle finds */
+static void utf8_check_test(const char *name, const char *ptr, size_t length) {
+    size_t expect = utf8_oracle((const unsigned char *)ptr, length);
+    size_t found = cbor__utf8_check(ptr, length);
+    char content[64];
+
+    snprintf(content, sizeof(content), "%zu, expected %zu", found, expect);
+    report(found == expect, name, content);
+}
+
+#define UTF8_TEST(input) utf8_check_test(#input, input, sizeof(input) - 1)
+
+/* `input` placed at every offset of a run of ASCII and of a run of 3 byte
+ * characters, around the 16, 32 and 64 byte block boundaries */
+static void utf8_offset_test(const char *input) {
+    size_t size = strlen(input), at, length;
+    char buf[160], name[64];
+    bool ok = true;
+    int fill;
+
+    for (fill = 0; fill < 2 && ok; fill++) {
+        for (at = 0; at < 100 && ok; at++) {
+            for (length = 0; length < at; length++) {
+                buf[length] = fill ? "\xe4\xb8\xad"[length % 3] : 'a';
+            }
+            /* a 3 byte character cut off by the insert is a fault of its own */
+            memcpy(buf + at, input, size);
+            memset(buf + at + size, 'b', 40);
+            length = at + size + (at % 41);
+            ok = utf8_oracle((const unsigned char *)buf, length) == cbor__utf8_check(buf, length);
+        }
+    }
+    snprintf(name, sizeof(name), "%s at offsets 0 to 99", input);
+    report(ok, name, ok ? "" : "mismatch");
+}
+
+/* random well formed characters of every width with a byte now and then
+ * replaced by one from the alphabet of troublemakers */
+static void utf8_random_test(size_t count, int faults) {
+    static const char *chars[] = {"a", "\x7f", "\xc2\x80", "\xdf\xbf", "\xe0\xa0\x80", "\xed\x9f\xbf",
+                                  "\xee\x80\x80", "\xef\xbf\xbf", "\xf0\x90\x80\x80", "\xf4\x8f\xbf\xbf"};
+    static const char noise[] = "\x80\xbf\xc0\xc1\xc2\xe0\xed\xf0\xf4\xf5\xff\x00a";
+    char *buf = (char *)malloc(count * 4 + 1), name[64];
+    size_t length = 0, i;
+    int f;
+
+    for (i = 0; i < count; i++) {
+        const char *ch = chars[next_random() % (sizeof(chars) / sizeof(chars[0]))];
+        memcpy(buf + length, ch, strlen(ch));
+        length += strlen(ch);
+    }
+    for (f = 0; f < faults; f++) {
+        buf[next_random() * 7919 % length] = noise[next_random() % (sizeof(noise) - 1)];
+    }
+    snprintf(name, sizeof(name), "%zu random characters, %d faults", count, faults);
+    utf8_check_test(name, buf, length);
+    free(buf);
+}
+
+/* every parser rejects the raw bytes of `input` in a JSON string when
+ * validating and keeps them otherwise */
+static void utf8_json_test(const char *input, bool valid) {
+    char value[128], member[128];
+    cbor_value_t *loose, *strict, *key, *pushed = NULL;
+    cbor_json_parser_t *parser = cbor_json_parser_new(JSON_PARSER_VALIDATE_UTF8);
+    cbor_json_sax_t sax;
+    char content[32];
+    int sax_result;
+
+    snprintf(value, sizeof(value), "[\"x%s\", \"\\n%s\"]", input, input);
+    snprintf(member, sizeof(member), "{\"%s\": 1}", input);
+    loose = cbor_json_loads_ex(value, -1, 0, NULL);
+    strict = cbor_json_loads_ex(value, -1, JSON_PARSER_VALIDATE_UTF8, NULL);
+    key = cbor_json_loads_ex(member, -1, JSON_PARSER_VALIDATE_UTF8, NULL);
+    if (cbor_json_parser_feed(parser, value, strlen(value)) == 0 && cbor_json_parser_finish(parser) == 0) {
+        pushed = cbor_json_parser_pop(parser);
+    }
+    cbor_json_parser_destroy(parser);
+    memset(&sax, 0, sizeof(sax));
+    sax_result = cbor_json_sax_parse(member, -1, JSON_PARSER_VALIDATE_UTF8, &sax, NULL, NULL);
+
+    snprintf(content, sizeof(content), "%d%d%d%d%d", loose != NULL, strict != NULL, key != NULL, pushed != NULL,
+             sax_result == 0);
+    report(!strcmp(content, valid ? "11111" : "10000"), input, content);
+    cbor_destroy(loose);
+    cbor_destroy(strict);
+    cbor_destroy(key);
+    cbor_destroy(pushed);
+}
+
+/* CBOR_LOADS_VALIDATE_UTF8 checks text strings, each chunk of an
+ * indefinite one on its own, and leaves byte strings alone */
+static void utf8_cbor_test(const char *input, bool valid) {
+    size_t size = strlen(input), length;
+    char raw[64], content[32];
+    cbor_value_t *loose, *strict, *chunked, *bytes;
+
+    raw[0] = (char)(0x60 | size);
+    memcpy(raw + 1, input, size);
+    length = size + 1;
+    loose = cbor_loads(raw, &length);
+    length = size + 1;
+    strict = cbor_loads_ex(raw, &length, CBOR_LOADS_VALIDATE_UTF8);
+    raw[0] = 0x7F;
+    raw[1] = (char)(0x60 | size);
+    memcpy(raw + 2, input, size);
+    raw[size + 2] = 0x61;
+    raw[size + 3] = 'a';
+    raw[size + 4] = (char)0xFF;
+    length = size + 5;
+    chunked = cbor_loads_ex(raw, &length, CBOR_LOADS_VALIDATE_UTF8);
+    raw[0] = (char)(0x40 | size);
+    memcpy(raw + 1, input, size);
+    length = size + 1;
+    bytes = cbor_loads_ex(raw, &length, CBOR_LOADS_VALIDATE_UTF8);
+
+    snprintf(content, sizeof(content), "%d%d%d%d", loose != NULL, strict != NULL, chunked != NULL, bytes != NULL);
+    report(!strcmp(content, valid ? "1111" : "1001"), input, content);
+    cbor_destroy(loose);
+    cbor_destroy(strict);
+    cbor_destroy(chunked);
+    cbor_destroy(bytes);
+}
+
+/* the JSON number `input` read back through cbor_integer and cbor_real */
+static void number_test(const char *input, bool integer, long long expect_integer, double expect_real) {
+    cbor_value_t *val = cbor_json_loads_ex(input, -1, 0, NULL);
+    long long i = cbor_integer(val);
+    double d = cbor_real(val);
+    char content[96];
+
+    snprintf(content, sizeof(content), "%s %lld, %.17g", cbor_is_integer(val) ? "integer" : "real", i, d);
+    report(val && cbor_is_integer(val) == integer && i == expect_integer
+           && d == expect_real && signbit(d) == signbit(expect_real), input, content);
+    cbor_destroy(val);
+}
+
+int main(int argc, char **argv) {
+    const char *sample = JSON({"a": "x\"y\\", "b": [1, -2.5e3, true], "c\\\\": null});
+    const char *escapes = "\"\\\\\\\"\" x\\\"y \"\\\\\"z";
+    size_t i;
+
+    index_test("json__index sample", sample, strlen(sample));
+    index_test("json__index escaped quotes", escapes, strlen(escapes));
+    index_random_test(63);
+    index_random_test(64);
+    index_random_test(1000);
+    index_random_test(JSON_INDEX_WINDOW * 2 + 17);
+    STRING_TEST(JSON(""), "");
+    STRING_TEST(JSON("plain"), "plain");
+    STRING_TEST(JSON("\"\\\/\b\f\n\r\t"), "\"\\/\b\f\n\r\t");
+    STRING_TEST(JSON("a\u00e9b\u4e2d"), "a\xc3\xa9" "b\xe4\xb8\xad");
+    STRING_TEST(JSON("\ud83d\ude00"), "\xf0\x9f\x98\x80");
+    STRING_TEST(JSON("\q"), "\\q");
+    STRING_TEST("\"tab\there\"", "tab\there");
+    string_test(JSON("\ud83d\u0041"), NULL, 0);
+    string_test(JSON("\u12"), NULL, 0);
+    string_test("\"line\nbreak\"", NULL, 0);
+    string_test("\"open", NULL, 0);
+    string_test("\"open\\\"", NULL, 0);
+    string_run_test(0);
+    string_run_test(15);
+    string_run_test(16);
+    string_run_test(31);
+    string_run_test(32);
+    string_run_test(63);
+    string_run_test(64);
+    string_run_test(1000);
+    number_test("0", true, 0, 0.0);
+    number_test("-1", true, -1, -1.0);
+    number_test("-0", true, 0, 0.0);
+    number_test("9223372036854775807", true, LLONG_MAX, 9223372036854775807.0);
+    number_test("9223372036854775808", true, LLONG_MAX, 9223372036854775808.0);
+    number_test("18446744073709551615", true, LLONG_MAX, 18446744073709551615.0);
+    number_test("-9223372036854775808", true, LLONG_MIN, -9223372036854775808.0);
+    number_test("-9223372036854775809", true, LLONG_MIN, -9223372036854775809.0);
+    number_test("-18446744073709551616", false, LLONG_MIN, -18446744073709551616.0);
+    number_test("18446744073709551616", false, LLONG_MAX, 18446744073709551616.0);
+    number_test("-18446744073709551617", false, LLONG_MIN, -18446744073709551617.0);
+    number_test("1e300", false, LLONG_MAX, 1e300);
+    number_test("-1e300", false, LLONG_MIN, -1e300);
+    number_test("-2.5", false, -2, -2.5);
+    number_test("0.1", false, 0, 0.1);
+    number_test("3.141592653589793", false, 3, 3.141592653589793);
+    number_test("123456789012345678901234567890", false, LLONG_MAX, 123456789012345678901234567890.0);
+    number_test("2.2250738585072014e-308", false, 0, 2.2250738585072014e-308);
+    number_test("4.9406564584124654e-324", false, 0, 4.9406564584124654e-324);
+    number_test("1.7976931348623157e308", false, LLONG_MAX, 1.7976931348623157e308);
+    number_test("1e-400", false, 0, 0.0);
+    number_test("0.30000000000000004", false, 0, 0.30000000000000004);
+    number_test("9007199254740993e0", false, 9007199254740992LL, 9007199254740992.0);
+    for (i = 0; i < 70; i++) {
+        space_scan_test(i % 32, i);
+        space_scan_test(0, i + 70);
+        space_scan_test(31 - i % 32, i * 3);
+    }
+    indent_test("1 space, LF", sample, " ", "\n");
+    indent_test("tab, CRLF", sample, "\t", "\r\n");
+    indent_test("16 spaces, LF", sample, "                ", "\n");
+    indent_test("mixed blanks, CR", sample, "\t \t  \t   \t    \t\v\f", "\r");
+    indent_test("39 spaces, blank lines", JSON([[[[[[[[1, 2]]]]]]]]), "                                       ", "\n\n");
+#ifndef _WIN32
+    error_line_test("[1, 2,]", "json lexer error at line 1, offset 6");
+    error_line_test("[\n  1,\n  x\n]", "json lexer error at line 3, offset 2");
+    error_line_test("[\r\n  1,\r\n\r\n    x]", "json lexer error at line 4, offset 4");
+    error_line_test("[\r1,\r\r  x]", "json lexer error at line 4, offset 2");
+    error_line_test("{\"a\":\n\n\n\n                                        \"b\" 1}",
+                    "json lexer error at line 5, offset 44");
+#endif
+    UTF8_TEST("");
+    UTF8_TEST("plain ascii");
+    UTF8_TEST("\xc2\x80\xdf\xbf\xe0\xa0\x80\xed\x9f\xbf\xee\x80\x80\xef\xbf\xbf\xf0\x90\x80\x80\xf4\x8f\xbf\xbf");
+    UTF8_TEST("\xc0\x80");
+    UTF8_TEST("\xc1\xbf");
+    UTF8_TEST("\xe0\x9f\xbf");
+    UTF8_TEST("\xed\xa0\x80");
+    UTF8_TEST("\xed\xbf\xbf");
+    UTF8_TEST("\xf0\x8f\xbf\xbf");
+    UTF8_TEST("\xf4\x90\x80\x80");
+    UTF8_TEST("\xf5\x80\x80\x80");
+    UTF8_TEST("\xff");
+    UTF8_TEST("\x80");
+    UTF8_TEST("a\xe2\x82");
+    UTF8_TEST("a\xf0\x9f\x98");
+    UTF8_TEST("\xe2\x82" "a\xac");
+    UTF8_TEST("\xc3\xa9\xa9");
+    utf8_offset_test("\xc3\xa9");
+    utf8_offset_test("\xe2\x82\xac");
+    utf8_offset_test("\xf0\x9f\x98\x80");
+    utf8_offset_test("\xc3");
+    utf8_offset_test("\xe2\x82");
+    utf8_offset_test("\xf0\x9f\x98");
+    utf8_offset_test("\xed\xa0\x80");
+    utf8_offset_test("\xe0\x80\x80");
+    utf8_offset_test("\xf4\x90\x80\x80");
+    utf8_offset_test("\x80");
+    utf8_offset_test("\xc3\xa9\xbf");
+    for (i = 0; i < 40; i++) {
+        utf8_random_test(10 + i * 37, (int)(i % 4));
+    }
+    utf8_random_test(100000, 0);
+    utf8_random_test(100000, 1);
+    utf8_json_test("\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80", true);
+    utf8_json_test("\xc3", false);
+    utf8_json_test("\xed\xa0\x80", false);
+    utf8_json_test("\xc0\xaf", false);
+    utf8_json_test("abcdefghijklmnopqrstuvwxyz012345\xf4\x90\x80\x80", false);
+    utf8_cbor_test("\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80", true);
+    utf8_cbor_test("\xc3", false);
+    utf8_cbor_test("\xed\xa0\x80", false);
+    utf8_cbor_test("abcdefghijklmnopqrstu\xff", false);
+    loads_random_test(3, 50);
+    loads_random_test(300, 50);
+    return failures != 0;
+}
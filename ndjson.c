@@ -0,0 +1,366 @@
+#include "cbor.h"
+#include <limits.h>
+#include <string.h>
+#include "define.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/* input parsed per thread and round: bounds memory when values go to a callback */
+#define CBOR_LINES_BATCH (4 << 20)
+/* below this a range is not worth a thread */
+#define CBOR_LINES_MIN_RANGE (64 << 10)
+#define CBOR_LINES_MAX_THREADS 64
+
+typedef struct {
+    size_t line;
+    cbor_value_t *val;  /* NULL for a malformed line */
+} cbor_line_t;
+
+typedef struct {
+    const char *ptr;
+    const char *end;
+    int flag;
+    cbor_line_t *lines;
+    size_t count;
+    size_t allocated;
+    size_t newlines;    /* lines in the range, blank ones included */
+    bool failed;        /* out of memory */
+} cbor_lines_worker_t;
+
+static bool cbor_lines_blank(const char *ptr, const char *end) {
+    for (; ptr < end; ptr++) {
+        if (*ptr != ' ' && (*ptr < '\t' || *ptr > '\r')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* one line of any length, past INT_MAX through the push parser
+ * return: its value, NULL unless the line holds exactly one */
+static cbor_value_t *cbor_lines_parse(const char *ptr, const char *eol, int flag) {
+    cbor_json_parser_t *parser;
+    cbor_value_t *val = NULL, *extra;
+    int consume = 0;
+
+    if ((size_t)(eol - ptr) <= INT_MAX) {
+        val = cbor_json_loads_ex(ptr, (int)(eol - ptr), flag, &consume);
+        if (val && !cbor_lines_blank(ptr + consume, eol)) {
+            cbor_destroy(val);
+            val = NULL;
+        }
+        return val;
+    }
+    parser = cbor_json_parser_new(flag);
+    if (parser == NULL) {
+        return NULL;
+    }
+    if (cbor_json_parser_feed(parser, ptr, eol - ptr) == 0 && cbor_json_parser_finish(parser) == 0) {
+        val = cbor_json_parser_pop(parser);
+        if ((extra = cbor_json_parser_pop(parser)) != NULL) {
+            cbor_destroy(extra);
+            cbor_destroy(val);
+            val = NULL;
+        }
+    }
+    cbor_json_parser_destroy(parser);
+    return val;
+}
+
+static void *cbor_lines_work(void *arg) {
+    cbor_lines_worker_t *w = (cbor_lines_worker_t *)arg;
+    const char *ptr = w->ptr;
+
+    while (ptr < w->end && !w->failed) {
+        const char *eol = (const char *)memchr(ptr, '\n', w->end - ptr);
+        if (eol == NULL) {
+            eol = w->end;
+        }
+        if (!cbor_lines_blank(ptr, eol)) {
+            cbor_value_t *val = cbor_lines_parse(ptr, eol, w->flag);
+            if (w->count == w->allocated) {
+                size_t allocated = w->allocated ? w->allocated * 2 : 256;
+                cbor_line_t *tmp = (cbor_line_t *)realloc(w->lines, sizeof(cbor_line_t) * allocated);
+                if (tmp == NULL) {
+                    cbor_destroy(val);
+                    w->failed = true;
+                    break;
+                }
+                w->lines = tmp;
+                w->allocated = allocated;
+            }
+            w->lines[w->count].line = w->newlines;
+            w->lines[w->count].val = val;
+            w->count++;
+        }
+        w->newlines++;
+        ptr = eol < w->end ? eol + 1 : w->end;
+    }
+    return NULL;
+}
+
+/* first byte after the line that contains `ptr`, at most `end` */
+static const char *cbor_lines_next(const char *ptr, const char *end) {
+    const char *eol = ptr < end ? (const char *)memchr(ptr, '\n', end - ptr) : NULL;
+    return eol ? eol + 1 : end;
+}
+
+static int cbor_lines_threads(int threads) {
+#ifndef _WIN32
+    if (threads <= 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (int)online : 1;
+    }
+#else
+    threads = 1;
+#endif
+    return threads > CBOR_LINES_MAX_THREADS ? CBOR_LINES_MAX_THREADS : threads;
+}
+
+/* `fn` over `count` workers laid out `stride` bytes apart, the calling
+ * thread takes the first and any a thread could not be started for */
+static void cbor_threads_run(void *(*fn)(void *), void *workers, size_t stride, int count) {
+    int i;
+#ifndef _WIN32
+    pthread_t tids[CBOR_LINES_MAX_THREADS];
+    bool started[CBOR_LINES_MAX_THREADS];
+
+    for (i = 1; i < count; i++) {
+        started[i] = pthread_create(&tids[i], NULL, fn, (char *)workers + stride * i) == 0;
+    }
+    fn(workers);
+    for (i = 1; i < count; i++) {
+        if (started[i]) {
+            pthread_join(tids[i], NULL);
+        } else {
+            fn((char *)workers + stride * i);
+        }
+    }
+#else
+    for (i = 0; i < count; i++) {
+        fn((char *)workers + stride * i);
+    }
+#endif
+}
+
+/* parse [ptr, end) split at line boundaries over `count` workers */
+static void cbor_lines_run(cbor_lines_worker_t *workers, int count, const char *ptr, const char *end, int flag) {
+    size_t size = end - ptr;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        const char *stop = i + 1 == count ? end : cbor_lines_next(ptr + size / count * (i + 1), end);
+        memset(&workers[i], 0, sizeof(cbor_lines_worker_t));
+        workers[i].ptr = i == 0 ? ptr : workers[i - 1].end;
+        workers[i].end = stop < workers[i].ptr ? workers[i].ptr : stop;
+        workers[i].flag = flag;
+    }
+    cbor_threads_run(cbor_lines_work, workers, sizeof(cbor_lines_worker_t), count);
+}
+
+int cbor_json_loads_lines_cb(const void *src, size_t size, int flag, int threads, cbor_json_line_cb cb, void *userdata) {
+    cbor_lines_worker_t workers[CBOR_LINES_MAX_THREADS];
+    const char *ptr = (const char *)src;
+    const char *end = ptr + size;
+    size_t line = 0;
+    int r = 0;
+
+    if (src == NULL || cb == NULL) {
+        return -1;
+    }
+    threads = cbor_lines_threads(threads);
+    while (ptr < end) {
+        size_t left = end - ptr;
+        const char *stop = left > (size_t)threads * CBOR_LINES_BATCH
+                           ? cbor_lines_next(ptr + (size_t)threads * CBOR_LINES_BATCH, end) : end;
+        size_t count = (stop - ptr) / CBOR_LINES_MIN_RANGE + 1;
+        int i;
+
+        if (count > (size_t)threads) {
+            count = threads;
+        }
+        cbor_lines_run(workers, (int)count, ptr, stop, flag);
+
+        /* hand over in input order, everything after a stop is dropped */
+        for (i = 0; i < (int)count; i++) {
+            size_t j;
+            if (workers[i].failed) {
+                r = -1;
+            }
+            for (j = 0; j < workers[i].count; j++) {
+                if (r == 0) {
+                    r = cb(userdata, line + workers[i].lines[j].line, workers[i].lines[j].val);
+                } else {
+                    cbor_destroy(workers[i].lines[j].val);
+                }
+            }
+            line += workers[i].newlines;
+            free(workers[i].lines);
+        }
+        if (r != 0) {
+            return r;
+        }
+        ptr = stop;
+    }
+    return 0;
+}
+
+static int cbor_lines_collect(void *userdata, size_t line, cbor_value_t *val) {
+    (void)line;
+    if (val == NULL) {
+        return -1;
+    }
+    return cbor_container_insert_tail((cbor_value_t *)userdata, val);
+}
+
+cbor_value_t *cbor_json_loads_lines(const void *src, size_t size, int flag, int threads) {
+    cbor_value_t *array = cbor_init_array();
+    if (cbor_json_loads_lines_cb(src, size, flag, threads, cbor_lines_collect, array) != 0) {
+        cbor_destroy(array);
+        return NULL;
+    }
+    return array;
+}
+
+typedef struct {
+    const char *ptr;
+    size_t size;
+    int flag;
+    cbor_value_t *array;
+    int result;
+} cbor_elements_worker_t;
+
+static void *cbor_elements_work(void *arg) {
+    cbor_elements_worker_t *w = (cbor_elements_worker_t *)arg;
+    w->array = cbor_init_array();
+    w->result = json__parse_elements(w->ptr, w->size, w->flag, w->array);
+    return NULL;
+}
+
+/* index pass over a top level array: cuts[0] and cuts[count] get its brackets,
+ * the cuts between get the first comma at depth 1 past each even share
+ * return: ranges between the cuts, 0 when the text is not one closed array */
+static int cbor_elements_split(const char *src, size_t size, int count, size_t *cuts) {
+    json__index_t index;
+    size_t depth = 0;
+    int found = 0;
+    size_t i;
+
+    if (json__index_init(&index, src, size) != 0) {
+        return 0;
+    }
+    while (json__index_next(&index) == 0) {
+        for (i = 0; i < index.count; i++) {
+            size_t offset = index.base + index.offsets[i];
+            int ch = src[offset];
+            if (depth == 0) {
+                if (found > 0) {
+                    /* content after the array is not parsed, as by cbor_json_loads */
+                    goto done;
+                }
+                if (ch != '[') {
+                    goto fail;
+                }
+                cuts[found++] = offset;
+                depth++;
+            } else if (ch == '[' || ch == '{') {
+                depth++;
+            } else if (ch == ']' || ch == '}') {
+                if (--depth == 0) {
+                    if (ch != ']') {
+                        goto fail;
+                    }
+                    cuts[found] = offset;
+                    goto done;
+                }
+            } else if (ch == ',' && depth == 1 && found < count
+                       && offset >= cuts[0] + (size - cuts[0]) / count * found) {
+                cuts[found++] = offset;
+            }
+        }
+    }
+fail:
+    found = 0;
+done:
+    json__index_release(&index);
+    return found;
+}
+
+/* the whole text on the calling thread, beyond INT_MAX through the push parser */
+static cbor_value_t *cbor_json_loads_whole(const void *src, size_t size, int flag) {
+    cbor_json_parser_t *parser;
+    cbor_value_t *val = NULL;
+
+    if (size <= INT_MAX) {
+        return cbor_json_loads_ex(src, (int)size, flag, NULL);
+    }
+    parser = cbor_json_parser_new(flag);
+    if (parser == NULL) {
+        return NULL;
+    }
+    if (cbor_json_parser_feed(parser, src, size) == 0 && cbor_json_parser_finish(parser) == 0) {
+        val = cbor_json_parser_pop(parser);
+    }
+    cbor_json_parser_destroy(parser);
+    return val;
+}
+
+cbor_value_t *cbor_json_loads_parallel(const void *src, size_t size, int flag, int threads) {
+    cbor_elements_worker_t workers[CBOR_LINES_MAX_THREADS];
+    size_t cuts[CBOR_LINES_MAX_THREADS + 1];
+    unsigned limit = JSON_DEPTH_LIMIT(flag);
+    cbor_value_t *array;
+    int count;
+    int i;
+
+    if (src == NULL) {
+        return NULL;
+    }
+    count = cbor_lines_threads(threads);
+    if (size / CBOR_LINES_MIN_RANGE + 1 < (size_t)count) {
+        count = (int)(size / CBOR_LINES_MIN_RANGE + 1);
+    }
+    /* comments hide tokens from the index, and elements sit one level below the limit */
+    if (count < 2 || flag & JSON_PARSER_ALLOW_COMMENT || limit == 1) {
+        return cbor_json_loads_whole(src, size, flag);
+    }
+    count = cbor_elements_split((const char *)src, size, count, cuts);
+    if (count == 0) {
+        return cbor_json_loads_whole(src, size, flag);
+    }
+
+    for (i = 0; i < count; i++) {
+        workers[i].ptr = (const char *)src + cuts[i] + 1;
+        workers[i].size = cuts[i + 1] - cuts[i] - 1;
+        workers[i].flag = (flag & ~JSON_PARSER_REPORT_ERROR & ~JSON_PARSER_MAX_DEPTH(0x7FFF))
+                          | (limit ? JSON_PARSER_MAX_DEPTH(limit - 1) : 0);
+        workers[i].array = NULL;
+        workers[i].result = 0;
+    }
+    /* an empty array is one range of whitespace */
+    if (count == 1 && cbor_lines_blank(workers[0].ptr, workers[0].ptr + workers[0].size)) {
+        return cbor_init_array();
+    }
+    cbor_threads_run(cbor_elements_work, workers, sizeof(cbor_elements_worker_t), count);
+
+    array = workers[0].array;
+    for (i = 1; i < count; i++) {
+        cbor_container_concat(array, workers[i].array);
+        cbor_destroy(workers[i].array);
+    }
+    for (i = 0; i < count; i++) {
+        if (workers[i].result != 0) {
+            cbor_destroy(array);
+            array = NULL;
+            break;
+        }
+    }
+    /* the error report comes from a parse of the whole text */
+    if (array == NULL && flag & JSON_PARSER_REPORT_ERROR) {
+        cbor_destroy(cbor_json_loads_whole(src, size, flag));
+    }
+    return array;
+}
@@ -0,0 +1,191 @@
+#include "test.h"
+
+/* cbor_json_loads_lines of `input` as compact JSON, "" when it fails */
+static void lines_test(const char *input, int threads, const char *output) {
+    cbor_value_t *val = cbor_json_loads_lines(input, strlen(input), 0, threads);
+    size_t length;
+    char *json = val ? cbor_json_dumps(val, &length, false) : NULL;
+    report(!strcmp(json ? json : "", output), input, json ? json : "");
+    free(json);
+    cbor_destroy(val);
+}
+
+/* what the callback saw: "line:value" per call, "line:error" for malformed ones */
+typedef struct {
+    char out[256];
+    size_t calls;
+    size_t stop;        /* return 5 on this call, 0 for never */
+} line_recorder_t;
+
+static int line_record(void *userdata, size_t line, cbor_value_t *val) {
+    line_recorder_t *rec = (line_recorder_t *)userdata;
+    size_t length = strlen(rec->out), n;
+    char *json = val ? cbor_json_dumps(val, &n, false) : NULL;
+    snprintf(rec->out + length, sizeof(rec->out) - length, "%zu:%s ", line, json ? json : "error");
+    free(json);
+    cbor_destroy(val);
+    return ++rec->calls == rec->stop ? 5 : 0;
+}
+
+static void lines_cb_test(const char *input, size_t stop, int result, const char *output) {
+    line_recorder_t rec;
+    char content[300];
+    int r;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.stop = stop;
+    r = cbor_json_loads_lines_cb(input, strlen(input), 0, 1, line_record, &rec);
+    snprintf(content, sizeof(content), "%d, %s", r, rec.out);
+    report(r == result && !strcmp(rec.out, output), input, content);
+}
+
+typedef struct {
+    size_t next;        /* line the next call must carry */
+    size_t calls;
+    bool ordered;
+} order_checker_t;
+
+static int line_order(void *userdata, size_t line, cbor_value_t *val) {
+    order_checker_t *check = (order_checker_t *)userdata;
+    check->ordered &= val != NULL && line == check->next && cbor_integer(cbor_container_first(val)) == (long long)line;
+    check->next = line + 2;
+    check->calls++;
+    cbor_destroy(val);
+    return 0;
+}
+
+/* enough lines for every thread, a blank one after each record: the
+ * threads give the single thread's array and the callback sees lines in order */
+static void lines_threads_test(int records, int threads) {
+    size_t capacity = (size_t)records * 64, length = 0;
+    char *src = (char *)malloc(capacity), *one = NULL, *many = NULL;
+    cbor_value_t *a, *b;
+    order_checker_t check;
+    char name[64], content[64];
+    size_t size_a = 0, size_b = 0;
+    int i;
+
+    for (i = 0; i < records; i++) {
+        length += snprintf(src + length, capacity - length, "[%d, \"record %d\", {\"odd\": %s}]\n%s",
+                           i * 2, i, i % 2 ? "true" : "false", i % 3 ? "\n" : " \r\n");
+    }
+    a = cbor_json_loads_lines(src, length, 0, 1);
+    b = cbor_json_loads_lines(src, length, 0, threads);
+    one = a ? cbor_dumps(a, &size_a) : NULL;
+    many = b ? cbor_dumps(b, &size_b) : NULL;
+    memset(&check, 0, sizeof(check));
+    check.ordered = true;
+    cbor_json_loads_lines_cb(src, length, 0, threads, line_order, &check);
+
+    snprintf(name, sizeof(name), "%d records on %d threads", records, threads);
+    snprintf(content, sizeof(content), "%zu values, %zu calls", (size_t)(a ? cbor_container_size(a) : 0), check.calls);
+    report(one && many && size_a == size_b && !memcmp(one, many, size_a) && (size_t)cbor_container_size(a) == (size_t)records
+           && check.ordered && check.calls == (size_t)records, name, content);
+    free(one);
+    free(many);
+    cbor_destroy(a);
+    cbor_destroy(b);
+    free(src);
+}
+
+/* cbor_json_loads_parallel of `length` bytes matches cbor_json_loads_ex on
+ * 1 to 4 threads and one per CPU: the same tree or both NULL */
+static void parallel_test(const char *name, const char *src, size_t length, int flag) {
+    cbor_value_t *expect = cbor_json_loads_ex(src, (int)length, flag, NULL);
+    size_t size_a = 0;
+    char *raw_a = expect ? cbor_dumps(expect, &size_a) : NULL;
+    char content[64] = "";
+    int threads;
+
+    for (threads = 0; threads <= 4 && !content[0]; threads++) {
+        cbor_value_t *val = cbor_json_loads_parallel(src, length, flag, threads);
+        size_t size_b = 0;
+        char *raw_b = val ? cbor_dumps(val, &size_b) : NULL;
+        if ((val != NULL) != (expect != NULL) || size_a != size_b || (raw_a && memcmp(raw_a, raw_b, size_a))) {
+            snprintf(content, sizeof(content), "%d threads: %s, %zu of %zu bytes", threads,
+                     val ? "loaded" : "failed", size_b, size_a);
+        }
+        free(raw_b);
+        cbor_destroy(val);
+    }
+    report(!content[0], name, content[0] ? content : expect ? "same" : "both failed");
+    free(raw_a);
+    cbor_destroy(expect);
+}
+
+/* "[" records "]" with the text of `fill` repeated `count` times as records,
+ * then `tail` */
+static char *parallel_doc(const char *fill, int count, const char *tail, size_t *length) {
+    size_t capacity = (strlen(fill) + 1) * count + strlen(tail) + 64;
+    char *src = (char *)malloc(capacity);
+    int i;
+
+    *length = 0;
+    src[(*length)++] = '[';
+    for (i = 0; i < count; i++) {
+        *length += snprintf(src + *length, capacity - *length, "%s%s", i ? "," : "", fill);
+    }
+    *length += snprintf(src + *length, capacity - *length, "]%s", tail);
+    return src;
+}
+
+static void parallel_doc_test(const char *name, const char *fill, int count, const char *tail, int flag) {
+    size_t length;
+    char *src = parallel_doc(fill, count, tail, &length);
+    parallel_test(name, src, length, flag);
+    free(src);
+}
+
+/* one byte of a large document replaced at `at` permille of its length */
+static void parallel_break_test(const char *fill, int count, int at, char ch) {
+    size_t length;
+    char *src = parallel_doc(fill, count, "", &length), name[64];
+
+    src[length * at / 1000] = ch;
+    snprintf(name, sizeof(name), "'%c' at %d permille", ch, at);
+    parallel_test(name, src, length, 0);
+    free(src);
+}
+
+int main(int argc, char **argv) {
+    lines_test("", 1, "[]");
+    lines_test("1\n2\n3", 1, "[1, 2, 3]");
+    lines_test("1\n2\n3\n", 1, "[1, 2, 3]");
+    lines_test(JSON({"a": 1}) "\r\n\n  \n" JSON([true, null]) "\r\n", 1, "[{\"a\": 1}, [true, null]]");
+    lines_test("\"a\\nb\"\n" JSON({"k": "x"}), 2, "[\"a\\nb\", {\"k\": \"x\"}]");
+    lines_test("1\n[2,\n3]\n", 1, "");
+    lines_test("1 2\n", 1, "");
+    lines_test("1\n{\"a\": }\n", 1, "");
+
+    lines_cb_test("1\n\n[2]\nnope\n{}", 0, 0, "0:1 2:[2] 3:error 4:{} ");
+    lines_cb_test("1\n2\n3\n4", 2, 5, "0:1 1:2 ");
+
+    lines_threads_test(20000, 1);
+    lines_threads_test(20000, 2);
+    lines_threads_test(20000, 4);
+    lines_threads_test(20000, 0);
+
+    parallel_doc_test("small array", "1", 3, "", 0);
+    parallel_doc_test("records", JSON({"id": 12, "name": "a, [b]", "tags": ["x", {"y": null}], "r": -1.5e3}),
+                      5000, "", 0);
+    parallel_doc_test("strings with brackets", "\"],[\\\"{,}\"", 30000, "", 0);
+    parallel_doc_test("nested arrays", "[[1, 2], [3, [4, 5]], []]", 20000, "", 0);
+    parallel_doc_test("blank records", "  \n\t{ }  ", 30000, "", 0);
+    parallel_doc_test("trailing value", "[true, false]", 20000, " {\"a\": 1}", 0);
+    parallel_doc_test("trailing garbage", "[true, false]", 20000, " ]]", 0);
+    parallel_doc_test("numbers", "1234", 40000, "", 0);
+    parallel_doc_test("empty elements", "1,", 40000, "", 0);
+    parallel_doc_test("utf-8", "\"\xc3\xa9\xe4\xb8\xad\xf0\x9f\x98\x80\"", 20000, "", JSON_PARSER_VALIDATE_UTF8);
+    parallel_doc_test("bad utf-8", "\"\xc3\xa9\xe4\xb8\xad\xf0\x9f\x98\"", 20000, "", JSON_PARSER_VALIDATE_UTF8);
+    parallel_doc_test("depth limit", "[[1]]", 30000, "", JSON_PARSER_MAX_DEPTH(3));
+    parallel_doc_test("over depth limit", "[[1]]", 30000, "", JSON_PARSER_MAX_DEPTH(2));
+    parallel_doc_test("comments", "/* , */ 1 // ,\n", 20000, "", JSON_PARSER_ALLOW_COMMENT);
+    parallel_break_test("[1, \"abc\", {\"k\": true}]", 10000, 1, ',');
+    parallel_break_test("[1, \"abc\", {\"k\": true}]", 10000, 500, ',');
+    parallel_break_test("[1, \"abc\", {\"k\": true}]", 10000, 501, ']');
+    parallel_break_test("[1, \"abc\", {\"k\": true}]", 10000, 750, '}');
+    parallel_break_test("[1, \"abc\", {\"k\": true}]", 10000, 999, '"');
+    parallel_break_test("[1, \"abc\", {\"k\": true}]", 10000, 250, 'x');
+    parallel_break_test("[1, \"abc\", {\"k\": true}]", 10000, 333, '[');
+    return failures != 0;
+}
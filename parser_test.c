@@ -0,0 +1,354 @@
+#include "test.h"
+
+/* the popped values as compact JSON, one per line */
+static void pop_all(cbor_json_parser_t *parser, char *out, size_t size) {
+    cbor_value_t *val;
+    size_t length = strlen(out);
+    while ((val = cbor_json_parser_pop(parser)) != NULL) {
+        size_t n;
+        char *json = cbor_json_dumps(val, &n, false);
+        snprintf(out + length, size - length, "%s\n", json ? json : "?");
+        length = strlen(out);
+        free(json);
+        cbor_destroy(val);
+    }
+}
+
+/* `input` fed in chunks of every size from 1 byte to the whole text gives
+ * the values of `output`, or fails when `output` is NULL */
+static void push_test(const char *input, const char *output) {
+    size_t length = strlen(input), size;
+    char content[600] = ""; /* room for the prefix and all of `values` */
+
+    for (size = 1; size <= length; size++) {
+        cbor_json_parser_t *parser = cbor_json_parser_new(0);
+        char values[512] = "";
+        size_t offset;
+        int r = 0;
+
+        for (offset = 0; offset < length && r == 0; offset += size) {
+            r = cbor_json_parser_feed(parser, input + offset, length - offset < size ? length - offset : size);
+            pop_all(parser, values, sizeof(values));
+        }
+        if (r == 0) {
+            r = cbor_json_parser_finish(parser);
+            pop_all(parser, values, sizeof(values));
+        }
+        cbor_json_parser_destroy(parser);
+        if (output ? r != 0 || strcmp(values, output) : r == 0) {
+            snprintf(content, sizeof(content), "chunks of %zu: %d, %s", size, r, values);
+            break;
+        }
+    }
+    report(!content[0], input, content);
+}
+
+/* SAX events written out as text, "stop" makes the callback with that
+ * event text return 7 */
+typedef struct {
+    char out[512];
+    const char *stop;
+} sax_recorder_t;
+
+static int sax_record(sax_recorder_t *rec, const char *event) {
+    size_t length = strlen(rec->out);
+    snprintf(rec->out + length, sizeof(rec->out) - length, "%s ", event);
+    return rec->stop && !strcmp(rec->stop, event) ? 7 : 0;
+}
+
+static int sax_begin_object(void *userdata) {
+    return sax_record((sax_recorder_t *)userdata, "{");
+}
+
+static int sax_end_object(void *userdata) {
+    return sax_record((sax_recorder_t *)userdata, "}");
+}
+
+static int sax_begin_array(void *userdata) {
+    return sax_record((sax_recorder_t *)userdata, "[");
+}
+
+static int sax_end_array(void *userdata) {
+    return sax_record((sax_recorder_t *)userdata, "]");
+}
+
+static int sax_key(void *userdata, const char *ptr, size_t length) {
+    char event[64];
+    snprintf(event, sizeof(event), "k:%.*s", (int)length, ptr);
+    return sax_record((sax_recorder_t *)userdata, event);
+}
+
+static int sax_string(void *userdata, const char *ptr, size_t length) {
+    char event[64];
+    snprintf(event, sizeof(event), "s:%.*s", (int)length, ptr);
+    return sax_record((sax_recorder_t *)userdata, event);
+}
+
+static int sax_integer(void *userdata, bool negative, uint64_t magnitude) {
+    char event[64];
+    snprintf(event, sizeof(event), "i:%s%llu", negative ? "-" : "", (unsigned long long)magnitude);
+    return sax_record((sax_recorder_t *)userdata, event);
+}
+
+static int sax_real(void *userdata, double value) {
+    char event[64];
+    snprintf(event, sizeof(event), "r:%g", value);
+    return sax_record((sax_recorder_t *)userdata, event);
+}
+
+static int sax_boolean(void *userdata, bool value) {
+    return sax_record((sax_recorder_t *)userdata, value ? "true" : "false");
+}
+
+static int sax_null(void *userdata) {
+    return sax_record((sax_recorder_t *)userdata, "null");
+}
+
+static const cbor_json_sax_t sax_all = {
+    sax_begin_object, sax_end_object, sax_begin_array, sax_end_array,
+    sax_key, sax_string, sax_integer, sax_real, sax_boolean, sax_null,
+};
+
+/* events of `input` and what cbor_json_sax_parse returned and consumed */
+static void sax_test(const char *input, const char *stop, int result, int consumed, const char *output) {
+    sax_recorder_t rec;
+    char content[600];
+    int consume = -1, r;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.stop = stop;
+    r = cbor_json_sax_parse(input, -1, 0, &sax_all, &rec, &consume);
+    snprintf(content, sizeof(content), "%d, %d: %s", r, consume, rec.out);
+    report(r == result && consume == consumed && !strcmp(rec.out, output), input, content);
+}
+
+/* the tree rebuilt from a cursor walk: containers through first/next and
+ * key, scalars through value */
+static cbor_value_t *cursor_tree(const cbor_json_cursor_t *cur) {
+    cbor_json_cursor_t child;
+    cbor_value_t *container;
+    int r;
+
+    if (*cur->ptr != '[' && *cur->ptr != '{') {
+        return cbor_json_cursor_value(cur);
+    }
+    container = *cur->ptr == '[' ? cbor_init_array() : cbor_init_map();
+    for (r = cbor_json_cursor_first(cur, &child); r == 0; r = cbor_json_cursor_next(&child)) {
+        cbor_value_t *val = cursor_tree(&child);
+        if (val == NULL) {
+            cbor_destroy(container);
+            return NULL;
+        }
+        if (cbor_is_map(container)) {
+            val = cbor_init_pair(cbor_json_cursor_key(&child), val);
+        }
+        cbor_container_insert_tail(container, val);
+    }
+    return container;
+}
+
+static bool same_tree(const cbor_value_t *a, const cbor_value_t *b) {
+    size_t size_a = 0, size_b = 0;
+    char *raw_a = a ? cbor_dumps(a, &size_a) : NULL, *raw_b = b ? cbor_dumps(b, &size_b) : NULL;
+    bool same = raw_a && raw_b && size_a == size_b && !memcmp(raw_a, raw_b, size_a);
+    free(raw_a);
+    free(raw_b);
+    return same;
+}
+
+/* walking the whole document by cursor gives the parsed tree */
+static void cursor_walk_test(const char *input, int flag) {
+    cbor_json_cursor_t cur;
+    cbor_value_t *tree = cbor_json_loads_ex(input, -1, flag, NULL), *walked = NULL;
+
+    if (cbor_json_cursor_init(&cur, input, strlen(input), flag) == 0) {
+        walked = cursor_tree(&cur);
+    }
+    report(same_tree(tree, walked), input, walked ? "same" : "failed");
+    cbor_destroy(tree);
+    cbor_destroy(walked);
+}
+
+/* the value at `path` as compact JSON, with its member name, "" when there is none */
+static void cursor_get_test(const char *input, int flag, const char *path, const char *output) {
+    cbor_json_cursor_t cur, at;
+    cbor_value_t *val = NULL, *key = NULL;
+    char content[256] = "";
+    char *json = NULL, *name = NULL;
+    size_t length;
+
+    if (cbor_json_cursor_init(&cur, input, strlen(input), flag) == 0 && cbor_json_cursor_get(&cur, path, &at) == 0) {
+        val = cbor_json_cursor_value(&at);
+        key = cbor_json_cursor_key(&at);
+    }
+    json = val ? cbor_json_dumps(val, &length, false) : NULL;
+    name = key ? cbor_json_dumps(key, &length, false) : NULL;
+    if (json) {
+        snprintf(content, sizeof(content), "%s%s%s", name ? name : "", name ? ": " : "", json);
+    }
+    report(!strcmp(content, output), path, content);
+    free(json);
+    free(name);
+    cbor_destroy(val);
+    cbor_destroy(key);
+}
+
+/* `depth` containers, arrays and objects in turn, around a 1 */
+static char *nested(int depth) {
+    char *src = (char *)malloc((size_t)depth * 6 + 2), *ptr = src;
+    int i;
+
+    for (i = 0; i < depth; i++) {
+        ptr += sprintf(ptr, i % 2 ? "{\"a\":" : "[");
+    }
+    *ptr++ = '1';
+    for (i = depth - 1; i >= 0; i--) {
+        *ptr++ = i % 2 ? '}' : ']';
+    }
+    *ptr = '\0';
+    return src;
+}
+
+/* the same depth, the outer array with 30000 zeros ahead of the rest */
+static char *wide_nested(int depth) {
+    char *src = nested(depth), *wide;
+    int i;
+
+    if (depth == 0) {
+        return src;
+    }
+    wide = (char *)malloc(strlen(src) + 30000 * 3 + 1);
+    wide[0] = '[';
+    for (i = 0; i < 30000; i++) {
+        memcpy(wide + 1 + i * 3, "0, ", 3);
+    }
+    strcpy(wide + 1 + 30000 * 3, src + 1);
+    free(src);
+    return wide;
+}
+
+/* every parser takes `depth` containers under JSON_PARSER_MAX_DEPTH(`limit`)
+ * when the limit allows them and fails when it does not */
+static void depth_test(int depth, int limit) {
+    int flag = JSON_PARSER_MAX_DEPTH(limit), consume = 0;
+    bool ok = limit == 0 || depth <= limit;
+    char *src = nested(depth), *wide = wide_nested(depth), name[64], content[64];
+    size_t length = strlen(src);
+    cbor_json_parser_t *parser = cbor_json_parser_new(flag);
+    cbor_value_t *tree, *pushed = NULL, *parallel, *lines;
+    sax_recorder_t rec;
+    cbor_json_sax_t sax;
+    cbor_encoder_t enc;
+    char *raw;
+    int sax_result, encoded;
+
+    tree = cbor_json_loads_ex(src, (int)length, flag, &consume);
+    if (cbor_json_parser_feed(parser, src, length) == 0 && cbor_json_parser_finish(parser) == 0) {
+        pushed = cbor_json_parser_pop(parser);
+    }
+    cbor_json_parser_destroy(parser);
+    memset(&rec, 0, sizeof(rec));
+    memset(&sax, 0, sizeof(sax));
+    sax_result = cbor_json_sax_parse(src, (int)length, flag, &sax, &rec, NULL);
+    cbor_encoder_init(&enc, NULL, 0);
+    encoded = cbor_encode_json(&enc, src, (int)length, flag, NULL);
+    raw = cbor_encoder_release(&enc, NULL);
+    /* wide enough for the threads to split it */
+    parallel = cbor_json_loads_parallel(wide, strlen(wide), flag, 2);
+    lines = cbor_json_loads_lines(src, length, flag, 1);
+
+    snprintf(name, sizeof(name), "%d deep, limit %d", depth, limit);
+    snprintf(content, sizeof(content), "%d%d%d%d%d%d", tree != NULL, pushed != NULL, sax_result == 0,
+             encoded == 0, parallel != NULL, lines != NULL);
+    report(!strcmp(content, ok ? "111111" : "000000") && (!ok || consume == (int)length), name, content);
+    cbor_destroy(tree);
+    cbor_destroy(pushed);
+    cbor_destroy(parallel);
+    cbor_destroy(lines);
+    free(raw);
+    free(wide);
+    free(src);
+}
+
+int main(int argc, char **argv) {
+    push_test(JSON(1), "1\n");
+    push_test(JSON([1, [2, 3], {"a": null}]), "[1, [2, 3], {\"a\": null}]\n");
+    push_test(JSON({"kéy": "v\"al\\ue", "n": -2.5e3, "t": true, "f": false}),
+              "{\"k\\u00e9y\": \"v\\\"al\\\\ue\", \"n\": -2500.000000, \"t\": true, \"f\": false}\n");
+    push_test(JSON(1 [2] "three" {} -4 true null 12345678901234567890),
+              "1\n[2]\n\"three\"\n{}\n-4\ntrue\nnull\n12345678901234567890\n");
+    push_test(JSON("😀"), "\"\\ud83d\\ude00\"\n");
+    push_test("  \n\t ", "");
+    push_test(JSON([1, 2,]), NULL);
+    push_test("[1, 2", NULL);
+    push_test("{\"a\": 1", NULL);
+    push_test("[[1]", NULL);
+    push_test(JSON({"a" 1}), NULL);
+    push_test("\"open", NULL);
+    push_test(JSON(tru), NULL);
+    push_test("1 ]", NULL);
+    sax_test(JSON(1), NULL, 0, 1, "i:1 ");
+    sax_test(JSON([1, -2, 2.5, "a", true, false, null]), NULL, 0, 36,
+             "[ i:1 i:-2 r:2.5 s:a true false null ] ");
+    sax_test(JSON({"a": {"b": []}, "c\"d": "e\u00e9", "f": {}}), NULL, 0, 44,
+             "{ k:a { k:b [ ] } k:c\"d s:e\xc3\xa9 k:f { } } ");
+    sax_test(JSON(-18446744073709551615 18446744073709551615), NULL, 0, 21, "i:-18446744073709551615 ");
+    sax_test(JSON([1, [2, 3], 4] tail), NULL, 0, 14, "[ i:1 [ i:2 i:3 ] i:4 ] ");
+    /* a callback's nonzero return stops the parse right there */
+    sax_test(JSON([1, [2, 3], 4]), "i:2", 7, 6, "[ i:1 [ i:2 ");
+    sax_test(JSON({"a": 1, "b": 2}), "k:b", 7, 12, "{ k:a i:1 k:b ");
+    sax_test(JSON([1, 2,]), NULL, -1, 6, "[ i:1 i:2 ");
+    sax_test(JSON({"a" 1}), NULL, -1, 5, "{ k:a ");
+    sax_test("[1, 2", NULL, -1, 5, "[ i:1 i:2 ");
+    cursor_walk_test(JSON(1), 0);
+    cursor_walk_test(JSON([]), 0);
+    cursor_walk_test(JSON({}), 0);
+    cursor_walk_test(JSON([[], {}, [[]], {"": {}}]), 0);
+    cursor_walk_test(JSON({"a": [1, -2.5, "x\"]y", true, null], "b\u00e9": {"c": {"d": [false]}}, "e": "}"}), 0);
+    cursor_walk_test(" \n[ 1 ,\t{ \"a\" :\r\n2 } , [ ] ]  ", 0);
+    cursor_walk_test("/* [ */ {\"a\": // }\n [1, # ]\n 2] /* } */, \"b\": /* \" */ 3}", JSON_PARSER_ALLOW_COMMENT);
+    cursor_get_test(JSON({"a": [10, 20, {"b": "c"}], "d": {"e/f": 1, "g~h": 2, "": 3}}), 0, "", JSON({"a": [10, 20, {"b": "c"}], "d": {"e/f": 1, "g~h": 2, "": 3}}));
+    cursor_get_test(JSON({"a": [10, 20, {"b": "c"}], "d": {"e/f": 1, "g~h": 2, "": 3}}), 0, "/a/0", "10");
+    cursor_get_test(JSON({"a": [10, 20, {"b": "c"}], "d": {"e/f": 1, "g~h": 2, "": 3}}), 0, "/a/2", "{\"b\": \"c\"}");
+    cursor_get_test(JSON({"a": [10, 20, {"b": "c"}], "d": {"e/f": 1, "g~h": 2, "": 3}}), 0, "/a/2/b", "\"b\": \"c\"");
+    cursor_get_test(JSON({"a": [10, 20, {"b": "c"}], "d": {"e/f": 1, "g~h": 2, "": 3}}), 0, "/a/-", "{\"b\": \"c\"}");
+    cursor_get_test(JSON({"a": [10, 20, {"b": "c"}], "d": {"e/f": 1, "g~h": 2, "": 3}}), 0, "/d/e~1f", "\"e/f\": 1");
+    cursor_get_test(JSON({"a": [10, 20, {"b": "c"}], "d": {"e/f": 1, "g~h": 2, "": 3}}), 0, "/d/g~0h", "\"g~h\": 2");
+    cursor_get_test(JSON({"a": [10, 20, {"b": "c"}], "d": {"e/f": 1, "g~h": 2, "": 3}}), 0, "/d/", "\"\": 3");
+    cursor_get_test(JSON({"a": [10, 20, {"b": "c"}], "d": {"e/f": 1, "g~h": 2, "": 3}}), 0, "/a/3", "");
+    cursor_get_test(JSON({"a": [10, 20, {"b": "c"}], "d": {"e/f": 1, "g~h": 2, "": 3}}), 0, "/a/x", "");
+    cursor_get_test(JSON({"a": [10, 20, {"b": "c"}], "d": {"e/f": 1, "g~h": 2, "": 3}}), 0, "/a/", "");
+    cursor_get_test(JSON({"a": [10, 20, {"b": "c"}], "d": {"e/f": 1, "g~h": 2, "": 3}}), 0, "/x", "");
+    cursor_get_test(JSON({"a": [10, 20, {"b": "c"}], "d": {"e/f": 1, "g~h": 2, "": 3}}), 0, "/a/0/b", "");
+    cursor_get_test(JSON({"a": [10, 20, {"b": "c"}], "d": {"e/f": 1, "g~h": 2, "": 3}}), 0, "a", "");
+    cursor_get_test(JSON({"k\u00e9y": 1, "a\/b": 2, "q\"": 3}), 0, "/k\xc3\xa9y", "\"k\\u00e9y\": 1");
+    cursor_get_test(JSON({"k\u00e9y": 1, "a\/b": 2, "q\"": 3}), 0, "/a~1b", "\"a/b\": 2");
+    cursor_get_test(JSON({"k\u00e9y": 1, "a\/b": 2, "q\"": 3}), 0, "/q\"", "\"q\\\"\": 3");
+    cursor_get_test(JSON([[], [1], [[2, 3]]]), 0, "/2/0/1", "3");
+    cursor_get_test(JSON([[], [1], [[2, 3]]]), 0, "/0/0", "");
+    cursor_get_test(JSON([[], [1], [[2, 3]]]), 0, "/0/-", "");
+    /* passed over siblings are only checked for balanced brackets */
+    cursor_get_test(JSON({"a": [1, 2, , x], "b": 3}), 0, "/b", "\"b\": 3");
+    cursor_get_test(JSON({"a": [1, 2, , x], "b": 3}), 0, "/a", "");
+    cursor_get_test(JSON({"a": [1, 2, "]"], "b": 3}), 0, "/b", "\"b\": 3");
+    cursor_get_test(JSON({"a": [1, [2], "b": 3}), 0, "/b", "");
+    cursor_get_test("{\"a\": \"open, \"b\": 3}", 0, "/b", "");
+    cursor_get_test("{\"a\": 1 \"b\": 2}", 0, "/b", "");
+    cursor_get_test("[1, 2", 0, "/1", "2");
+    cursor_get_test("[1, [2", 0, "/1", "");
+    cursor_get_test("{\"a\": /* } */ 1, # \"b\": 0\n \"b\": 2}", JSON_PARSER_ALLOW_COMMENT, "/b", "\"b\": 2");
+    cursor_get_test(" ", 0, "", "");
+    depth_test(0, 1);
+    depth_test(1, 1);
+    depth_test(2, 1);
+    depth_test(32, 32);
+    depth_test(33, 32);
+    depth_test(64, 33);
+    depth_test(1000, 0);
+    depth_test(1000, 999);
+    depth_test(1000, 1000);
+    depth_test(32767, 32767);
+    depth_test(32768, 32767);
+    depth_test(100000, 0);
+    return failures != 0;
+}
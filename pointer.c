@@ -544,3 +544,195 @@ int cbor_pointer_join(char *buf, size_t size, ...) {
     }
     return 0;
 }
+
+/* match `size` key bytes against the reference token, unescaping `~0` and `~1`
+ * return: token position after the matched bytes, NULL on mismatch */
+const char *cbor__pointer_token_match(const char *tok, const char *end, const char *key, size_t size) {
+    size_t i;
+    for (i = 0; i < size; i++) {
+        int ch;
+        if (tok >= end) {
+            return NULL;
+        }
+        ch = (unsigned char)*tok++;
+        if (ch == '~' && tok < end && (*tok == '0' || *tok == '1')) {
+            ch = *tok == '0' ? '~' : '/';
+            tok++;
+        }
+        if (ch != (unsigned char)key[i]) {
+            return NULL;
+        }
+    }
+    return tok;
+}
+
+static bool cbor_raw_key_match(const char *src, size_t length, size_t offset, const char *tok, const char *end) {
+    cbor_type type;
+    uint8_t addition;
+    uint64_t arg;
+
+    offset = cbor__read_head(src, length, offset, &type, &addition, &arg);
+    if (offset == 0 || type != CBOR_TYPE_STRING) {
+        return false;
+    }
+    if (addition != 31) {
+        if (arg > length - offset) {
+            return false;
+        }
+        return cbor__pointer_token_match(tok, end, src + offset, arg) == end;
+    }
+    while (offset < length && (unsigned char)src[offset] != 0xFF) {
+        offset = cbor__read_head(src, length, offset, &type, &addition, &arg);
+        if (offset == 0 || type != CBOR_TYPE_STRING || addition == 31 || arg > length - offset) {
+            return false;
+        }
+        tok = cbor__pointer_token_match(tok, end, src + offset, arg);
+        if (tok == NULL) {
+            return false;
+        }
+        offset += arg;
+    }
+    return tok == end;
+}
+
+/* return: offset of the child named by the reference token, 0 if not found */
+static size_t cbor_raw_child(const char *src, size_t length, size_t offset, const char *tok, const char *end) {
+    cbor_type type;
+    uint8_t addition;
+    uint64_t count;
+
+    offset = cbor__read_head(src, length, offset, &type, &addition, &count);
+    if (offset == 0) {
+        return 0;
+    }
+    if (addition == 31) {
+        count = CBOR__INDEFINITE;
+    }
+
+    if (type == CBOR_TYPE_MAP) {
+        while (count == CBOR__INDEFINITE ? offset < length && (unsigned char)src[offset] != 0xFF : count > 0) {
+            bool match = cbor_raw_key_match(src, length, offset, tok, end);
+            offset = cbor_skip(src, length, offset);
+            if (offset == 0) {
+                return 0;
+            }
+            if (match) {
+                return offset;
+            }
+            offset = cbor_skip(src, length, offset);
+            if (offset == 0) {
+                return 0;
+            }
+            if (count != CBOR__INDEFINITE) {
+                count--;
+            }
+        }
+    } else if (type == CBOR_TYPE_ARRAY) {
+        size_t last = 0;
+        uint64_t idx = 0;
+        bool tail = (end - tok == 1 && *tok == '-');
+        if (!tail) {
+            const char *ptr;
+            if (tok == end) {
+                return 0;
+            }
+            for (ptr = tok; ptr < end; ptr++) {
+                if (*ptr < '0' || *ptr > '9' || idx > (UINT64_MAX - 9) / 10) {
+                    return 0;
+                }
+                idx = idx * 10 + (*ptr - '0');
+            }
+        }
+        while (count == CBOR__INDEFINITE ? offset < length && (unsigned char)src[offset] != 0xFF : count > 0) {
+            if (!tail && idx == 0) {
+                return offset;
+            }
+            last = offset;
+            offset = cbor_skip(src, length, offset);
+            if (offset == 0) {
+                return 0;
+            }
+            if (!tail) {
+                idx--;
+            }
+            if (count != CBOR__INDEFINITE) {
+                count--;
+            }
+        }
+        if (tail) {
+            return last;
+        }
+    }
+    return 0;
+}
+
+/* return: 0 with the destination item's `offset` and encoded `size`, -1 if not found */
+int cbor_raw_pointer_get(const char *src, size_t length, const char *path, size_t *offset, size_t *size) {
+    size_t current = 0;
+    size_t next;
+
+    if (src == NULL || path == NULL || (path[0] != 0 && path[0] != '/')) {
+        return -1;
+    }
+
+    while (*path == '/') {
+        const char *tok = path + 1;
+        const char *end = strchr(tok, '/');
+        if (end == NULL) {
+            end = tok + strlen(tok);
+        }
+        current = cbor_raw_child(src, length, current, tok, end);
+        if (current == 0) {
+            return -1;
+        }
+        path = end;
+    }
+
+    next = cbor_skip(src, length, current);
+    if (next == 0) {
+        return -1;
+    }
+    if (offset) {
+        *offset = current;
+    }
+    if (size) {
+        *size = next - current;
+    }
+    return 0;
+}
+
+long long cbor_raw_pointer_geti(const char *src, size_t length, const char *path) {
+    size_t offset, size;
+    assert(path != NULL && path[0] == '/');
+    if (cbor_raw_pointer_get(src, length, path, &offset, &size)) {
+        return 0;
+    }
+    return cbor_raw_integer(src, offset + size, offset);
+}
+
+const char *cbor_raw_pointer_gets(const char *src, size_t length, const char *path, size_t *size) {
+    size_t offset, len;
+    assert(path != NULL && path[0] == '/');
+    if (cbor_raw_pointer_get(src, length, path, &offset, &len)) {
+        return NULL;
+    }
+    return cbor_raw_string(src, offset + len, offset, size);
+}
+
+bool cbor_raw_pointer_getb(const char *src, size_t length, const char *path) {
+    size_t offset, size;
+    assert(path != NULL && path[0] == '/');
+    if (cbor_raw_pointer_get(src, length, path, &offset, &size)) {
+        return false;
+    }
+    return cbor_raw_boolean(src, offset + size, offset);
+}
+
+double cbor_raw_pointer_getf(const char *src, size_t length, const char *path) {
+    size_t offset, size;
+    assert(path != NULL && path[0] == '/');
+    if (cbor_raw_pointer_get(src, length, path, &offset, &size)) {
+        return .0f;
+    }
+    return cbor_raw_real(src, offset + size, offset);
+}
@@ -1,6 +1,4 @@
-#include "cbor.h"
-#include <stdio.h>
-#include <string.h>
+#include "test.h"
 
 /***
  * json_pointer_insert('[1,2,3,4]','/-',99) → '[1,2,3,4,99]'
@@ -16,9 +14,6 @@
  * json_pointer_set('{"a":2,"c":4}', '/c', json_array(97,96)) → '{"a":2,"c":[97,96]}'
  */
 
-
-#define JSON(...) #__VA_ARGS__
-
 void insert_test(const char *input, const char *path, const char *value, const char *output) {
     size_t length;
     cbor_value_t *src = cbor_json_loads(input, -1);
@@ -27,6 +22,7 @@ void insert_test(const char *input, const char *path, const char *value, const c
     char *content = cbor_json_dumps(src, &length, false);
     if (strcmp(content, output)) {
         fprintf(stderr, "FAIL: cbor_pointer_insert('%s', '%s', '%s') -> '%s'\n", input, path, value, content);
+        failures++;
     } else {
         fprintf(stdout, "PASS: cbor_pointer_insert('%s', '%s', '%s') -> '%s'\n", input, path, value, content);
     }
@@ -45,6 +41,7 @@ void replace_test(const char *input, const char *path, const char *value, const
     char *content = cbor_json_dumps(src, &length, false);
     if (strcmp(content, output)) {
         fprintf(stderr, "FAIL: cbor_pointer_replace('%s', '%s', '%s') -> '%s'\n", input, path, value, content);
+        failures++;
     } else {
         fprintf(stdout, "PASS: cbor_pointer_replace('%s', '%s', '%s') -> '%s'\n", input, path, value, content);
     }
@@ -63,6 +60,7 @@ void set_test(const char *input, const char *path, const char *value, const char
     char *content = cbor_json_dumps(src, &length, false);
     if (strcmp(content, output)) {
         fprintf(stderr, "FAIL: cbor_pointer_set('%s', '%s', '%s') -> '%s'\n", input, path, value, content);
+        failures++;
     } else {
         fprintf(stdout, "PASS: cbor_pointer_set('%s', '%s', '%s') -> '%s'\n", input, path, value, content);
     }
@@ -81,6 +79,7 @@ void patch_test(const char *input, const char *value, const char *output) {
     char *content = cbor_json_dumps(src, &length, false);
     if (strcmp(content, output)) {
         fprintf(stderr, "FAIL: cbor_patch('%s', '%s') -> '%s'\n", input, value, content);
+        failures++;
     } else {
         fprintf(stdout, "PASS: cbor_patch('%s', '%s') -> '%s'\n", input, value, content);
     }
@@ -89,6 +88,52 @@ void patch_test(const char *input, const char *value, const char *output) {
     free(content);
 }
 
+void raw_get_test(const char *input, const char *path, const char *output) {
+    size_t length, size, offset;
+    char *content = NULL;
+    cbor_value_t *src = cbor_json_loads(input, -1);
+    char *raw = cbor_dumps(src, &length);
+    if (cbor_raw_pointer_get(raw, length, path, &offset, &size) == 0) {
+        cbor_value_t *val = cbor_loads(raw + offset, &size);
+        content = cbor_json_dumps(val, &length, false);
+        cbor_destroy(val);
+    }
+    if (strcmp(content ? content : "", output)) {
+        fprintf(stderr, "FAIL: cbor_raw_pointer_get('%s', '%s') -> '%s'\n", input, path, content ? content : "");
+        failures++;
+    } else {
+        fprintf(stdout, "PASS: cbor_raw_pointer_get('%s', '%s') -> '%s'\n", input, path, content ? content : "");
+    }
+    cbor_destroy(src);
+    free(content);
+    free(raw);
+}
+
+/* the encoded number and its decoded tree read back the same */
+void raw_number_test(const char *hex, long long integer, double real) {
+    char buf[16];
+    size_t length = 0;
+    unsigned int byte;
+    long long i, ti;
+    double d, td;
+    const char *ptr;
+    cbor_value_t *val;
+    for (ptr = hex; *ptr && sscanf(ptr, "%2x", &byte) == 1; ptr += 2) {
+        buf[length++] = (char)byte;
+    }
+    i = cbor_raw_integer(buf, length, 0);
+    d = cbor_raw_real(buf, length, 0);
+    val = cbor_loads(buf, &length);
+    ti = cbor_integer(val);
+    td = cbor_real(val);
+    cbor_destroy(val);
+    if (i != integer || (d != real && real == real) || ti != integer || (td != real && real == real)) {
+        fprintf(stderr, "FAIL: cbor_raw_integer/real('%s') -> %lld, %.17g, tree %lld, %.17g\n", hex, i, d, ti, td);
+        failures++;
+    } else {
+        fprintf(stdout, "PASS: cbor_raw_integer/real('%s') -> %lld, %.17g, tree %lld, %.17g\n", hex, i, d, ti, td);
+    }
+}
 
 int main(int argc, char **argv) {
     insert_test(JSON([1,2,3,4]), "/-", JSON(99), JSON([1, 2, 3, 4, 99]));
@@ -110,5 +155,26 @@ int main(int argc, char **argv) {
     patch_test(JSON([1,2]), JSON({"a":"b","c":null}), JSON({"a": "b"}));
     patch_test(JSON(["a", "b"]), JSON(["c", "d"]), JSON(["c", "d"]));
     patch_test(JSON({"a": "b"}), JSON(["c"]), JSON(["c"]));
-    return 0;
+    raw_get_test(JSON({"a":{"b":[1,2,3,{"c":true}]}}), "", JSON({"a": {"b": [1, 2, 3, {"c": true}]}}));
+    raw_get_test(JSON({"a":{"b":[1,2,3,{"c":true}]}}), "/a/b/2", JSON(3));
+    raw_get_test(JSON({"a":{"b":[1,2,3,{"c":true}]}}), "/a/b/-", JSON({"c": true}));
+    raw_get_test(JSON({"a":{"b":[1,2,3,{"c":true}]}}), "/a/b/3/c", JSON(true));
+    raw_get_test(JSON({"a":{"b":[1,2,3,{"c":true}]}}), "/a/b/4", "");
+    raw_get_test(JSON({"a":{"b":[1,2,3,{"c":true}]}}), "/a/c", "");
+    raw_get_test(JSON({"a/b":1,"m~n":2,"":3}), "/a~1b", JSON(1));
+    raw_get_test(JSON({"a/b":1,"m~n":2,"":3}), "/m~0n", JSON(2));
+    raw_get_test(JSON({"a/b":1,"m~n":2,"":3}), "/", JSON(3));
+    raw_number_test("17", 23, 23.0);
+    raw_number_test("3903e7", -1000, -1000.0);
+    raw_number_test("20", -1, -1.0);
+    raw_number_test("1b7fffffffffffffff", 9223372036854775807LL, 9223372036854775807.0);
+    raw_number_test("1bffffffffffffffff", 9223372036854775807LL, 18446744073709551615.0);
+    raw_number_test("3b7fffffffffffffff", -9223372036854775807LL - 1, -9223372036854775808.0);
+    raw_number_test("3bffffffffffffffff", -9223372036854775807LL - 1, -18446744073709551616.0);
+    raw_number_test("f93e00", 1, 1.5);
+    raw_number_test("fbc3e0000000000000", -9223372036854775807LL - 1, -9223372036854775808.0);
+    raw_number_test("fb7e37e43c8800759c", 9223372036854775807LL, 1e300);
+    raw_number_test("fbfe37e43c8800759c", -9223372036854775807LL - 1, -1e300);
+    raw_number_test("f97e00", 0, 0.0 / 0.0);
+    return failures != 0;
 }
@@ -0,0 +1,752 @@
+#include "cbor.h"
+#include <string.h>
+#include "define.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CBOR_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+/* the implementations for this CPU are picked once, for every thread */
+static void cbor_simd_init(void);
+#ifndef _WIN32
+#include <pthread.h>
+static pthread_once_t cbor_simd_once = PTHREAD_ONCE_INIT;
+#define CBOR_SIMD_ONCE() pthread_once(&cbor_simd_once, cbor_simd_init)
+#else
+#include <windows.h>
+static INIT_ONCE cbor_simd_once = INIT_ONCE_STATIC_INIT;
+static BOOL CALLBACK cbor_simd_init_once(PINIT_ONCE once, PVOID param, PVOID *context) {
+    cbor_simd_init();
+    return TRUE;
+}
+#define CBOR_SIMD_ONCE() InitOnceExecuteOnce(&cbor_simd_once, cbor_simd_init_once, NULL, NULL)
+#endif
+
+/*
+ * JSON stage 1, after simdjson: every 64 input bytes are classified into
+ * bitmasks at once, string interiors are masked out with a prefix xor over
+ * the unescaped quotes, and what remains is the offset of every token start:
+ * structural characters, opening quotes and the first byte of each scalar.
+ */
+
+typedef struct {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t space;
+    uint64_t op;
+} json_block_t;
+
+typedef void (*json_classify_fn)(const uint8_t *ptr, json_block_t *block);
+static json_classify_fn json_classify;
+
+/* whitespace as lexer_skip_whitespace sees it: isspace() in the C locale */
+static bool json_is_space(uint8_t ch) {
+    return ch == ' ' || (ch >= '\t' && ch <= '\r');
+}
+
+static bool json_is_op(uint8_t ch) {
+    return ch == '{' || ch == '}' || ch == '[' || ch == ']' || ch == ':' || ch == ',';
+}
+
+static void json_classify_scalar(const uint8_t *ptr, json_block_t *block) {
+    int i;
+    memset(block, 0, sizeof(json_block_t));
+    for (i = 0; i < 64; i++) {
+        uint64_t bit = (uint64_t)1 << i;
+        if (ptr[i] == '"') {
+            block->quote |= bit;
+        } else if (ptr[i] == '\\') {
+            block->backslash |= bit;
+        } else if (json_is_space(ptr[i])) {
+            block->space |= bit;
+        } else if (json_is_op(ptr[i])) {
+            block->op |= bit;
+        }
+    }
+}
+
+#ifdef CBOR_SIMD_X86
+__attribute__((target("sse2")))
+static void json_classify_sse2(const uint8_t *ptr, json_block_t *block) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+    int i;
+
+    memset(block, 0, sizeof(json_block_t));
+    for (i = 0; i < 64; i += 16) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(ptr + i));
+        __m128i ctrl = _mm_sub_epi8(in, tab);
+        __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(in, space),
+                                  _mm_cmpeq_epi8(_mm_min_epu8(ctrl, four), ctrl));
+        __m128i op = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('{')), _mm_cmpeq_epi8(in, _mm_set1_epi8('}'))),
+            _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('[')), _mm_cmpeq_epi8(in, _mm_set1_epi8(']'))),
+                _mm_or_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8(':')), _mm_cmpeq_epi8(in, _mm_set1_epi8(',')))));
+        block->quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(in, quote)) << i;
+        block->backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(in, backslash)) << i;
+        block->space |= (uint64_t)(uint16_t)_mm_movemask_epi8(ws) << i;
+        block->op |= (uint64_t)(uint16_t)_mm_movemask_epi8(op) << i;
+    }
+}
+
+__attribute__((target("avx2")))
+static void json_classify_avx2(const uint8_t *ptr, json_block_t *block) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i four = _mm256_set1_epi8(4);
+    int i;
+
+    memset(block, 0, sizeof(json_block_t));
+    for (i = 0; i < 64; i += 32) {
+        __m256i in = _mm256_loadu_si256((const __m256i *)(ptr + i));
+        __m256i ctrl = _mm256_sub_epi8(in, tab);
+        __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(in, space),
+                                     _mm256_cmpeq_epi8(_mm256_min_epu8(ctrl, four), ctrl));
+        __m256i op = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(in, _mm256_set1_epi8('}'))),
+            _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8('[')), _mm256_cmpeq_epi8(in, _mm256_set1_epi8(']'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(in, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(in, _mm256_set1_epi8(',')))));
+        block->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(in, quote)) << i;
+        block->backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(in, backslash)) << i;
+        block->space |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ws) << i;
+        block->op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op) << i;
+    }
+}
+#endif
+
+static json_classify_fn json_classify_select(void) {
+#ifdef CBOR_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return json_classify_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return json_classify_sse2;
+    }
+#endif
+    return json_classify_scalar;
+}
+
+/* bit i set: byte i follows an odd run of backslashes, `carry` is set when
+ * the previous block ended inside such a run */
+static uint64_t json_escaped(uint64_t backslash, uint64_t *carry) {
+    const uint64_t even = 0x5555555555555555ULL;
+    const uint64_t odd = ~even;
+    uint64_t start_edges = backslash & ~(backslash << 1);
+    uint64_t even_start_mask = even ^ *carry;
+    uint64_t even_starts = start_edges & even_start_mask;
+    uint64_t odd_starts = start_edges & ~even_start_mask;
+    uint64_t even_carries = backslash + even_starts;
+    uint64_t odd_carries = backslash + odd_starts;
+    uint64_t ends_odd = odd_carries < backslash;
+
+    odd_carries |= *carry;
+    *carry = ends_odd;
+    even_carries &= ~backslash;
+    odd_carries &= ~backslash;
+    return (even_carries & odd) | (odd_carries & even);
+}
+
+static uint64_t json_prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+int json__index_init(json__index_t *index, const char *src, size_t length) {
+    memset(index, 0, sizeof(json__index_t));
+    index->offsets = (uint32_t *)malloc(sizeof(uint32_t) * JSON_INDEX_WINDOW);
+    if (index->offsets == NULL) {
+        return -1;
+    }
+    index->src = src;
+    index->length = length;
+    return 0;
+}
+
+/* index the next window, carrying string and escape state across windows
+ * return: 0 when a window was indexed, -1 at the end of input */
+int json__index_next(json__index_t *index) {
+    uint8_t tail[64];
+    size_t offset, end;
+
+    if (index->next >= index->length) {
+        return -1;
+    }
+    CBOR_SIMD_ONCE();
+    index->base = index->next;
+    index->count = 0;
+    end = index->length - index->base < JSON_INDEX_WINDOW ? index->length : index->base + JSON_INDEX_WINDOW;
+    for (offset = index->base; offset < end; offset += 64) {
+        const uint8_t *ptr = (const uint8_t *)index->src + offset;
+        json_block_t block;
+        uint64_t escaped, quote, string, scalar, starts;
+
+        if (end - offset < 64) {
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, ptr, end - offset);
+            ptr = tail;
+        }
+        json_classify(ptr, &block);
+
+        escaped = json_escaped(block.backslash, &index->escape_carry);
+        quote = block.quote & ~escaped;
+        /* opening quote and interior set, closing quote clear */
+        string = json_prefix_xor(quote) ^ index->string_carry;
+        index->string_carry = (uint64_t)((int64_t)string >> 63);
+
+        scalar = ~(block.space | block.op | quote | string);
+        starts = (block.op & ~string)
+                 | (quote & string)
+                 | (scalar & ~((scalar << 1) | index->scalar_carry));
+        index->scalar_carry = scalar >> 63;
+
+        while (starts) {
+            index->offsets[index->count++] = (uint32_t)(offset - index->base + cbor__ctz64(starts));
+            starts &= starts - 1;
+        }
+    }
+    index->next = end;
+    return 0;
+}
+
+void json__index_release(json__index_t *index) {
+    free(index->offsets);
+    memset(index, 0, sizeof(json__index_t));
+}
+
+/*
+ * String scanning: first byte in [ptr, end) that ends a plain run inside a
+ * JSON string, i.e. a quote, a backslash or a control character.
+ */
+typedef const char *(*json_scan_fn)(const char *ptr, const char *end);
+static json_scan_fn json_string_scan;
+static json_scan_fn json_space_scan;
+static json_scan_fn json_skip_scan;
+
+static const char *json_string_scan_scalar(const char *ptr, const char *end) {
+    while (ptr < end) {
+        unsigned char ch = (unsigned char)*ptr;
+        if (ch == '"' || ch == '\\' || ch < 0x20) {
+            break;
+        }
+        ptr++;
+    }
+    return ptr;
+}
+
+#ifdef CBOR_SIMD_X86
+__attribute__((target("sse2")))
+static const char *json_string_scan_sse2(const char *ptr, const char *end) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i ctrl = _mm_set1_epi8(0x1F);
+
+    while (end - ptr >= 16) {
+        __m128i in = _mm_loadu_si128((const __m128i *)ptr);
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(in, quote), _mm_cmpeq_epi8(in, backslash)),
+                                   _mm_cmpeq_epi8(_mm_min_epu8(in, ctrl), in));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask) {
+            return ptr + cbor__ctz32(mask);
+        }
+        ptr += 16;
+    }
+    return json_string_scan_scalar(ptr, end);
+}
+
+__attribute__((target("avx2")))
+static const char *json_string_scan_avx2(const char *ptr, const char *end) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i ctrl = _mm256_set1_epi8(0x1F);
+
+    while (end - ptr >= 32) {
+        __m256i in = _mm256_loadu_si256((const __m256i *)ptr);
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(in, quote), _mm256_cmpeq_epi8(in, backslash)),
+                                      _mm256_cmpeq_epi8(_mm256_min_epu8(in, ctrl), in));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(hit);
+        if (mask) {
+            return ptr + cbor__ctz32(mask);
+        }
+        ptr += 32;
+    }
+    return json_string_scan_sse2(ptr, end);
+}
+#endif
+
+static json_scan_fn json_string_scan_select(void) {
+#ifdef CBOR_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return json_string_scan_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return json_string_scan_sse2;
+    }
+#endif
+    return json_string_scan_scalar;
+}
+
+const char *json__string_scan(const char *ptr, const char *end) {
+    CBOR_SIMD_ONCE();
+    return json_string_scan(ptr, end);
+}
+
+/*
+ * Whitespace scanning: first byte in [ptr, end) that is not JSON whitespace,
+ * for indentation runs in pretty-printed input.
+ */
+static const char *json_space_scan_scalar(const char *ptr, const char *end) {
+    while (ptr < end && json_is_space((uint8_t)*ptr)) {
+        ptr++;
+    }
+    return ptr;
+}
+
+#ifdef CBOR_SIMD_X86
+__attribute__((target("sse2")))
+static const char *json_space_scan_sse2(const char *ptr, const char *end) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+
+    while (end - ptr >= 16) {
+        __m128i in = _mm_loadu_si128((const __m128i *)ptr);
+        __m128i ctrl = _mm_sub_epi8(in, tab);
+        __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(in, space),
+                                  _mm_cmpeq_epi8(_mm_min_epu8(ctrl, four), ctrl));
+        int mask = ~_mm_movemask_epi8(ws) & 0xFFFF;
+        if (mask) {
+            return ptr + cbor__ctz32(mask);
+        }
+        ptr += 16;
+    }
+    return json_space_scan_scalar(ptr, end);
+}
+
+__attribute__((target("avx2")))
+static const char *json_space_scan_avx2(const char *ptr, const char *end) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i four = _mm256_set1_epi8(4);
+
+    while (end - ptr >= 32) {
+        __m256i in = _mm256_loadu_si256((const __m256i *)ptr);
+        __m256i ctrl = _mm256_sub_epi8(in, tab);
+        __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(in, space),
+                                     _mm256_cmpeq_epi8(_mm256_min_epu8(ctrl, four), ctrl));
+        uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(ws);
+        if (mask) {
+            return ptr + cbor__ctz32(mask);
+        }
+        ptr += 32;
+    }
+    return json_space_scan_sse2(ptr, end);
+}
+#endif
+
+static json_scan_fn json_space_scan_select(void) {
+#ifdef CBOR_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return json_space_scan_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return json_space_scan_sse2;
+    }
+#endif
+    return json_space_scan_scalar;
+}
+
+const char *json__space_scan(const char *ptr, const char *end) {
+    CBOR_SIMD_ONCE();
+    return json_space_scan(ptr, end);
+}
+
+/*
+ * Skip scanning: first byte in [ptr, end) that matters when passing over a
+ * JSON subtree: a quote, a bracket or a comment start.
+ */
+static const char *json_skip_scan_scalar(const char *ptr, const char *end) {
+    while (ptr < end) {
+        unsigned char ch = (unsigned char)*ptr | 0x20;
+        if (ch == '{' || ch == '}' || *ptr == '"' || *ptr == '/' || *ptr == '#') {
+            break;
+        }
+        ptr++;
+    }
+    return ptr;
+}
+
+#ifdef CBOR_SIMD_X86
+/* '[' and ']' differ from '{' and '}' only in bit 0x20 */
+__attribute__((target("sse2")))
+static const char *json_skip_scan_sse2(const char *ptr, const char *end) {
+    const __m128i bit = _mm_set1_epi8(0x20);
+    const __m128i open = _mm_set1_epi8('{');
+    const __m128i close = _mm_set1_epi8('}');
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i slash = _mm_set1_epi8('/');
+    const __m128i hash = _mm_set1_epi8('#');
+
+    while (end - ptr >= 16) {
+        __m128i in = _mm_loadu_si128((const __m128i *)ptr);
+        __m128i folded = _mm_or_si128(in, bit);
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(folded, open), _mm_cmpeq_epi8(folded, close)),
+                                   _mm_or_si128(_mm_cmpeq_epi8(in, quote),
+                                                _mm_or_si128(_mm_cmpeq_epi8(in, slash), _mm_cmpeq_epi8(in, hash))));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask) {
+            return ptr + cbor__ctz32(mask);
+        }
+        ptr += 16;
+    }
+    return json_skip_scan_scalar(ptr, end);
+}
+
+__attribute__((target("avx2")))
+static const char *json_skip_scan_avx2(const char *ptr, const char *end) {
+    const __m256i bit = _mm256_set1_epi8(0x20);
+    const __m256i open = _mm256_set1_epi8('{');
+    const __m256i close = _mm256_set1_epi8('}');
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i slash = _mm256_set1_epi8('/');
+    const __m256i hash = _mm256_set1_epi8('#');
+
+    while (end - ptr >= 32) {
+        __m256i in = _mm256_loadu_si256((const __m256i *)ptr);
+        __m256i folded = _mm256_or_si256(in, bit);
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(folded, open), _mm256_cmpeq_epi8(folded, close)),
+                                      _mm256_or_si256(_mm256_cmpeq_epi8(in, quote),
+                                                      _mm256_or_si256(_mm256_cmpeq_epi8(in, slash), _mm256_cmpeq_epi8(in, hash))));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(hit);
+        if (mask) {
+            return ptr + cbor__ctz32(mask);
+        }
+        ptr += 32;
+    }
+    return json_skip_scan_sse2(ptr, end);
+}
+#endif
+
+static json_scan_fn json_skip_scan_select(void) {
+#ifdef CBOR_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return json_skip_scan_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return json_skip_scan_sse2;
+    }
+#endif
+    return json_skip_scan_scalar;
+}
+
+const char *json__skip_scan(const char *ptr, const char *end) {
+    CBOR_SIMD_ONCE();
+    return json_skip_scan(ptr, end);
+}
+
+/*
+ * UTF-8 validation after Keiser and Lemire, "Validating UTF-8 in less than
+ * one instruction per byte": three nibble lookups classify each byte pair,
+ * a saturating subtraction marks where the 3rd and 4th bytes of a sequence
+ * are due. The vector code only answers whether a block is clean, the first
+ * bad byte is then located by the scalar code.
+ */
+#define CBOR_UTF8_TOO_SHORT  (1 << 0)   /* lead or ASCII, then a lead or ASCII */
+#define CBOR_UTF8_TOO_LONG   (1 << 1)   /* ASCII, then a continuation */
+#define CBOR_UTF8_OVERLONG_3 (1 << 2)   /* 11100000 100_____ */
+#define CBOR_UTF8_TOO_LARGE  (1 << 3)   /* above U+10FFFF */
+#define CBOR_UTF8_SURROGATE  (1 << 4)   /* 11101101 101_____ */
+#define CBOR_UTF8_OVERLONG_2 (1 << 5)   /* 1100000_ 10______ */
+#define CBOR_UTF8_OVERLONG_4 (1 << 6)   /* 11110000 1000____, also above U+10FFFF with 1000____ */
+#define CBOR_UTF8_TWO_CONTS  (1 << 7)   /* continuation, then a continuation */
+#define CBOR_UTF8_CARRY      (CBOR_UTF8_TOO_SHORT | CBOR_UTF8_TOO_LONG | CBOR_UTF8_TWO_CONTS)
+
+/* offset of the first byte of the first malformed sequence from `offset` on,
+ * which must be the start of a character */
+static size_t cbor_utf8_check_scalar(const uint8_t *ptr, size_t offset, size_t length) {
+    while (offset < length) {
+        uint8_t ch = ptr[offset];
+        uint8_t lo = 0x80, hi = 0xBF;
+        size_t need, i;
+
+        if (ch < 0x80) {
+            uint64_t word;
+            if (length - offset >= 8) {
+                memcpy(&word, ptr + offset, 8);
+                if ((word & 0x8080808080808080ULL) == 0) {
+                    offset += 8;
+                    continue;
+                }
+            }
+            offset++;
+            continue;
+        }
+        if (ch >= 0xC2 && ch <= 0xDF) {
+            need = 1;
+        } else if (ch >= 0xE0 && ch <= 0xEF) {
+            need = 2;
+            if (ch == 0xE0) {
+                lo = 0xA0;
+            } else if (ch == 0xED) {
+                hi = 0x9F;
+            }
+        } else if (ch >= 0xF0 && ch <= 0xF4) {
+            need = 3;
+            if (ch == 0xF0) {
+                lo = 0x90;
+            } else if (ch == 0xF4) {
+                hi = 0x8F;
+            }
+        } else {
+            return offset;
+        }
+        if (length - offset <= need || ptr[offset + 1] < lo || ptr[offset + 1] > hi) {
+            return offset;
+        }
+        for (i = 2; i <= need; i++) {
+            if ((ptr[offset + i] & 0xC0) != 0x80) {
+                return offset;
+            }
+        }
+        offset += need + 1;
+    }
+    return length;
+}
+
+/* scalar restart for a vector block at `offset` that failed: sequences end
+ * within 3 bytes after a clean block, so its predecessor is checked again
+ * from the character it starts in */
+static size_t cbor_utf8_locate(const uint8_t *ptr, size_t offset, size_t width, size_t length) {
+    size_t start = offset > width ? offset - width : 0;
+    while (start > 0 && (ptr[start] & 0xC0) == 0x80) {
+        start--;
+    }
+    return cbor_utf8_check_scalar(ptr, start, length);
+}
+
+#ifdef CBOR_SIMD_X86
+__attribute__((target("ssse3")))
+static __m128i cbor_utf8_block_ssse3(__m128i in, __m128i prev) {
+    const __m128i byte_1_high = _mm_setr_epi8(
+        CBOR_UTF8_TOO_LONG, CBOR_UTF8_TOO_LONG, CBOR_UTF8_TOO_LONG, CBOR_UTF8_TOO_LONG,
+        CBOR_UTF8_TOO_LONG, CBOR_UTF8_TOO_LONG, CBOR_UTF8_TOO_LONG, CBOR_UTF8_TOO_LONG,
+        (char)CBOR_UTF8_TWO_CONTS, (char)CBOR_UTF8_TWO_CONTS, (char)CBOR_UTF8_TWO_CONTS, (char)CBOR_UTF8_TWO_CONTS,
+        CBOR_UTF8_TOO_SHORT | CBOR_UTF8_OVERLONG_2,
+        CBOR_UTF8_TOO_SHORT,
+        CBOR_UTF8_TOO_SHORT | CBOR_UTF8_OVERLONG_3 | CBOR_UTF8_SURROGATE,
+        CBOR_UTF8_TOO_SHORT | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4);
+    const __m128i byte_1_low = _mm_setr_epi8(
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_OVERLONG_3 | CBOR_UTF8_OVERLONG_2 | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_OVERLONG_2),
+        (char)CBOR_UTF8_CARRY, (char)CBOR_UTF8_CARRY,
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4 | CBOR_UTF8_SURROGATE),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4));
+    const __m128i byte_2_high = _mm_setr_epi8(
+        CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT,
+        CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT,
+        (char)(CBOR_UTF8_TOO_LONG | CBOR_UTF8_OVERLONG_2 | CBOR_UTF8_TWO_CONTS | CBOR_UTF8_OVERLONG_3 | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_TOO_LONG | CBOR_UTF8_OVERLONG_2 | CBOR_UTF8_TWO_CONTS | CBOR_UTF8_OVERLONG_3 | CBOR_UTF8_TOO_LARGE),
+        (char)(CBOR_UTF8_TOO_LONG | CBOR_UTF8_OVERLONG_2 | CBOR_UTF8_TWO_CONTS | CBOR_UTF8_SURROGATE | CBOR_UTF8_TOO_LARGE),
+        (char)(CBOR_UTF8_TOO_LONG | CBOR_UTF8_OVERLONG_2 | CBOR_UTF8_TWO_CONTS | CBOR_UTF8_SURROGATE | CBOR_UTF8_TOO_LARGE),
+        CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i prev1 = _mm_alignr_epi8(in, prev, 15);
+    __m128i prev2 = _mm_alignr_epi8(in, prev, 14);
+    __m128i prev3 = _mm_alignr_epi8(in, prev, 13);
+    __m128i special = _mm_and_si128(
+        _mm_and_si128(_mm_shuffle_epi8(byte_1_high, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                      _mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, nibble))),
+        _mm_shuffle_epi8(byte_2_high, _mm_and_si128(_mm_srli_epi16(in, 4), nibble)));
+    __m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8((char)(0xE0 - 0x80)));
+    __m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xF0 - 0x80)));
+    __m128i must = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8((char)0x80));
+    return _mm_xor_si128(must, special);
+}
+
+__attribute__((target("ssse3")))
+static size_t cbor_utf8_check_ssse3(const char *ptr, size_t length) {
+    /* a lead byte too close to the end of a block to be complete in it */
+    const __m128i last = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                       (char)0xEF, (char)0xDF, (char)0xBF);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i prev = zero;
+    __m128i incomplete = zero;
+    uint8_t tail[16];
+    size_t offset = 0;
+
+    for (;;) {
+        __m128i in, error;
+        if (length - offset >= 16) {
+            in = _mm_loadu_si128((const __m128i *)(ptr + offset));
+        } else {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, ptr + offset, length - offset);
+            in = _mm_loadu_si128((const __m128i *)tail);
+        }
+        if (_mm_movemask_epi8(in) == 0) {
+            error = incomplete;
+        } else {
+            error = cbor_utf8_block_ssse3(in, prev);
+            incomplete = _mm_subs_epu8(in, last);
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, zero)) != 0xFFFF) {
+            return cbor_utf8_locate((const uint8_t *)ptr, offset, 16, length);
+        }
+        /* a padded block ends the input, so does a lead byte it would leave open */
+        if (length - offset < 16) {
+            return length;
+        }
+        prev = in;
+        offset += 16;
+    }
+}
+
+/* the previous 1, 2 or 3 bytes across the lane boundary and the block boundary */
+#define CBOR_UTF8_PREV_AVX2(in, prev, n) \
+    _mm256_alignr_epi8(in, _mm256_permute2x128_si256(prev, in, 0x21), 16 - (n))
+
+__attribute__((target("avx2")))
+static __m256i cbor_utf8_block_avx2(__m256i in, __m256i prev) {
+    const __m256i byte_1_high = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        CBOR_UTF8_TOO_LONG, CBOR_UTF8_TOO_LONG, CBOR_UTF8_TOO_LONG, CBOR_UTF8_TOO_LONG,
+        CBOR_UTF8_TOO_LONG, CBOR_UTF8_TOO_LONG, CBOR_UTF8_TOO_LONG, CBOR_UTF8_TOO_LONG,
+        (char)CBOR_UTF8_TWO_CONTS, (char)CBOR_UTF8_TWO_CONTS, (char)CBOR_UTF8_TWO_CONTS, (char)CBOR_UTF8_TWO_CONTS,
+        CBOR_UTF8_TOO_SHORT | CBOR_UTF8_OVERLONG_2,
+        CBOR_UTF8_TOO_SHORT,
+        CBOR_UTF8_TOO_SHORT | CBOR_UTF8_OVERLONG_3 | CBOR_UTF8_SURROGATE,
+        CBOR_UTF8_TOO_SHORT | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4));
+    const __m256i byte_1_low = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_OVERLONG_3 | CBOR_UTF8_OVERLONG_2 | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_OVERLONG_2),
+        (char)CBOR_UTF8_CARRY, (char)CBOR_UTF8_CARRY,
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4 | CBOR_UTF8_SURROGATE),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_CARRY | CBOR_UTF8_TOO_LARGE | CBOR_UTF8_OVERLONG_4)));
+    const __m256i byte_2_high = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT,
+        CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT,
+        (char)(CBOR_UTF8_TOO_LONG | CBOR_UTF8_OVERLONG_2 | CBOR_UTF8_TWO_CONTS | CBOR_UTF8_OVERLONG_3 | CBOR_UTF8_OVERLONG_4),
+        (char)(CBOR_UTF8_TOO_LONG | CBOR_UTF8_OVERLONG_2 | CBOR_UTF8_TWO_CONTS | CBOR_UTF8_OVERLONG_3 | CBOR_UTF8_TOO_LARGE),
+        (char)(CBOR_UTF8_TOO_LONG | CBOR_UTF8_OVERLONG_2 | CBOR_UTF8_TWO_CONTS | CBOR_UTF8_SURROGATE | CBOR_UTF8_TOO_LARGE),
+        (char)(CBOR_UTF8_TOO_LONG | CBOR_UTF8_OVERLONG_2 | CBOR_UTF8_TWO_CONTS | CBOR_UTF8_SURROGATE | CBOR_UTF8_TOO_LARGE),
+        CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT, CBOR_UTF8_TOO_SHORT));
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i prev1 = CBOR_UTF8_PREV_AVX2(in, prev, 1);
+    __m256i prev2 = CBOR_UTF8_PREV_AVX2(in, prev, 2);
+    __m256i prev3 = CBOR_UTF8_PREV_AVX2(in, prev, 3);
+    __m256i special = _mm256_and_si256(
+        _mm256_and_si256(_mm256_shuffle_epi8(byte_1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                         _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, nibble))),
+        _mm256_shuffle_epi8(byte_2_high, _mm256_and_si256(_mm256_srli_epi16(in, 4), nibble)));
+    __m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    __m256i must = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must, special);
+}
+
+__attribute__((target("avx2")))
+static size_t cbor_utf8_check_avx2(const char *ptr, size_t length) {
+    const __m256i last = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          (char)0xEF, (char)0xDF, (char)0xBF);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i prev = zero;
+    __m256i incomplete = zero;
+    uint8_t tail[32];
+    size_t offset = 0;
+
+    for (;;) {
+        __m256i in, error;
+        if (length - offset >= 32) {
+            in = _mm256_loadu_si256((const __m256i *)(ptr + offset));
+        } else {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, ptr + offset, length - offset);
+            in = _mm256_loadu_si256((const __m256i *)tail);
+        }
+        if (_mm256_movemask_epi8(in) == 0) {
+            error = incomplete;
+        } else {
+            error = cbor_utf8_block_avx2(in, prev);
+            incomplete = _mm256_subs_epu8(in, last);
+        }
+        if (!_mm256_testz_si256(error, error)) {
+            return cbor_utf8_locate((const uint8_t *)ptr, offset, 32, length);
+        }
+        /* a padded block ends the input, so does a lead byte it would leave open */
+        if (length - offset < 32) {
+            return length;
+        }
+        prev = in;
+        offset += 32;
+    }
+}
+#endif
+
+static size_t cbor_utf8_check_fallback(const char *ptr, size_t length) {
+    return cbor_utf8_check_scalar((const uint8_t *)ptr, 0, length);
+}
+
+typedef size_t (*cbor_utf8_fn)(const char *ptr, size_t length);
+static cbor_utf8_fn cbor_utf8_check;
+
+static cbor_utf8_fn cbor_utf8_select(void) {
+#ifdef CBOR_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return cbor_utf8_check_avx2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return cbor_utf8_check_ssse3;
+    }
+#endif
+    return cbor_utf8_check_fallback;
+}
+
+size_t cbor__utf8_check(const char *ptr, size_t length) {
+    CBOR_SIMD_ONCE();
+    return cbor_utf8_check(ptr, length);
+}
+
+static void cbor_simd_init(void) {
+    json_classify = json_classify_select();
+    json_string_scan = json_string_scan_select();
+    json_space_scan = json_space_scan_select();
+    json_skip_scan = json_skip_scan_select();
+    cbor_utf8_check = cbor_utf8_select();
+}
@@ -0,0 +1,73 @@
+#include "test.h"
+
+void item_length_test(const char *hex, size_t offset, size_t output) {
+    char buf[256];
+    size_t length = unhex(hex, buf);
+    size_t result = cbor_item_length(buf, length, offset);
+    if (result != output) {
+        fprintf(stderr, "FAIL: cbor_item_length('%s', %zu) -> %zu, expect %zu\n", hex, offset, result, output);
+        failures++;
+    } else {
+        fprintf(stdout, "PASS: cbor_item_length('%s', %zu) -> %zu\n", hex, offset, result);
+    }
+}
+
+/* every item of an encoded document: the whole length, 0 for each truncation */
+void dumps_skip_test(const char *input) {
+    size_t length, i;
+    cbor_value_t *src = cbor_json_loads(input, -1);
+    char *raw = cbor_dumps(src, &length);
+    size_t result = cbor_skip(raw, length, 0);
+    bool ok = result == length;
+    for (i = 0; i < length && ok; i++) {
+        ok = cbor_skip(raw, i, 0) == 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "FAIL: cbor_skip(cbor_dumps('%s')) -> %zu of %zu\n", input, result, length);
+        failures++;
+    } else {
+        fprintf(stdout, "PASS: cbor_skip(cbor_dumps('%s')) -> %zu\n", input, result);
+    }
+    cbor_destroy(src);
+    free(raw);
+}
+
+int main(int argc, char **argv) {
+    item_length_test("00", 0, 1);
+    item_length_test("1817", 0, 2);
+    item_length_test("1903e8", 0, 3);
+    item_length_test("1b000000e8d4a51000", 0, 9);
+    item_length_test("3903e7", 0, 3);
+    item_length_test("f97e00", 0, 3);
+    item_length_test("fb3ff199999999999a", 0, 9);
+    item_length_test("6449455446", 0, 5);
+    item_length_test("83010203", 0, 4);
+    item_length_test("83010203", 2, 1);
+    item_length_test("a26161016162820203", 0, 9);
+    item_length_test("c11a514b67b0", 0, 6);
+    /* indefinite strings, arrays and maps */
+    item_length_test("7f657374726561646d696e67ff", 0, 13);
+    item_length_test("5f42010243030405ff", 0, 9);
+    item_length_test("9f018202039f0405ffff", 0, 10);
+    item_length_test("bf6346756ef563416d7421ff", 0, 12);
+    item_length_test("829f01ff9f02ff", 0, 7);
+    /* truncated and malformed */
+    item_length_test("", 0, 0);
+    item_length_test("19", 0, 0);
+    item_length_test("64494554", 0, 0);
+    item_length_test("830102", 0, 0);
+    item_length_test("9f0102", 0, 0);
+    item_length_test("ff", 0, 0);
+    item_length_test("1c", 0, 0);
+    item_length_test("1f", 0, 0);
+    item_length_test("7f4101ff", 0, 0);
+    item_length_test("7f7f6161ffff", 0, 0);
+    item_length_test("9bffffffffffffffff00", 0, 0);
+    item_length_test("bbffffffffffffffff00", 0, 0);
+    item_length_test("dfa0", 0, 0);
+    dumps_skip_test(JSON(null));
+    dumps_skip_test(JSON([1, -1, 1.5, 1e300, "a", "", true, false, null]));
+    dumps_skip_test(JSON({"a": {"b": [1, 2, 3, {"c": true}]}, "d": [[[[]]]], "e": {}}));
+    dumps_skip_test(JSON([18446744073709551615, -18446744073709551616, 4294967296, 65536, 256, 24]));
+    return failures != 0;
+}
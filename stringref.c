@@ -0,0 +1,390 @@
+#include "cbor.h"
+#include <assert.h>
+#include <string.h>
+#include "define.h"
+
+/* strings of one namespace in order of appearance; the encoder also keeps
+ * an open addressing index over them (slot holds string index + 1) */
+typedef struct {
+    const cbor_value_t **strings;
+    size_t count;
+    size_t allocated;
+    uint32_t *slots;
+    size_t mask;
+} cbor_stringref_t;
+
+typedef struct {
+    cbor_stringref_t refs;
+    char *ptr;      /* NULL while sizing */
+    size_t size;
+    int flags;
+    int error;
+} cbor_stringref_writer_t;
+
+/* a string gets an index only if a reference to that index is shorter than it */
+static size_t cbor_stringref_min_length(size_t index) {
+    if (index < 24) {
+        return 3;
+    } else if (index < 256) {
+        return 4;
+    } else if (index < 65536) {
+        return 5;
+    } else if (index < 4294967296ULL) {
+        return 7;
+    }
+    return 11;
+}
+
+static uint32_t cbor_stringref_hash(const cbor_value_t *str) {
+    uint32_t hash = 2166136261u ^ str->type;
+    size_t i;
+    for (i = 0; i < str->blob.length; i++) {
+        hash = (hash ^ (unsigned char)str->blob.ptr[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool cbor_stringref_equal(const cbor_value_t *a, const cbor_value_t *b) {
+    return a->type == b->type
+        && a->blob.length == b->blob.length
+        && memcmp(a->blob.ptr, b->blob.ptr, a->blob.length) == 0;
+}
+
+static void cbor_stringref_release(cbor_stringref_t *refs) {
+    free(refs->strings);
+    free(refs->slots);
+    memset(refs, 0, sizeof(cbor_stringref_t));
+}
+
+static int cbor_stringref_rehash(cbor_stringref_t *refs) {
+    size_t size = refs->mask ? (refs->mask + 1) * 2 : 64;
+    uint32_t *slots = (uint32_t *)calloc(size, sizeof(uint32_t));
+    size_t i;
+
+    if (slots == NULL) {
+        return -1;
+    }
+    for (i = 0; i < refs->count; i++) {
+        size_t slot = cbor_stringref_hash(refs->strings[i]) & (size - 1);
+        while (slots[slot]) {
+            slot = (slot + 1) & (size - 1);
+        }
+        slots[slot] = i + 1;
+    }
+    free(refs->slots);
+    refs->slots = slots;
+    refs->mask = size - 1;
+    return 0;
+}
+
+/* return: index of the first equal string, -1 if none */
+static long long cbor_stringref_find(const cbor_stringref_t *refs, const cbor_value_t *str) {
+    size_t slot;
+    if (refs->slots == NULL) {
+        return -1;
+    }
+    slot = cbor_stringref_hash(str) & refs->mask;
+    while (refs->slots[slot]) {
+        uint32_t index = refs->slots[slot] - 1;
+        if (cbor_stringref_equal(refs->strings[index], str)) {
+            return index;
+        }
+        slot = (slot + 1) & refs->mask;
+    }
+    return -1;
+}
+
+/* index `str` if it is long enough, `indexed` also keeps the hash index */
+static int cbor_stringref_add(cbor_stringref_t *refs, const cbor_value_t *str, bool indexed) {
+    if (str->blob.length < cbor_stringref_min_length(refs->count)) {
+        return 0;
+    }
+    if (refs->count == refs->allocated) {
+        size_t allocated = refs->allocated ? refs->allocated * 2 : 32;
+        const cbor_value_t **tmp = (const cbor_value_t **)realloc(refs->strings, sizeof(cbor_value_t *) * allocated);
+        if (tmp == NULL) {
+            return -1;
+        }
+        refs->strings = tmp;
+        refs->allocated = allocated;
+    }
+    refs->strings[refs->count++] = str;
+    if (!indexed) {
+        return 0;
+    }
+    if (refs->count * 2 > refs->mask) {
+        return cbor_stringref_rehash(refs);
+    }
+    if (cbor_stringref_find(refs, str) < 0) {
+        size_t slot = cbor_stringref_hash(str) & refs->mask;
+        while (refs->slots[slot]) {
+            slot = (slot + 1) & refs->mask;
+        }
+        refs->slots[slot] = refs->count;
+    }
+    return 0;
+}
+
+static void cbor_stringref_put(cbor_stringref_writer_t *w, const char *ptr, size_t size) {
+    if (w->ptr) {
+        memcpy(w->ptr + w->size, ptr, size);
+    }
+    w->size += size;
+}
+
+static void cbor_stringref_head(cbor_stringref_writer_t *w, cbor_type type, uint64_t arg) {
+    char head[9];
+    cbor_stringref_put(w, head, cbor__write_head(head, type, arg) - head);
+}
+
+static void cbor_stringref_write(cbor_stringref_writer_t *w, const cbor_value_t *src, bool packed);
+
+static void cbor_stringref_namespace(cbor_stringref_writer_t *w, const cbor_value_t *content) {
+    cbor_stringref_t outer = w->refs;
+    memset(&w->refs, 0, sizeof(cbor_stringref_t));
+    cbor_stringref_head(w, CBOR_TYPE_TAG, CBOR__TAG_STRINGREF_NAMESPACE);
+    cbor_stringref_write(w, content, false);
+    cbor_stringref_release(&w->refs);
+    w->refs = outer;
+}
+
+/* same walk in the sizing and the writing pass, so both see the same table.
+ * `packed` marks a typed array payload, which cbor_loads_ex may byte swap
+ * in place and therefore is never replaced by a reference */
+static void cbor_stringref_write(cbor_stringref_writer_t *w, const cbor_value_t *src, bool packed) {
+    switch (src->type) {
+    case CBOR_TYPE_BYTESTRING:
+    case CBOR_TYPE_STRING: {
+        long long index = packed ? -1 : cbor_stringref_find(&w->refs, src);
+        if (index >= 0) {
+            cbor_stringref_head(w, CBOR_TYPE_TAG, CBOR__TAG_STRINGREF);
+            cbor_stringref_head(w, CBOR_TYPE_UINT, index);
+            break;
+        }
+        cbor_stringref_head(w, src->type, src->blob.length);
+        cbor_stringref_put(w, src->blob.ptr, src->blob.length);
+        if (cbor_stringref_add(&w->refs, src, true) != 0) {
+            w->error = -1;
+        }
+        break;
+    }
+    case CBOR_TYPE_ARRAY: {
+        cbor_value_t *var;
+        cbor_stringref_head(w, src->type, cbor_container_size(src));
+        list_foreach(var, &src->container, entry) {
+            cbor_stringref_write(w, var, false);
+        }
+        break;
+    }
+    case CBOR_TYPE_MAP: {
+        cbor_value_t *var;
+        size_t count = cbor_container_size(src);
+        cbor_stringref_head(w, src->type, count);
+        if ((w->flags & CBOR_DUMPS_DETERMINISTIC) && count > 1) {
+            cbor_value_t **pairs = (cbor_value_t **)malloc(sizeof(cbor_value_t *) * count);
+            size_t i;
+            if (pairs == NULL || cbor__sort_pairs(src, pairs) != 0) {
+                free(pairs);
+                w->error = -1;
+                break;
+            }
+            for (i = 0; i < count; i++) {
+                cbor_stringref_write(w, pairs[i]->pair.key, false);
+                cbor_stringref_write(w, pairs[i]->pair.value, false);
+            }
+            free(pairs);
+            break;
+        }
+        list_foreach(var, &src->container, entry) {
+            cbor_stringref_write(w, var->pair.key, false);
+            cbor_stringref_write(w, var->pair.value, false);
+        }
+        break;
+    }
+    case CBOR_TYPE_TAG: {
+        if (src->tag.item == CBOR__TAG_STRINGREF_NAMESPACE) {
+            cbor_stringref_namespace(w, src->tag.content);
+            break;
+        }
+        cbor_stringref_head(w, src->type, src->tag.item);
+        cbor_stringref_write(w, src->tag.content, src->tag.item >= 64 && src->tag.item <= 87);
+        break;
+    }
+    case CBOR__TYPE_PAIR:
+        break;
+    default: {
+        size_t size = cbor_encoded_size(src);
+        if (w->ptr) {
+            cbor__dumps(src, w->ptr + w->size, 0);
+        }
+        w->size += size;
+        break;
+    }
+    }
+}
+
+/* two passes like cbor_dumps_ex, each with a fresh string table */
+char *cbor__dumps_stringref(const cbor_value_t *src, size_t *length, int flags) {
+    cbor_stringref_writer_t w;
+    size_t size;
+
+    memset(&w, 0, sizeof(w));
+    w.flags = flags;
+    cbor_stringref_namespace(&w, src);
+    size = w.size;
+    if (w.error) {
+        return NULL;
+    }
+
+    w.ptr = (char *)malloc(size + 1);
+    if (w.ptr == NULL) {
+        return NULL;
+    }
+    w.size = 0;
+    cbor_stringref_namespace(&w, src);
+    if (w.error) {
+        free(w.ptr);
+        return NULL;
+    }
+    assert(w.size == size);
+    w.ptr[size] = 0;
+    *length = size;
+    return w.ptr;
+}
+
+static cbor_value_t *cbor_stringref_child(cbor_stringref_t *refs, cbor_value_t *val);
+
+static int cbor_stringref_walk(cbor_stringref_t *refs, cbor_value_t *val) {
+    cbor_value_t *var, *tvar, *sub;
+
+    switch (val->type) {
+    case CBOR_TYPE_BYTESTRING:
+    case CBOR_TYPE_STRING:
+        return cbor_stringref_add(refs, val, false);
+    case CBOR_TYPE_ARRAY:
+        list_foreach_safe(var, &val->container, entry, tvar) {
+            if ((sub = cbor_stringref_child(refs, var)) == NULL) {
+                return -1;
+            }
+            if (sub != var) {
+                cbor_container_insert_after(val, var, sub);
+                cbor_container_remove(val, var);
+                cbor_destroy(var);
+            }
+        }
+        break;
+    case CBOR_TYPE_MAP:
+        list_foreach(var, &val->container, entry) {
+            if (cbor_stringref_walk(refs, var) != 0) {
+                return -1;
+            }
+        }
+        break;
+    case CBOR__TYPE_PAIR:
+        if ((sub = cbor_stringref_child(refs, val->pair.key)) == NULL) {
+            return -1;
+        }
+        if (sub != val->pair.key) {
+            val->pair.key->parent = NULL;
+            cbor_destroy(val->pair.key);
+            val->pair.key = sub;
+            sub->parent = val;
+        }
+        if ((sub = cbor_stringref_child(refs, val->pair.value)) == NULL) {
+            return -1;
+        }
+        if (sub != val->pair.value) {
+            val->pair.value->parent = NULL;
+            cbor_destroy(val->pair.value);
+            val->pair.value = sub;
+            sub->parent = val;
+        }
+        break;
+    case CBOR_TYPE_TAG:
+        if ((sub = cbor_stringref_child(refs, val->tag.content)) == NULL) {
+            return -1;
+        }
+        if (sub != val->tag.content) {
+            val->tag.content->parent = NULL;
+            cbor_destroy(val->tag.content);
+            val->tag.content = sub;
+            sub->parent = val;
+        }
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+/* walk a nested tag 256 with its own table and detach its content */
+static cbor_value_t *cbor_stringref_namespace_content(cbor_value_t *ns) {
+    cbor_stringref_t refs;
+    cbor_value_t *content;
+    int error;
+
+    memset(&refs, 0, sizeof(refs));
+    error = cbor_stringref_walk(&refs, ns);
+    cbor_stringref_release(&refs);
+    if (error) {
+        return NULL;
+    }
+    content = ns->tag.content;
+    ns->tag.content = NULL;
+    content->parent = NULL;
+    return content;
+}
+
+/* return: what `val` stands for once resolved: a copy of the string a tag 25
+ * refers to, the content of a nested tag 256, or `val` itself after its
+ * strings went into `refs`; NULL for a reference outside the table */
+static cbor_value_t *cbor_stringref_child(cbor_stringref_t *refs, cbor_value_t *val) {
+    if (val->type == CBOR_TYPE_TAG && val->tag.item == CBOR__TAG_STRINGREF) {
+        if (val->tag.content->type != CBOR_TYPE_UINT || val->tag.content->uint >= refs->count) {
+            return NULL;
+        }
+        return cbor_duplicate(refs->strings[val->tag.content->uint]);
+    }
+    if (val->type == CBOR_TYPE_TAG && val->tag.item == CBOR__TAG_STRINGREF_NAMESPACE) {
+        return cbor_stringref_namespace_content(val);
+    }
+    return cbor_stringref_walk(refs, val) == 0 ? val : NULL;
+}
+
+/* typed arrays inside a namespace are byte swapped only after every
+ * reference to their payload got its copy of the wire bytes */
+static void cbor_stringref_normalize(cbor_value_t *val) {
+    cbor_value_t *var;
+
+    switch (val->type) {
+    case CBOR_TYPE_ARRAY:
+    case CBOR_TYPE_MAP:
+        list_foreach(var, &val->container, entry) {
+            cbor_stringref_normalize(var);
+        }
+        break;
+    case CBOR__TYPE_PAIR:
+        cbor_stringref_normalize(val->pair.key);
+        cbor_stringref_normalize(val->pair.value);
+        break;
+    case CBOR_TYPE_TAG:
+        cbor_stringref_normalize(val->tag.content);
+        cbor__typed_array_normalize(val);
+        break;
+    default:
+        break;
+    }
+}
+
+/* replace the references below the outermost decoded tag 256, nested
+ * namespaces included, and drop the tag
+ * return: the resolved content, NULL (with `ns` destroyed) on an invalid reference */
+cbor_value_t *cbor__stringref_resolve(cbor_value_t *ns, int flags) {
+    cbor_value_t *content = cbor_stringref_namespace_content(ns);
+
+    cbor_destroy(ns);
+    if (content && (flags & CBOR_LOADS_NATIVE_TYPED_ARRAY)) {
+        cbor_stringref_normalize(content);
+    }
+    return content;
+}
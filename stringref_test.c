@@ -0,0 +1,84 @@
+#include "test.h"
+#include <stdint.h>
+
+/* cbor_loads resolves the references, the plain encoding of the result is
+ * `output`, "" when the decode fails */
+static void loads_test(const char *input, const char *output) {
+    char buf[256];
+    size_t size = unhex(input, buf), length = size;
+    cbor_value_t *src = cbor_loads(buf, &length);
+    char *raw = src ? cbor_dumps(src, &length) : NULL;
+    char *content = tohex(raw ? raw : "", raw ? length : 0);
+    report(!strcmp(content, output), input, content);
+    free(content);
+    free(raw);
+    cbor_destroy(src);
+}
+
+/* CBOR_DUMPS_STRINGREF of the JSON `input` gives `output` and loads back equal */
+static void dumps_test(const char *input, const char *output) {
+    cbor_value_t *src = cbor_json_loads(input, -1), *dst = NULL;
+    size_t length = 0;
+    char *raw = src ? cbor_dumps_ex(src, &length, CBOR_DUMPS_STRINGREF) : NULL;
+    char *content = tohex(raw ? raw : "", raw ? length : 0);
+    char *json = NULL;
+
+    if (raw) {
+        dst = cbor_loads(raw, &length);
+    }
+    if (dst) {
+        json = cbor_json_dumps(dst, &length, false);
+    }
+    report(!strcmp(content, output) && json && !strcmp(json, input), input, content);
+    free(json);
+    free(content);
+    free(raw);
+    cbor_destroy(src);
+    cbor_destroy(dst);
+}
+
+/* a reference to a typed array payload copies the wire bytes even when the
+ * array itself gets byte swapped */
+static void typed_array_test(void) {
+    char buf[64];
+    size_t length = unhex("d9010082d8414400010002d81900", buf), count = 0;
+    cbor_value_t *src = cbor_loads_ex(buf, &length, CBOR_LOADS_NATIVE_TYPED_ARRAY);
+    const uint16_t *elements = NULL;
+    cbor_value_t *copy = NULL;
+    char *content;
+
+    if (src && cbor_container_size(src) == 2) {
+        elements = (const uint16_t *)cbor_typed_array(cbor_container_first(src), NULL, &count);
+        copy = cbor_container_last(src);
+    }
+    content = tohex(copy ? cbor_string(copy) : "", copy ? cbor_string_size(copy) : 0);
+    report(elements && count == 2 && elements[0] == 1 && elements[1] == 2
+        && cbor_is_bytestring(copy) && !strcmp(content, "00010002"), "typed array", content);
+    free(content);
+    cbor_destroy(src);
+}
+
+int main(int argc, char **argv) {
+    /* 256(["aaa", 25(0)]) */
+    loads_test("d901008263616161d81900", "826361616163616161");
+    /* 256([256(["bbb"]), "aaa", 25(0)]) */
+    loads_test("d9010083d90100816362626263616161d81900", "8381636262626361616163616161");
+    /* 256([256(["bbb", 25(0)]), "aaa", 25(0)]) */
+    loads_test("d9010083d901008263626262d8190063616161d81900", "83826362626263626262" "6361616163616161");
+    /* 256({"aaa": 1, 25(0): 256(25(0))}) */
+    loads_test("d90100a26361616101d81900d90100d81900", "");
+    /* strings below the length of their reference get no index */
+    loads_test("d9010082626161d81900", "");
+    /* references outside the table or not to an index */
+    loads_test("d9010081d81900", "");
+    loads_test("d901008263616161d81901", "");
+    loads_test("d901008263616161d8196161", "");
+    /* a reference outside any namespace is left alone */
+    loads_test("d81900", "d81900");
+
+    dumps_test(JSON(["aaa", "aaa"]), "d901008263616161d81900");
+    dumps_test(JSON({"aaa": "aaa", "bbb": ["aaa", "bbb"]}), "d90100a263616161d8190063626262" "82d81900d81901");
+
+    typed_array_test();
+    return failures != 0;
+}
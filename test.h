@@ -0,0 +1,46 @@
+#ifndef __CBOR_TEST_H__
+#define __CBOR_TEST_H__
+
+#include "cbor.h"
+#include <stdio.h>
+#include <string.h>
+
+/* helpers shared by the *_test.c programs, each one a single translation unit */
+
+#define JSON(...) #__VA_ARGS__
+
+static int failures;
+
+/* hex digits to bytes, `buf` must hold half their count */
+static inline size_t unhex(const char *hex, char *buf) {
+    size_t length = 0;
+    unsigned int byte;
+    while (*hex && sscanf(hex, "%2x", &byte) == 1) {
+        buf[length++] = (char)byte;
+        hex += 2;
+    }
+    return length;
+}
+
+/* return: `length` bytes as lowercase hex digits, freed by the caller */
+static inline char *tohex(const char *ptr, size_t length) {
+    char *hex = (char *)malloc(length * 2 + 1);
+    size_t i;
+    for (i = 0; i < length; i++) {
+        sprintf(hex + i * 2, "%02x", (unsigned char)ptr[i]);
+    }
+    hex[length * 2] = '\0';
+    return hex;
+}
+
+/* PASS to stdout, FAIL to stderr and counted; main returns failures != 0 */
+static inline void report(bool ok, const char *name, const char *content) {
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s -> '%s'\n", name, content);
+        failures++;
+    } else {
+        fprintf(stdout, "PASS: %s -> '%s'\n", name, content);
+    }
+}
+
+#endif
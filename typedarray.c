@@ -0,0 +1,195 @@
+#include "cbor.h"
+#include <string.h>
+#include "define.h"
+
+/* RFC 8746 tag layout: 0b010_f_s_e_ll
+ *   f: float, s: signed, e: little endian, ll: element width */
+#define CBOR_TYPED_FLOAT_BIT  0x10
+#define CBOR_TYPED_ENDIAN_BIT 0x04
+
+#define cbor__host_little() (htobe16(1) != 1)
+
+/* return: element size of tag `item`, 0 if it is no typed array we support */
+static size_t cbor_typed_array_width(uint64_t item) {
+    if (item < 64 || item > 87 || item == 76) {
+        return 0;
+    }
+    if (item & CBOR_TYPED_FLOAT_BIT) {
+        /* float128 has no portable C type */
+        return (item & 3) == 3 ? 0 : (size_t)2 << (item & 3);
+    }
+    return (size_t)1 << (item & 3);
+}
+
+/* tag of `type` in host byte order */
+static uint64_t cbor_typed_array_native(cbor_typed_array_type type) {
+    if (cbor_typed_array_width(type) > 1 && cbor__host_little()) {
+        return type | CBOR_TYPED_ENDIAN_BIT;
+    }
+    return type;
+}
+
+static bool cbor_typed_array_is_native(uint64_t item, size_t width) {
+    return width == 1 || !(item & CBOR_TYPED_ENDIAN_BIT) == !cbor__host_little();
+}
+
+static cbor_typed_array_type cbor_typed_array_type_of(uint64_t item, size_t width) {
+    return (cbor_typed_array_type)(width > 1 ? item & ~CBOR_TYPED_ENDIAN_BIT : item);
+}
+
+static void cbor_typed_array_swap(char *ptr, size_t width, size_t count) {
+    size_t i;
+    switch (width) {
+    case 2:
+        for (i = 0; i < count; i++, ptr += 2) {
+            uint16_t v;
+            memcpy(&v, ptr, 2);
+            v = (uint16_t)((v << 8) | (v >> 8));
+            memcpy(ptr, &v, 2);
+        }
+        break;
+    case 4:
+        for (i = 0; i < count; i++, ptr += 4) {
+            uint32_t v;
+            memcpy(&v, ptr, 4);
+            v = ((v << 24) | ((v << 8) & 0xFF0000) | ((v >> 8) & 0xFF00) | (v >> 24));
+            memcpy(ptr, &v, 4);
+        }
+        break;
+    case 8:
+        for (i = 0; i < count; i++, ptr += 8) {
+            uint64_t v;
+            memcpy(&v, ptr, 8);
+            v = ((v & 0x00000000FFFFFFFFULL) << 32) | ((v & 0xFFFFFFFF00000000ULL) >> 32);
+            v = ((v & 0x0000FFFF0000FFFFULL) << 16) | ((v & 0xFFFF0000FFFF0000ULL) >> 16);
+            v = ((v & 0x00FF00FF00FF00FFULL) << 8) | ((v & 0xFF00FF00FF00FF00ULL) >> 8);
+            memcpy(ptr, &v, 8);
+        }
+        break;
+    }
+}
+
+/* called by cbor_loads_ex on every tag with CBOR_LOADS_NATIVE_TYPED_ARRAY:
+ * flip foreign byte order once so the accessors never convert */
+void cbor__typed_array_normalize(cbor_value_t *tag) {
+    cbor_value_t *content = tag->tag.content;
+    size_t width = cbor_typed_array_width(tag->tag.item);
+
+    if (width == 0 || content == NULL || content->type != CBOR_TYPE_BYTESTRING
+        || content->blob.length % width != 0
+        || cbor_typed_array_is_native(tag->tag.item, width)) {
+        return;
+    }
+    cbor_typed_array_swap(content->blob.ptr, width, content->blob.length / width);
+    tag->tag.item ^= CBOR_TYPED_ENDIAN_BIT;
+}
+
+cbor_value_t *cbor_init_typed_array(cbor_typed_array_type type, const void *data, size_t count) {
+    size_t width = cbor_typed_array_width(type);
+    cbor_value_t *blob;
+
+    cbor_value_t *tag;
+
+    if (width == 0 || (count > 0 && data == NULL) || count > SIZE_MAX / width) {
+        return NULL;
+    }
+    blob = cbor_create(CBOR_TYPE_BYTESTRING);
+    if (blob == NULL || cbor_blob_append(blob, (const char *)data, width * count) != 0) {
+        cbor_destroy(blob);
+        return NULL;
+    }
+    tag = cbor_init_tag(cbor_typed_array_native(type), blob);
+    if (tag == NULL) {
+        cbor_destroy(blob);
+    }
+    return tag;
+}
+
+/* return: the packed elements of a typed array in either byte order, NULL otherwise */
+static const cbor_value_t *cbor_typed_array_content(const cbor_value_t *val, size_t *width) {
+    const cbor_value_t *content;
+
+    if (val == NULL || val->type != CBOR_TYPE_TAG) {
+        return NULL;
+    }
+    *width = cbor_typed_array_width(val->tag.item);
+    content = val->tag.content;
+    if (*width == 0 || content == NULL || content->type != CBOR_TYPE_BYTESTRING
+        || content->blob.length % *width != 0) {
+        return NULL;
+    }
+    return content;
+}
+
+bool cbor_is_typed_array(const cbor_value_t *val) {
+    size_t width;
+    return cbor_typed_array_content(val, &width) != NULL;
+}
+
+const void *cbor_typed_array(const cbor_value_t *val, cbor_typed_array_type *type, size_t *count) {
+    const cbor_value_t *content;
+    size_t width;
+
+    content = cbor_typed_array_content(val, &width);
+    if (content == NULL || !cbor_typed_array_is_native(val->tag.item, width)) {
+        return NULL;
+    }
+    if (type) {
+        *type = cbor_typed_array_type_of(val->tag.item, width);
+    }
+    if (count) {
+        *count = content->blob.length / width;
+    }
+    return content->blob.ptr;
+}
+
+const double *cbor_typed_array_double(const cbor_value_t *val, size_t *count) {
+    cbor_typed_array_type type;
+    const void *ptr = cbor_typed_array(val, &type, count);
+    if (ptr == NULL || type != CBOR_TYPED_FLOAT64) {
+        return NULL;
+    }
+    return (const double *)ptr;
+}
+
+int cbor_encode_typed_array(cbor_encoder_t *enc, cbor_typed_array_type type, const void *data, size_t count) {
+    size_t width = cbor_typed_array_width(type);
+    if (width == 0 || (count > 0 && data == NULL) || count > SIZE_MAX / width) {
+        enc->error = -1;
+        return enc->error;
+    }
+    cbor_encode_tag(enc, cbor_typed_array_native(type));
+    return cbor_encode_bytestring(enc, (const char *)data, width * count);
+}
+
+const void *cbor_raw_typed_array(const char *src, size_t length, size_t offset, cbor_typed_array_type *type, size_t *count) {
+    cbor_type major;
+    uint8_t addition;
+    uint64_t item, size;
+    size_t width;
+
+    if (src == NULL) {
+        return NULL;
+    }
+    offset = cbor__read_head(src, length, offset, &major, &addition, &item);
+    if (offset == 0 || major != CBOR_TYPE_TAG) {
+        return NULL;
+    }
+    width = cbor_typed_array_width(item);
+    if (width == 0 || !cbor_typed_array_is_native(item, width)) {
+        return NULL;
+    }
+    offset = cbor__read_head(src, length, offset, &major, &addition, &size);
+    if (offset == 0 || major != CBOR_TYPE_BYTESTRING || addition == 31
+        || size > length - offset || size % width != 0
+        || (uintptr_t)(src + offset) % width != 0) {
+        return NULL;
+    }
+    if (type) {
+        *type = cbor_typed_array_type_of(item, width);
+    }
+    if (count) {
+        *count = size / width;
+    }
+    return src + offset;
+}
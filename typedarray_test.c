@@ -0,0 +1,104 @@
+#include "test.h"
+#include <stdint.h>
+
+static bool little_endian(void) {
+    uint16_t one = 1;
+    return *(const char *)&one == 1;
+}
+
+/* cbor_loads then cbor_dumps must give back the input bytes */
+static void roundtrip_test(const char *input) {
+    char buf[256];
+    size_t size = unhex(input, buf), length = size;
+    cbor_value_t *src = cbor_loads(buf, &length);
+    char *raw = src ? cbor_dumps(src, &length) : NULL;
+    char *content = tohex(raw ? raw : "", raw ? length : 0);
+    report(!strcmp(content, input), input, content);
+    free(content);
+    free(raw);
+    cbor_destroy(src);
+}
+
+/* uint16 elements {1, 2} through cbor_typed_array, "" when it refuses them */
+static void access_test(const char *name, const char *input, int flags, bool present) {
+    char buf[256], content[64] = "";
+    size_t length = unhex(input, buf), count = 0;
+    cbor_value_t *src = cbor_loads_ex(buf, &length, flags);
+    cbor_typed_array_type type = (cbor_typed_array_type)0;
+    const uint16_t *elements = (const uint16_t *)cbor_typed_array(src, &type, &count);
+    bool ok = src != NULL && cbor_is_typed_array(src);
+
+    if (elements) {
+        snprintf(content, sizeof(content), "%d: %u, %u", (int)type, elements[0], elements[1]);
+        ok = ok && type == CBOR_TYPED_UINT16 && count == 2 && elements[0] == 1 && elements[1] == 2;
+    }
+    report(ok && (elements != NULL) == present, name, content);
+    cbor_destroy(src);
+}
+
+static void init_test(void) {
+    const uint16_t data[2] = {1, 2};
+    const char *output = little_endian() ? "d84544" "01000200" : "d84144" "00010002";
+    cbor_value_t *val = cbor_init_typed_array(CBOR_TYPED_UINT16, data, 2);
+    size_t length = 0;
+    char *raw = val ? cbor_dumps(val, &length) : NULL;
+    char *content = tohex(raw ? raw : "", raw ? length : 0);
+    report(!strcmp(content, output), "init", content);
+    free(content);
+    free(raw);
+    cbor_destroy(val);
+}
+
+/* the elements start at offset 4 of `input`, which the buffer keeps aligned */
+static void raw_test(const char *name, const char *input, bool present) {
+    uint64_t buf[32];
+    size_t length = unhex(input, (char *)buf), count = 0;
+    cbor_typed_array_type type = (cbor_typed_array_type)0;
+    const void *elements = cbor_raw_typed_array((const char *)buf, length, 1, &type, &count);
+    char content[64] = "";
+    if (elements) {
+        snprintf(content, sizeof(content), "%d: %zu elements at %d", (int)type, count,
+                 (int)((const char *)elements - (const char *)buf));
+    }
+    report((elements != NULL) == present
+        && (!present || (type == CBOR_TYPED_UINT16 && count == 2 && (const char *)elements == (const char *)buf + 4)),
+        name, content);
+}
+
+static void overflow_test(void) {
+    const uint64_t data[1] = {0};
+    cbor_encoder_t enc;
+    size_t length = 0;
+    char *raw;
+
+    report(cbor_init_typed_array(CBOR_TYPED_UINT64, data, SIZE_MAX / 4) == NULL, "init count overflow", "");
+    report(cbor_init_tag(1, NULL) == NULL, "tag without content", "");
+
+    cbor_encoder_init(&enc, NULL, 0);
+    report(cbor_encode_typed_array(&enc, CBOR_TYPED_UINT64, data, SIZE_MAX / 4) != 0, "encode count overflow", "");
+    raw = cbor_encoder_release(&enc, &length);
+    report(raw == NULL, "encode count overflow released", "");
+    free(raw);
+}
+
+int main(int argc, char **argv) {
+    const char *native = little_endian() ? "d84544" "01000200" : "d84144" "00010002";
+    const char *foreign = little_endian() ? "d84144" "00010002" : "d84544" "01000200";
+
+    roundtrip_test("d84144" "00000001");
+    roundtrip_test("d84544" "01000000");
+    roundtrip_test("d8404401020304");
+    roundtrip_test("82d8524800000000000000f0d84644aabbccdd");
+
+    access_test("native", native, 0, true);
+    access_test("foreign", foreign, 0, false);
+    access_test("native normalized", native, CBOR_LOADS_NATIVE_TYPED_ARRAY, true);
+    access_test("foreign normalized", foreign, CBOR_LOADS_NATIVE_TYPED_ARRAY, true);
+
+    init_test();
+    raw_test("raw native", little_endian() ? "81d84544" "01000200" : "81d84144" "00010002", true);
+    raw_test("raw foreign", little_endian() ? "81d84144" "00010002" : "81d84544" "01000200", false);
+    raw_test("raw truncated", little_endian() ? "81d84544" "010002" : "81d84144" "000100", false);
+    overflow_test();
+    return failures != 0;
+}